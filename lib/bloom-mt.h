@@ -0,0 +1,129 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef BLOOMMT_H
+#define BLOOMMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "memmt.h"
+
+/**
+ * per frame bloom filter of trigrams
+ *
+ * - the compression worker puts all trigrams (3 byte substrings) of its
+ *   chunk into a bloom filter, while the chunk is still in the cache
+ * - the filter is written as a skippable frame of its own, in front of
+ *   the data frame, so other decompressors just skip it:
+ *
+ *   0x184D2A5B, LE32 4 + n, LE32 flags, n bytes filter
+ *
+ * - each trigram sets two bits (k = 2), n is a power of two, the bit
+ *   positions are the high bits of two multiplicative hashes
+ * - a search for a string of 3 or more bytes can skip the frame, when
+ *   one of its trigrams is not in the filter
+ * - flags bit 0: the chunk ends with a newline, so a frame, which is
+ *   skipped, has only whole lines when also the frame before it has
+ *   this bit set
+ */
+
+#define MT_BLOOM_MAGIC    0x184D2A5BU
+#define MT_BLOOM_HDRSIZE  12
+#define MT_BLOOM_NEWLINE  1
+#define MT_BLOOM_MIN      64
+#define MT_BLOOM_MAX      (1 << 20)
+
+/* size of the bloom frame, zero when not used */
+#define MT_BLOOM_FRAMESIZE(n) ((n) ? MT_BLOOM_HDRSIZE + (size_t)(n) : 0)
+
+MEM_STATIC void MT_bloom_set(BYTE * bits, size_t mask, U32 tri)
+{
+	U64 h = (U64) tri * 0x9E3779B97F4A7C15ULL;
+	U64 g = (h ^ (h >> 29)) * 0xBF58476D1CE4E5B9ULL;
+	size_t a = (size_t)(h >> 32) & mask;
+	size_t b = (size_t)(g >> 32) & mask;
+
+	bits[a >> 3] |= (BYTE) (1 << (a & 7));
+	bits[b >> 3] |= (BYTE) (1 << (b & 7));
+}
+
+MEM_STATIC int MT_bloom_has(const BYTE * bits, size_t mask, U32 tri)
+{
+	U64 h = (U64) tri * 0x9E3779B97F4A7C15ULL;
+	U64 g = (h ^ (h >> 29)) * 0xBF58476D1CE4E5B9ULL;
+	size_t a = (size_t)(h >> 32) & mask;
+	size_t b = (size_t)(g >> 32) & mask;
+
+	return (bits[a >> 3] >> (a & 7)) & (bits[b >> 3] >> (b & 7)) & 1;
+}
+
+/**
+ * write the bloom frame of src to dst
+ * - size: bytes of the filter, a power of two, MT_BLOOM_MIN .. MAX
+ * - dst needs MT_BLOOM_HDRSIZE + size bytes, which are returned
+ */
+MEM_STATIC size_t MT_bloom_frame(void *dst, size_t size, const void *src,
+				 size_t len)
+{
+	const BYTE *p = (const BYTE *)src;
+	BYTE *d = (BYTE *) dst;
+	BYTE *bits = d + MT_BLOOM_HDRSIZE;
+	size_t mask = size * 8 - 1;
+	U32 tri = 0;
+	size_t i;
+
+	memset(bits, 0, size);
+	for (i = 0; i < len; i++) {
+		tri = ((tri << 8) | p[i]) & 0xffffff;
+		if (i >= 2)
+			MT_bloom_set(bits, mask, tri);
+	}
+
+	MEM_writeLE32(d + 0, MT_BLOOM_MAGIC);
+	MEM_writeLE32(d + 4, (U32) (4 + size));
+	MEM_writeLE32(d + 8, len && p[len - 1] == '\n' ?
+		      MT_BLOOM_NEWLINE : 0);
+
+	return MT_BLOOM_HDRSIZE + size;
+}
+
+/**
+ * check, if the chunk may contain pat
+ * - returns zero, when it does not, strings with less than 3 bytes
+ *   are always a maybe
+ */
+MEM_STATIC int MT_bloom_test(const void *bits, size_t size, const void *pat,
+			     size_t len)
+{
+	const BYTE *p = (const BYTE *)pat;
+	size_t mask = size * 8 - 1;
+	U32 tri = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		tri = ((tri << 8) | p[i]) & 0xffffff;
+		if (i >= 2 && !MT_bloom_has((const BYTE *)bits, mask, tri))
+			return 0;
+	}
+
+	return 1;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* BLOOMMT_H */
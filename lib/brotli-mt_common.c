@@ -50,6 +50,12 @@ const char *BROTLIMT_getErrorString(size_t code)
 		return "Could not decompress frame at once";
 	case PREFIX(compressionParameter_unsupported):
 		return "Compression parameter is out of bound";
+	case PREFIX(checksum_wrong):
+		return "Checksum of a frame is wrong";
+	case PREFIX(verify_failed):
+		return "Round trip of a frame failed";
+	case PREFIX(tree_wrong):
+		return "Tree hash of the output is wrong";
 	case PREFIX(maxCode):
 	default:
 		return noErrorCode;
@@ -0,0 +1,225 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef CHUNKMT_H
+#define CHUNKMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "memmt.h"
+
+/**
+ * content defined chunking (FastCDC)
+ *
+ * - with fixed chunks, one inserted byte shifts all following frames,
+ *   so the compressed files of two similar inputs have nothing in common
+ * - here the frame boundaries are found by a rolling gear hash:
+ *   h = (h << 1) + gear[byte], so the top bits of h depend on the last
+ *   64 bytes only, a cut is done where these bits are zero
+ * - the first min bytes of a chunk are skipped, till avg a mask with two
+ *   bits more is used, after avg one with two bits less (normalized
+ *   chunking), at max the chunk is cut anyway
+ * - the input is loaded one 64 bit word at a time, the eight byte steps
+ *   of each word are unrolled by the compiler
+ * - the gear table comes from a fixed seed, so the same content always
+ *   gets the same boundaries, also between different runs
+ */
+
+#include <string.h>   /* memchr, memcmp */
+
+/**
+ * record aware chunking
+ *
+ * - for log files and other record streams, the chunks are cut only
+ *   behind a delimiter (newline or some other pattern), so each frame
+ *   gives whole records and can be processed on its own
+ * - the cut is the first delimiter behind avg, or the last one before
+ *   it, when there is none up to max, a record longer than the
+ *   tolerance is cut at max anyway
+ * - the search forward uses memchr() for the first byte, which is
+ *   vectorized by the C library
+ */
+
+#define MT_CHUNK_MIN  (1 << 10)
+#define MT_CHUNK_MAX  (1 << 30)
+#define MT_DELIM_MAX  16
+
+typedef struct {
+	U64 gear[256];
+	U64 mask_s;		/* used from min to avg */
+	U64 mask_l;		/* used from avg to max */
+	size_t min;
+	size_t avg;
+	size_t max;
+	BYTE delim[MT_DELIM_MAX];	/* record delimiter */
+	size_t dlen;		/* zero for content defined chunking */
+} MT_Chunker;
+
+/**
+ * setup the chunker
+ * - avg is rounded down to a power of two, min and max are clamped
+ *   around it, so that min <= avg <= max
+ * - zero for min or max means avg / 4 or avg * 4
+ */
+MEM_STATIC void MT_chunk_init(MT_Chunker * c, size_t min, size_t avg,
+			      size_t max)
+{
+	U64 x = 0x7A73746D74434443ULL;	/* "zstmtCDC" */
+	int i, bits = 0;
+
+	if (avg < MT_CHUNK_MIN)
+		avg = MT_CHUNK_MIN;
+	while (((size_t)2 << bits) <= avg && bits < 28)
+		bits++;
+	c->avg = (size_t)1 << bits;
+	if (!min)
+		min = c->avg / 4;
+	if (!max)
+		max = c->avg * 4;
+	c->min = min < c->avg ? min : c->avg;
+	c->max = max > c->avg ? max : c->avg;
+	c->mask_s = ~0ULL << (64 - bits - 2);
+	c->mask_l = ~0ULL << (64 - bits + 2);
+	c->dlen = 0;
+
+	/* splitmix64 */
+	for (i = 0; i < 256; i++) {
+		U64 z = (x += 0x9E3779B97F4A7C15ULL);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		c->gear[i] = z ^ (z >> 31);
+	}
+}
+
+/**
+ * setup the chunker for records
+ * - the chunks are cut behind delim, dlen is 1 .. MT_DELIM_MAX
+ * - their size is within avg +/- tolerance percent
+ */
+MEM_STATIC void MT_chunk_delim(MT_Chunker * c, const void *delim,
+			       size_t dlen, size_t avg, int tolerance)
+{
+	size_t tol = avg / 100 * (size_t)tolerance;
+
+	memset(c, 0, sizeof(*c));
+	memcpy(c->delim, delim, dlen);
+	c->dlen = dlen;
+	c->avg = avg;
+	c->min = avg - tol;
+	c->max = avg + tol;
+}
+
+/* returns the position behind the first delimiter in [i, end) or zero */
+MEM_STATIC size_t MT_delim_next(const MT_Chunker * c, const BYTE * p,
+				size_t i, size_t end)
+{
+	while (i + c->dlen <= end) {
+		const BYTE *q = (const BYTE *)memchr(p + i, c->delim[0],
+						     end - c->dlen + 1 - i);
+		if (!q)
+			return 0;
+		i = (size_t)(q - p);
+		if (!memcmp(q + 1, c->delim + 1, c->dlen - 1))
+			return i + c->dlen;
+		i++;
+	}
+
+	return 0;
+}
+
+/* returns the position behind the last delimiter in [i, end) or zero */
+MEM_STATIC size_t MT_delim_prev(const MT_Chunker * c, const BYTE * p,
+				size_t i, size_t end)
+{
+	size_t k;
+
+	if (end < i + c->dlen)
+		return 0;
+	for (k = end - c->dlen + 1; k-- > i;)
+		if (p[k] == c->delim[0] &&
+		    !memcmp(p + k + 1, c->delim + 1, c->dlen - 1))
+			return k + c->dlen;
+
+	return 0;
+}
+
+/* returns the position behind the cut, or zero if there is none */
+MEM_STATIC size_t MT_chunk_scan(const MT_Chunker * c, const BYTE * p,
+				size_t i, size_t end, U64 mask, U64 * hash)
+{
+	U64 h = *hash;
+
+	for (; i + 8 <= end; i += 8) {
+		U64 v = MEM_readLE64(p + i);
+		int k;
+
+		for (k = 0; k < 8; k++, v >>= 8) {
+			h = (h << 1) + c->gear[v & 0xff];
+			if (!(h & mask)) {
+				*hash = h;
+				return i + k + 1;
+			}
+		}
+	}
+
+	for (; i < end; i++) {
+		h = (h << 1) + c->gear[p[i]];
+		if (!(h & mask)) {
+			*hash = h;
+			return i + 1;
+		}
+	}
+
+	*hash = h;
+	return 0;
+}
+
+/* returns the size of the next chunk in src */
+MEM_STATIC size_t MT_chunk_cut(const MT_Chunker * c, const void *src,
+			       size_t size)
+{
+	const BYTE *p = (const BYTE *)src;
+	size_t end, normal, cut;
+	U64 h = 0;
+
+	if (size <= c->min)
+		return size;
+
+	end = size < c->max ? size : c->max;
+	if (c->dlen) {
+		normal = end < c->avg ? end : c->avg;
+		/* a delimiter may also start just before normal */
+		cut = MT_delim_next(c, p, normal - c->dlen + 1 > c->min ?
+				    normal - c->dlen + 1 : c->min, end);
+		if (!cut && normal > c->min)
+			cut = MT_delim_prev(c, p, c->min, normal);
+		return cut ? cut : end;
+	}
+	normal = end < c->avg ? end : c->avg;
+
+	cut = MT_chunk_scan(c, p, c->min, normal, c->mask_s, &h);
+	if (cut)
+		return cut;
+	cut = MT_chunk_scan(c, p, normal, end, c->mask_l, &h);
+	if (cut)
+		return cut;
+
+	return end;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* CHUNKMT_H */
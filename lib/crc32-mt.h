@@ -0,0 +1,290 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef CRC32MT_H
+#define CRC32MT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "memmt.h"
+
+/**
+ * crc32 of gzip and zip (reflected polynomial 0xEDB88320)
+ *
+ * - slice-by-8 is the portable version, eight table lookups for eight
+ *   bytes instead of one lookup per byte
+ * - x86-64 with PCLMULQDQ folds 64 bytes per round by carry-less
+ *   multiplication, arm64 with the crc extension uses crc32x
+ * - the version is selected at runtime by MT_crc32_init(), which must
+ *   be called once, before the threads use MT_crc32()
+ * - MT_crc32_combine() gives the crc32 of A+B from the ones of A and B
+ *   and the size of B, so the threads can do a part each
+ */
+
+#define MT_CRC32_POLY  0xEDB88320U
+
+typedef U32 (MT_crc32_fn) (U32 crc, const BYTE * p, size_t n);
+
+static U32 MT_crc32_table[8][256];
+static MT_crc32_fn *MT_crc32_impl;
+
+MEM_STATIC U32 MT_crc32_slice8(U32 crc, const BYTE * p, size_t n)
+{
+	while (n && ((size_t)p & 7)) {
+		crc = MT_crc32_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+		n--;
+	}
+
+	if (MEM_isLittleEndian()) {
+		while (n >= 8) {
+			U32 a = MEM_read32(p) ^ crc;
+			U32 b = MEM_read32(p + 4);
+
+			crc = MT_crc32_table[7][a & 0xff] ^
+			    MT_crc32_table[6][(a >> 8) & 0xff] ^
+			    MT_crc32_table[5][(a >> 16) & 0xff] ^
+			    MT_crc32_table[4][a >> 24] ^
+			    MT_crc32_table[3][b & 0xff] ^
+			    MT_crc32_table[2][(b >> 8) & 0xff] ^
+			    MT_crc32_table[1][(b >> 16) & 0xff] ^
+			    MT_crc32_table[0][b >> 24];
+			p += 8;
+			n -= 8;
+		}
+	}
+
+	while (n--)
+		crc = MT_crc32_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define MT_CRC32_PCLMUL
+
+/**
+ * fold 4x128 bits by x^512 and x^576, then reduce to 32 bits by
+ * barrett reduction (Intel: "Fast CRC Computation Using PCLMULQDQ")
+ * - n must be 64 or more and a multiple of 16
+ */
+__attribute__ ((target("pclmul,sse4.1")))
+static U32 MT_crc32_fold(U32 crc, const BYTE * p, size_t n)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+	const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124LL);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+	const __m128i mask = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i x1, x2, x3, x4, y1, y2, y3, y4;
+
+	x1 = _mm_loadu_si128((const __m128i *)(p + 0));
+	x2 = _mm_loadu_si128((const __m128i *)(p + 16));
+	x3 = _mm_loadu_si128((const __m128i *)(p + 32));
+	x4 = _mm_loadu_si128((const __m128i *)(p + 48));
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+	p += 64;
+	n -= 64;
+
+	while (n >= 64) {
+		y1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+		y2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+		y3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+		y4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, y1),
+				   _mm_loadu_si128((const __m128i *)(p + 0)));
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, y2),
+				   _mm_loadu_si128((const __m128i *)(p + 16)));
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, y3),
+				   _mm_loadu_si128((const __m128i *)(p + 32)));
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, y4),
+				   _mm_loadu_si128((const __m128i *)(p + 48)));
+		p += 64;
+		n -= 64;
+	}
+
+	/* fold the 4x128 bits into 128 bits, then the rest by 16 bytes */
+	y1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), y1);
+	y1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), y1);
+	y1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), y1);
+	while (n >= 16) {
+		y1 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, y1),
+				   _mm_loadu_si128((const __m128i *)p));
+		p += 16;
+		n -= 16;
+	}
+
+	/* 128 bits to 64 bits */
+	x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), k5, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	/* barrett reduction to 32 bits */
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask), poly, 0x10);
+	x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask), poly, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return (U32) _mm_extract_epi32(x1, 1);
+}
+
+MEM_STATIC U32 MT_crc32_pclmul(U32 crc, const BYTE * p, size_t n)
+{
+	if (n >= 64) {
+		size_t m = n & ~(size_t)15;
+
+		crc = MT_crc32_fold(crc, p, m);
+		p += m;
+		n -= m;
+	}
+
+	return MT_crc32_slice8(crc, p, n);
+}
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#define MT_CRC32_ARM
+#ifndef HWCAP_CRC32
+#define HWCAP_CRC32 (1 << 7)
+#endif
+
+__attribute__ ((target("+crc")))
+static U32 MT_crc32_arm(U32 crc, const BYTE * p, size_t n)
+{
+	while (n && ((size_t)p & 7)) {
+		crc = __crc32b(crc, *p++);
+		n--;
+	}
+	while (n >= 8) {
+		crc = __crc32d(crc, MEM_read64(p));
+		p += 8;
+		n -= 8;
+	}
+	while (n--)
+		crc = __crc32b(crc, *p++);
+
+	return crc;
+}
+#endif
+
+/**
+ * build the tables and select the fastest version for this cpu
+ */
+MEM_STATIC void MT_crc32_init(void)
+{
+	U32 b, i, r;
+
+	if (MT_crc32_impl)
+		return;
+
+	for (b = 0; b < 256; b++) {
+		r = b;
+		for (i = 0; i < 8; i++)
+			r = r & 1 ? (r >> 1) ^ MT_CRC32_POLY : r >> 1;
+		MT_crc32_table[0][b] = r;
+	}
+	for (b = 0; b < 256; b++) {
+		r = MT_crc32_table[0][b];
+		for (i = 1; i < 8; i++) {
+			r = MT_crc32_table[0][r & 0xff] ^ (r >> 8);
+			MT_crc32_table[i][b] = r;
+		}
+	}
+
+	MT_crc32_impl = MT_crc32_slice8;
+#ifdef MT_CRC32_PCLMUL
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("pclmul") &&
+	    __builtin_cpu_supports("sse4.1"))
+		MT_crc32_impl = MT_crc32_pclmul;
+#endif
+#ifdef MT_CRC32_ARM
+	if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+		MT_crc32_impl = MT_crc32_arm;
+#endif
+}
+
+/**
+ * crc32 of n bytes of p, crc is the one of the data before (or zero)
+ */
+MEM_STATIC U32 MT_crc32(U32 crc, const void *p, size_t n)
+{
+	return ~MT_crc32_impl(~crc, (const BYTE *)p, n);
+}
+
+/* a * b modulo the polynomial, in the reflected bit order */
+MEM_STATIC U32 MT_crc32_multmodp(U32 a, U32 b)
+{
+	U32 m = 1U << 31, p = 0;
+
+	for (;;) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ MT_CRC32_POLY : b >> 1;
+	}
+
+	return p;
+}
+
+/**
+ * crc32 of A+B, from crc1 of A, crc2 of B and the size of B
+ * - x^(8 * len2) is built by squaring, so it takes log2(len2) steps
+ */
+MEM_STATIC U32 MT_crc32_combine(U32 crc1, U32 crc2, U64 len2)
+{
+	U32 x2n = 1U << 30;	/* x^1 */
+	U32 p = 1U << 31;	/* x^0 */
+	U64 n = len2;
+
+	/* x^(2^3), the length is in bytes */
+	x2n = MT_crc32_multmodp(x2n, x2n);
+	x2n = MT_crc32_multmodp(x2n, x2n);
+	x2n = MT_crc32_multmodp(x2n, x2n);
+	while (n) {
+		if (n & 1)
+			p = MT_crc32_multmodp(x2n, p);
+		n >>= 1;
+		if (n)
+			x2n = MT_crc32_multmodp(x2n, x2n);
+	}
+
+	return MT_crc32_multmodp(p, crc1) ^ crc2;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* CRC32MT_H */
@@ -0,0 +1,270 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef DEDUPMT_H
+#define DEDUPMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memmt.h"
+#include "xxhash-mt.h"
+
+/**
+ * frame level deduplication
+ *
+ * - the compressor hashes every chunk with 128 bit (two xxHash64 with
+ *   different seeds) and keeps a table of the chunks of the last window
+ *   bytes of input
+ * - a chunk, which was seen before, is not compressed again, instead a
+ *   reference frame is written, which has the distance in bytes back to
+ *   the earlier chunk in the uncompressed data and the size of it
+ * - the decompressor keeps the last window bytes of its output in a ring
+ *   buffer and copies the referenced data from there
+ * - both kinds of frames are skippable frames of their own:
+ *
+ *   window frame, the first one of the stream:
+ *   0x184D2A5D, LE32 8, LE64 window
+ *
+ *   reference frame:
+ *   0x184D2A5D, LE32 16, LE64 distance, LE64 size
+ */
+
+#define MT_DEDUP_MAGIC      0x184D2A5DU
+#define MT_DEDUP_WINDOWSIZE 8
+#define MT_DEDUP_REFSIZE    16
+#define MT_DEDUP_WINDOW_MAX ((U64)1 << 32)
+
+#define MT_DEDUP_PROBES     16
+
+typedef struct {
+	U64 hash[2];
+	U64 offset;		/* start of the chunk in the input */
+	U64 size;		/* zero for unused entries */
+} MT_DedupEntry;
+
+typedef struct {
+	MT_DedupEntry *entry;
+	size_t mask;
+	U64 window;
+} MT_Dedup;
+
+/* entries of the table, a power of two */
+MEM_STATIC size_t MT_dedup_slots(size_t chunks)
+{
+	size_t n = 1024;
+
+	while (n < chunks * 2 && n < ((size_t)1 << 24))
+		n <<= 1;
+
+	return n;
+}
+
+/**
+ * table for the compressor
+ * - chunks: expected number of chunks within the window, the table gets
+ *   twice this size, rounded up to a power of two
+ * - the table of the last call is freed
+ * - returns zero on success
+ */
+MEM_STATIC int MT_dedup_init(MT_Dedup * d, U64 window, size_t chunks)
+{
+	size_t n = MT_dedup_slots(chunks);
+
+	free(d->entry);
+	d->entry = (MT_DedupEntry *) calloc(n, sizeof(MT_DedupEntry));
+	if (!d->entry)
+		return -1;
+	d->mask = n - 1;
+	d->window = window;
+
+	return 0;
+}
+
+/* bytes of the table of MT_dedup_init(), for estimating the memory */
+MEM_STATIC size_t MT_dedup_memory(size_t chunks)
+{
+	return MT_dedup_slots(chunks) * sizeof(MT_DedupEntry);
+}
+
+MEM_STATIC void MT_dedup_free(MT_Dedup * d)
+{
+	free(d->entry);
+	d->entry = 0;
+}
+
+MEM_STATIC void MT_dedup_hash(const void *src, size_t size, U64 hash[2])
+{
+	hash[0] = MT_XXH64(src, size, 0);
+	hash[1] = MT_XXH64(src, size, MT_PRIME64_1);
+}
+
+/**
+ * look for an earlier chunk with the same content
+ * - returns the distance back to it, or zero when there is none
+ * - the chunk at offset is remembered, when it is new or earlier than
+ *   the known one (the workers do not come in the order of the input)
+ * - entries, which are out of the window, are reused first, when all
+ *   probed slots are in use, the oldest one is replaced
+ */
+MEM_STATIC U64 MT_dedup_find(MT_Dedup * d, const U64 hash[2], U64 offset,
+			     U64 size)
+{
+	size_t slot = (size_t)hash[0] & d->mask;
+	MT_DedupEntry *victim = 0;
+	int i, unused = 0;
+
+	for (i = 0; i < MT_DEDUP_PROBES; i++) {
+		MT_DedupEntry *e = &d->entry[(slot + i) & d->mask];
+
+		if (e->size == size && e->hash[0] == hash[0] &&
+		    e->hash[1] == hash[1]) {
+			if (e->offset < offset &&
+			    offset - e->offset <= d->window)
+				return offset - e->offset;
+			if (e->offset > offset)
+				e->offset = offset;
+			return 0;
+		}
+
+		if (!e->size || e->offset + d->window < offset) {
+			if (!unused)
+				victim = e;
+			unused = 1;
+		} else if (!unused) {
+			if (!victim || e->offset < victim->offset)
+				victim = e;
+		}
+	}
+
+	victim->hash[0] = hash[0];
+	victim->hash[1] = hash[1];
+	victim->offset = offset;
+	victim->size = size;
+
+	return 0;
+}
+
+/* writes the window frame, returns its size */
+MEM_STATIC size_t MT_dedup_window(void *dst, U64 window)
+{
+	BYTE *op = (BYTE *)dst;
+
+	MEM_writeLE32(op, MT_DEDUP_MAGIC);
+	MEM_writeLE32(op + 4, MT_DEDUP_WINDOWSIZE);
+	MEM_writeLE64(op + 8, window);
+
+	return 8 + MT_DEDUP_WINDOWSIZE;
+}
+
+/* writes a reference frame, returns its size */
+MEM_STATIC size_t MT_dedup_ref(void *dst, U64 distance, U64 size)
+{
+	BYTE *op = (BYTE *)dst;
+
+	MEM_writeLE32(op, MT_DEDUP_MAGIC);
+	MEM_writeLE32(op + 4, MT_DEDUP_REFSIZE);
+	MEM_writeLE64(op + 8, distance);
+	MEM_writeLE64(op + 16, size);
+
+	return 8 + MT_DEDUP_REFSIZE;
+}
+
+/**
+ * ring buffer with the last output of the decompressor
+ */
+typedef struct {
+	BYTE *buf;
+	size_t size;
+	U64 pos;		/* bytes written so far */
+} MT_Ring;
+
+/* the buffer of the last call is freed, returns zero on success */
+MEM_STATIC int MT_ring_init(MT_Ring * r, U64 window)
+{
+	free(r->buf);
+	r->buf = 0;
+	if (window == 0 || window > MT_DEDUP_WINDOW_MAX ||
+	    window != (size_t)window)
+		return -1;
+
+	r->buf = (BYTE *)malloc((size_t)window);
+	if (!r->buf)
+		return -1;
+	r->size = (size_t)window;
+	r->pos = 0;
+
+	return 0;
+}
+
+MEM_STATIC void MT_ring_free(MT_Ring * r)
+{
+	free(r->buf);
+	r->buf = 0;
+	r->size = 0;
+}
+
+/* remember the output, only its last bytes are kept */
+MEM_STATIC void MT_ring_put(MT_Ring * r, const void *src, size_t size)
+{
+	const BYTE *ip = (const BYTE *)src;
+
+	r->pos += size;
+	if (size > r->size) {
+		ip += size - r->size;
+		size = r->size;
+	}
+
+	while (size) {
+		size_t at = (size_t)((r->pos - size) % r->size);
+		size_t n = r->size - at < size ? r->size - at : size;
+
+		memcpy(r->buf + at, ip, n);
+		ip += n;
+		size -= n;
+	}
+}
+
+/* copy size bytes from distance back, returns -1 when out of range */
+MEM_STATIC int MT_ring_get(const MT_Ring * r, void *dst, U64 distance,
+			   U64 size)
+{
+	BYTE *op = (BYTE *)dst;
+	U64 from;
+
+	if (distance == 0 || distance > r->pos || distance > r->size ||
+	    size > distance)
+		return -1;
+
+	from = r->pos - distance;
+	while (size) {
+		size_t at = (size_t)(from % r->size);
+		size_t n = r->size - at < size ? r->size - at : (size_t)size;
+
+		memcpy(op, r->buf + at, n);
+		op += n;
+		from += n;
+		size -= n;
+	}
+
+	return 0;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* DEDUPMT_H */
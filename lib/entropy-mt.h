@@ -0,0 +1,108 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef ENTROPYMT_H
+#define ENTROPYMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "memmt.h"
+
+/**
+ * incompressible chunk detection
+ *
+ * - encrypted or already compressed input does not get smaller, but
+ *   the codecs spend their full time on it
+ * - so we estimate the order-0 collision entropy (Renyi-2) of some
+ *   samples, for random data each byte value is seen with the same
+ *   probability, so sum(p^2) is near 1/256 then
+ * - 32 samples of 256 bytes are taken, spread over the chunk
+ * - the histogram is done with four tables, so the increments of
+ *   neighbouring bytes do not depend on each other (this is the part,
+ *   which can be done in parallel by the cpu)
+ * - it sees no repetitions of longer strings, so the compressors check
+ *   their result also and store the frame, when it got bigger
+ */
+
+#define MT_SAMPLE_SIZE   256
+#define MT_SAMPLE_COUNT  32
+#define MT_ENTROPY_MIN   (MT_SAMPLE_SIZE * MT_SAMPLE_COUNT * 2)
+
+/* histogram of the samples, sum(c^2) and n of it */
+MEM_STATIC void MT_histogram(const BYTE * ip, size_t size, U64 * sum, U64 * n)
+{
+	U32 count[4][256];
+	size_t step, i, j;
+
+	memset(count, 0, sizeof(count));
+	step = (size - MT_SAMPLE_SIZE) / (MT_SAMPLE_COUNT - 1);
+	for (i = 0; i < MT_SAMPLE_COUNT; i++) {
+		const BYTE *p = ip + i * step;
+		for (j = 0; j < MT_SAMPLE_SIZE; j += 4) {
+			count[0][p[j + 0]]++;
+			count[1][p[j + 1]]++;
+			count[2][p[j + 2]]++;
+			count[3][p[j + 3]]++;
+		}
+	}
+
+	*sum = *n = 0;
+	for (i = 0; i < 256; i++) {
+		U64 c = count[0][i] + count[1][i] + count[2][i] + count[3][i];
+		*sum += c * c;
+		*n += c;
+	}
+}
+
+/* returns 1, when the chunk looks incompressible */
+MEM_STATIC int MT_incompressible(const void *src, size_t size)
+{
+	U64 n, sum;
+
+	/* small chunks are compressed anyway */
+	if (size < MT_ENTROPY_MIN)
+		return 0;
+
+	MT_histogram((const BYTE *)src, size, &sum, &n);
+
+	/**
+	 * 256 * sum(c^2) / n^2 is 1 for perfect random data, plus the
+	 * noise of the sampling, which is about 256 / n; everything
+	 * below 1.07 (7.9 bits per byte) is treated as random
+	 */
+	return sum * 256 * 100 <= n * n * 107 + n * 256 * 100;
+}
+
+/**
+ * returns 25600 * sum(p^2) without the noise of the sampling, which is
+ * 100 for random data, 200 for 7 bits per byte, 400 for 6 bits and so
+ * on; zero means unknown, the chunk is too small for sampling
+ */
+MEM_STATIC U32 MT_collision(const void *src, size_t size)
+{
+	U64 n, sum;
+
+	if (size < MT_ENTROPY_MIN)
+		return 0;
+
+	MT_histogram((const BYTE *)src, size, &sum, &n);
+
+	return (U32)((sum - n) * 256 * 100 / (n * (n - 1)));
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* ENTROPYMT_H */
@@ -0,0 +1,242 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef FRAMEMT_H
+#define FRAMEMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <string.h>
+
+#include "memmt.h"
+#include "xxhash-mt.h"
+#include "bloom-mt.h"
+#include "dedup-mt.h"
+#include "tree-mt.h"
+
+/**
+ * skippable frame header in front of each data frame
+ *
+ * - version 1, with 32 bit compressed size:
+ *
+ *   0x184D2A50, LE32 4, LE32 csize                     (12 bytes)
+ *   0x184D2A50, LE32 8, LE32 csize, LE16 magic, LE16 hint  (16 bytes)
+ *
+ * - version 2, with 64 bit sizes and the uncompressed size:
+ *
+ *   0x184D2A50, LE32 n, LE64 csize, LE64 usize, LE16 magic, LE16 flags,
+ *   [LE64 checksum,] LE32 XXH32 of the header bytes before it
+ *
+ * - the version is told by n (the bytes behind it): 4 or 8 are version
+ *   1, 24 and more are version 2, so other tools skip both
+ * - magic is the codec magic of brotli, snappy and hybrid, else zero
+ * - flags bit 0: the checksum of the uncompressed data is present
+ */
+
+#define MT_FRAME_MAGIC     0x184D2A50U
+#define MT_FRAME_V2SIZE    32	/* header bytes of version 2 */
+#define MT_FRAME_MAXSIZE   64	/* header bytes, which are read at most */
+#define MT_FRAME_CHECKSUM  1
+
+typedef struct {
+	U64 csize;		/* compressed size of the frame */
+	U64 usize;		/* uncompressed size, version 2 only */
+	U64 checksum;		/* with MT_FRAME_CHECKSUM */
+	unsigned magic;		/* codec magic, 16 byte headers only */
+	unsigned flags;
+	int version;
+	size_t hsize;		/* bytes of the header */
+} MT_Frame;
+
+/**
+ * size of the header, from its first 8 bytes, zero when it is none
+ */
+MEM_STATIC size_t MT_frame_hsize(const void *hdr)
+{
+	const BYTE *p = (const BYTE *)hdr;
+	U32 n = MEM_readLE32(p + 4);
+
+	if (MEM_readLE32(p) != MT_FRAME_MAGIC)
+		return 0;
+	if (n == 4 || n == 8)
+		return 8 + n;
+	if (n < MT_FRAME_V2SIZE - 8 || n > MT_FRAME_MAXSIZE - 8 || n & 3)
+		return 0;
+
+	return 8 + n;
+}
+
+/**
+ * write a version 2 header, returns its size
+ * - dst needs MT_FRAME_MAXSIZE bytes
+ */
+MEM_STATIC size_t MT_frame_write(void *dst, const MT_Frame * f)
+{
+	BYTE *d = (BYTE *) dst;
+	size_t n = MT_FRAME_V2SIZE - 4;
+
+	MEM_writeLE64(d + 8, f->csize);
+	MEM_writeLE64(d + 16, f->usize);
+	MEM_writeLE16(d + 24, (U16) f->magic);
+	MEM_writeLE16(d + 26, (U16) f->flags);
+	if (f->flags & MT_FRAME_CHECKSUM) {
+		MEM_writeLE64(d + n, f->checksum);
+		n += 8;
+	}
+	MEM_writeLE32(d + 0, MT_FRAME_MAGIC);
+	MEM_writeLE32(d + 4, (U32) (n + 4 - 8));
+	MEM_writeLE32(d + n, MT_XXH32(d, n, 0));
+
+	return n + 4;
+}
+
+/**
+ * header size of version 2 for the given flags
+ */
+MEM_STATIC size_t MT_frame_v2size(unsigned flags)
+{
+	return MT_FRAME_V2SIZE + (flags & MT_FRAME_CHECKSUM ? 8 : 0);
+}
+
+/**
+ * parse a whole header of MT_frame_hsize() bytes
+ * - returns zero, when it is valid
+ */
+MEM_STATIC int MT_frame_read(MT_Frame * f, const void *hdr)
+{
+	const BYTE *p = (const BYTE *)hdr;
+	size_t hsize = MT_frame_hsize(hdr);
+
+	f->hsize = hsize;
+	f->usize = 0;
+	f->checksum = 0;
+	f->magic = 0;
+	f->flags = 0;
+	if (!hsize)
+		return 1;
+
+	/* version 1 */
+	if (hsize <= 16) {
+		f->version = 1;
+		f->csize = MEM_readLE32(p + 8);
+		if (hsize == 16)
+			f->magic = MEM_readLE16(p + 12);
+		return 0;
+	}
+
+	/* version 2 */
+	if (MEM_readLE32(p + hsize - 4) != MT_XXH32(p, hsize - 4, 0))
+		return 1;
+	f->version = 2;
+	f->csize = MEM_readLE64(p + 8);
+	f->usize = MEM_readLE64(p + 16);
+	f->magic = MEM_readLE16(p + 24);
+	f->flags = MEM_readLE16(p + 26);
+	if (f->flags & MT_FRAME_CHECKSUM) {
+		if (hsize < MT_FRAME_V2SIZE + 8)
+			return 1;
+		f->checksum = MEM_readLE64(p + 28);
+	}
+
+	/* the sizes must fit into size_t */
+	if ((U64) (size_t)f->csize != f->csize ||
+	    (U64) (size_t)f->usize != f->usize)
+		return 1;
+
+	return 0;
+}
+
+/**
+ * check a version 2 header, while searching for a frame
+ * - avail: the bytes of hdr, which can be read
+ */
+MEM_STATIC int MT_frame_valid(const void *hdr, size_t avail)
+{
+	MT_Frame f;
+	size_t hsize = MT_frame_hsize(hdr);
+
+	if (hsize < MT_FRAME_V2SIZE || avail < hsize)
+		return 0;
+
+	return MT_frame_read(&f, hdr) == 0 && f.csize != 0;
+}
+
+/**
+ * kinds of frames, for listing a stream without decoding it
+ */
+#define MT_INFO_DATA     0	/* data frame with its header */
+#define MT_INFO_BLOOM    1	/* bloom filter (see bloom-mt.h) */
+#define MT_INFO_WINDOW   2	/* window of the deduplication */
+#define MT_INFO_REF      3	/* reference of the deduplication */
+#define MT_INFO_SKIP     4	/* any other skippable frame */
+#define MT_INFO_TREE     5	/* root of the tree hash (see tree-mt.h) */
+#define MT_INFO_UNKNOWN  ((U64)-1)
+#define MT_INFO_PEEK     (MT_FRAME_MAXSIZE + 32)
+
+/**
+ * tell the kind and the sizes of the frame at p
+ * - n: the bytes of p, which can be read, up to MT_INFO_PEEK
+ * - *csize gets the bytes of the whole frame, *usize its uncompressed
+ *   size or MT_INFO_UNKNOWN, which version 1 headers do not have
+ * - f gets the header of data frames
+ * - returns -1, when p is no frame of the stream
+ */
+MEM_STATIC int MT_frame_info(const BYTE * p, size_t n, MT_Frame * f,
+			     U64 * csize, U64 * usize)
+{
+	U32 magic, len;
+	size_t hsize;
+
+	if (n < 8)
+		return -1;
+	magic = MEM_readLE32(p);
+	len = MEM_readLE32(p + 4);
+	*csize = 8 + (U64) len;
+	*usize = 0;
+
+	switch (magic) {
+	case MT_FRAME_MAGIC:
+		hsize = MT_frame_hsize(p);
+		if (!hsize || n < hsize || MT_frame_read(f, p))
+			return -1;
+		*csize = hsize + f->csize;
+		*usize = f->version == 2 ? f->usize : MT_INFO_UNKNOWN;
+		return MT_INFO_DATA;
+	case MT_BLOOM_MAGIC:
+		return MT_INFO_BLOOM;
+	case MT_DEDUP_MAGIC:
+		if (len == MT_DEDUP_WINDOWSIZE)
+			return MT_INFO_WINDOW;
+		if (len != MT_DEDUP_REFSIZE || n < 8 + MT_DEDUP_REFSIZE)
+			return -1;
+		*usize = MEM_readLE64(p + 16);
+		return MT_INFO_REF;
+	case MT_TREE_MAGIC:
+		if (len != MT_TREE_SIZE)
+			return -1;
+		return MT_INFO_TREE;
+	}
+
+	/* the other skippable frames of the format */
+	if ((magic & 0xFFFFFFF0U) == 0x184D2A50U)
+		return MT_INFO_SKIP;
+
+	return -1;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* FRAMEMT_H */
@@ -0,0 +1,1493 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#define ZSTD_STATIC_LINKING_ONLY
+#include "zstd.h"
+#include "lz4.h"
+#include "snappy.h"
+
+#include "hybrid-mt.h"
+#include "memmt.h"
+#include "entropy-mt.h"
+#include "chunk-mt.h"
+#include "dedup-mt.h"
+#include "bloom-mt.h"
+#include "frame-mt.h"
+#include "tree-mt.h"
+#include "threading.h"
+#include "list.h"
+#include "pool-mt.h"
+
+/**
+ * multi threaded hybrid - multiple workers version
+ *
+ * - each chunk is compressed by snappy, lz4 or zstd, the codec is
+ *   chosen by some samples of the chunk (see pt_choose()) and stored
+ *   as the magic of the 16 byte frame header
+ *
+ * - each thread works on his own
+ * - no main thread which does reading and then starting the work
+ * - needs a callback for reading / writing
+ * - each worker does his:
+ *   1) get read mutex and read some input
+ *   2) release read mutex and do compression
+ *   3) get write mutex and write result
+ *   4) begin with step 1 again, until no input
+ * - one such round is done by pt_compress_step(), so the workers can
+ *   also run as jobs of a shared pool (see pool-mt.h)
+ */
+
+/* worker for compression */
+typedef struct {
+	HYBRIDMT_CCtx *ctx;
+	pthread_t pthread;
+	HYBRIDMT_Buffer in;
+	size_t result;
+
+	/* codec state of this worker */
+	ZSTD_CCtx *zctx;
+	struct snappy_env env;
+
+	/* placement, see mt_placement() */
+	int cpu;
+	int numa;
+
+	/* timing of the current frame, see pt_account() */
+	unsigned long long t_read;
+	unsigned long long t_busy;
+
+	/* round trip of the frames, see pt_verify() */
+	ZSTD_DCtx *dctx;
+	HYBRIDMT_Buffer check;
+} cwork_t;
+
+struct writelist;
+struct writelist {
+	size_t frame;
+	unsigned long long tstart;
+	int numa;
+	int stored;
+	int dedup;
+	int codec;
+	U64 offset;
+	U64 leaf[2];		/* hash of the chunk, see tree-mt.h */
+	HYBRIDMT_Buffer out;
+	HYBRIDMT_Buffer bloom;	/* bloom frame, behind the output */
+	struct list_head node;
+};
+
+struct HYBRIDMT_CCtx_s {
+	int level;
+
+	/* threads: 1..HYBRIDMT_THREAD_MAX */
+	int threads;
+
+	/* should be used for read from input */
+	int inputsize;
+
+	/* max latency in ms, 0 = disabled */
+	int maxlatency;
+
+	/* content defined chunking, zero when not used */
+	MT_Chunker *chunker;
+	HYBRIDMT_Buffer carry;
+
+	/* borrowed input instead of fn_read, zero when not used */
+	const unsigned char *src;
+	size_t srcsize;
+	size_t srcpos;
+
+	/* frame level deduplication, window zero when not used */
+	MT_Dedup dedup;
+
+	/* bloom filter of each frame in bytes, zero when not used */
+	int bloom;
+
+	/* bytes of the frame header, 16 or MT_frame_v2size() */
+	size_t hsize;
+
+	/* checksum of each frame in its header, MT_FRAME_CHECKSUM or 0 */
+	unsigned checksum;
+
+	/* tree hash of the input: 0 off, 1 root, 2 root and trailer */
+	int tree;
+	MT_Tree leaves;
+	U64 root[2];
+	size_t treeframes;
+
+	/* round trip of each frame, the first failed one counted from one */
+	int verify;
+	size_t errframe;
+	U64 erroffset;
+
+	/* choice of the codec, HYBRIDMT_POLICY_xxx and MB/s wanted */
+	int policy;
+	int mbps;
+	size_t speed[HYBRIDMT_CODEC_MAX];	/* MB/s of one worker */
+
+	/* shared pool, zero when not used */
+	POOLMT_Pool *pool;
+	int weight;
+
+	/* placement of the workers, MT_AFFINITY_xxx */
+	int affinity;
+
+	/* adaptive mode: minthreads .. threads are active, 0 = disabled */
+	int minthreads;
+	int active;
+	int stopped;
+	pthread_cond_t park_cond;
+	size_t parked;
+	size_t unparked;
+
+	/* time of all workers, for the last decision in adapt_xxx */
+	unsigned long long busy_us;
+	unsigned long long read_us;
+	unsigned long long write_us;
+	unsigned long long adapt_last;
+	unsigned long long adapt_busy;
+	unsigned long long adapt_wait;
+
+	/* statistic */
+	size_t insize;
+	size_t outsize;
+	size_t curframe;
+	size_t frames;
+	size_t stored;
+	size_t dedups;
+	size_t codecs[HYBRIDMT_CODEC_MAX];
+	unsigned long long latency_sum;
+	unsigned long long latency_max;
+
+	/* threading */
+	cwork_t *cwork;
+
+	/* reading input */
+	pthread_mutex_t read_mutex;
+	fn_read *fn_read;
+	void *arg_read;
+
+	/* writing output */
+	pthread_mutex_t write_mutex;
+	fn_write *fn_write;
+	void *arg_write;
+
+	/* unordered writing, zero when not used */
+	fn_write_frame *fn_write_frame;
+	void *arg_write_frame;
+
+	/* lists for writing queue */
+	struct list_head writelist_free[MT_NODE_MAX];
+	struct list_head writelist_busy;
+	struct list_head writelist_done;
+};
+
+/* header magic of each codec */
+static const U16 hybrid_magic[HYBRIDMT_CODEC_MAX] = {
+	HYBRIDMT_MAGIC_STORED,
+	HYBRIDMT_MAGIC_SNAPPY,
+	HYBRIDMT_MAGIC_LZ4,
+	HYBRIDMT_MAGIC_ZSTD
+};
+
+/* **************************************
+ * Compression
+ ****************************************/
+
+HYBRIDMT_CCtx *HYBRIDMT_createCCtx(int threads, int level, int inputsize)
+{
+	HYBRIDMT_CCtx *ctx;
+	int t;
+
+	/* allocate ctx */
+	ctx = (HYBRIDMT_CCtx *) malloc(sizeof(HYBRIDMT_CCtx));
+	if (!ctx)
+		return 0;
+
+	/* check threads value */
+	if (threads < 1 || threads > HYBRIDMT_THREAD_MAX)
+		return 0;
+
+	/* check level */
+	if (level < HYBRIDMT_LEVEL_MIN || level > HYBRIDMT_LEVEL_MAX)
+		return 0;
+
+	/* calculate chunksize for one thread */
+	if (inputsize)
+		ctx->inputsize = inputsize;
+	else
+		ctx->inputsize = 1024 * 1024;
+
+	/* setup ctx */
+	ctx->level = level;
+	ctx->threads = threads;
+	ctx->insize = 0;
+	ctx->outsize = 0;
+	ctx->frames = 0;
+	ctx->curframe = 0;
+	ctx->maxlatency = 0;
+	ctx->chunker = 0;
+	ctx->carry.buf = 0;
+	ctx->src = 0;
+	ctx->srcsize = 0;
+	ctx->carry.size = 0;
+	ctx->dedup.entry = 0;
+	ctx->dedup.window = 0;
+	ctx->bloom = 0;
+	ctx->hsize = 16;
+	ctx->checksum = 0;
+	ctx->tree = 0;
+	MT_tree_init(&ctx->leaves);
+	ctx->root[0] = 0;
+	ctx->root[1] = 0;
+	ctx->treeframes = 0;
+	ctx->verify = 0;
+	ctx->errframe = 0;
+	ctx->erroffset = 0;
+	ctx->fn_write_frame = 0;
+	ctx->arg_write_frame = 0;
+	ctx->policy = HYBRIDMT_POLICY_BALANCED;
+	ctx->mbps = 0;
+	ctx->pool = 0;
+	ctx->weight = 1;
+	ctx->affinity = MT_AFFINITY_NONE;
+	ctx->minthreads = 0;
+	ctx->latency_sum = 0;
+	ctx->latency_max = 0;
+
+	pthread_mutex_init(&ctx->read_mutex, NULL);
+	pthread_mutex_init(&ctx->write_mutex, NULL);
+	pthread_cond_init(&ctx->park_cond, NULL);
+
+	/* free -> busy -> out -> free -> ... */
+	for (t = 0; t < MT_NODE_MAX; t++)	/* free, per numa node */
+		INIT_LIST_HEAD(&ctx->writelist_free[t]);
+	INIT_LIST_HEAD(&ctx->writelist_busy);	/* busy */
+	INIT_LIST_HEAD(&ctx->writelist_done);	/* can be written */
+
+	ctx->cwork = (cwork_t *) malloc(sizeof(cwork_t) * threads);
+	if (!ctx->cwork)
+		goto err_cwork;
+
+	for (t = 0; t < threads; t++) {
+		cwork_t *w = &ctx->cwork[t];
+		w->ctx = ctx;
+		w->dctx = 0;
+		w->check.buf = 0;
+		w->check.allocated = 0;
+		w->zctx = ZSTD_createCCtx();
+		if (!w->zctx)
+			goto err_codec;
+		if (snappy_init_env(&w->env) != 0) {
+			ZSTD_freeCCtx(w->zctx);
+			goto err_codec;
+		}
+	}
+
+	return ctx;
+
+ err_codec:
+	while (t--) {
+		ZSTD_freeCCtx(ctx->cwork[t].zctx);
+		snappy_free_env(&ctx->cwork[t].env);
+	}
+	free(ctx->cwork);
+ err_cwork:
+	free(ctx);
+
+	return 0;
+}
+
+/**
+ * mt_error - return mt lib specific error code
+ */
+static size_t mt_error(int rv)
+{
+	switch (rv) {
+	case -1:
+		return MT_ERROR(read_fail);
+	case -2:
+		return MT_ERROR(canceled);
+	case -3:
+		return MT_ERROR(memory_allocation);
+	}
+
+	return MT_ERROR(read_fail);
+}
+
+size_t HYBRIDMT_SetMaxLatencyCCtx(HYBRIDMT_CCtx * ctx, int msec)
+{
+	if (!ctx || msec < 0)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->maxlatency = msec;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetChunkingCCtx(HYBRIDMT_CCtx * ctx, int minsize, int avgsize,
+				int maxsize)
+{
+	if (!ctx || minsize < 0 || avgsize < 0 || maxsize < 0 ||
+	    maxsize > MT_CHUNK_MAX)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	free(ctx->chunker);
+	free(ctx->carry.buf);
+	ctx->chunker = 0;
+	ctx->carry.buf = 0;
+	if (!avgsize)
+		return 0;
+
+	ctx->chunker = (MT_Chunker *) malloc(sizeof(MT_Chunker));
+	if (!ctx->chunker)
+		return MT_ERROR(memory_allocation);
+	MT_chunk_init(ctx->chunker, minsize, avgsize, maxsize);
+
+	/* the bytes behind the last cut, at most one chunk */
+	ctx->carry.buf = malloc(ctx->chunker->max);
+	if (!ctx->carry.buf) {
+		free(ctx->chunker);
+		ctx->chunker = 0;
+		return MT_ERROR(memory_allocation);
+	}
+	ctx->carry.allocated = ctx->chunker->max;
+	ctx->inputsize = (int)ctx->chunker->max;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetDelimiterCCtx(HYBRIDMT_CCtx * ctx, const void *delim, int dlen,
+                                 int tolerance)
+{
+	if (!ctx || dlen < 0 || dlen > MT_DELIM_MAX || (dlen && !delim) ||
+	    tolerance < 1 || tolerance > 99)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	free(ctx->chunker);
+	free(ctx->carry.buf);
+	ctx->chunker = 0;
+	ctx->carry.buf = 0;
+	if (!dlen)
+		return 0;
+
+	ctx->chunker = (MT_Chunker *) malloc(sizeof(MT_Chunker));
+	if (!ctx->chunker)
+		return MT_ERROR(memory_allocation);
+	MT_chunk_delim(ctx->chunker, delim, (size_t)dlen,
+		       (size_t)ctx->inputsize, tolerance);
+
+	/* the bytes behind the last cut, at most one chunk */
+	ctx->carry.buf = malloc(ctx->chunker->max);
+	if (!ctx->carry.buf) {
+		free(ctx->chunker);
+		ctx->chunker = 0;
+		return MT_ERROR(memory_allocation);
+	}
+	ctx->carry.allocated = ctx->chunker->max;
+	ctx->inputsize = (int)ctx->chunker->max;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetBloomCCtx(HYBRIDMT_CCtx * ctx, int size)
+{
+	int bloom = MT_BLOOM_MIN;
+
+	if (!ctx || size < 0 || size > MT_BLOOM_MAX)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	/* rounded down to a power of two */
+	while (bloom * 2 <= size)
+		bloom *= 2;
+	ctx->bloom = size ? bloom : 0;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetHeaderCCtx(HYBRIDMT_CCtx * ctx, int version)
+{
+	if (!ctx || version < 1 || version > 2)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	/* the checksum is part of the version 2 header */
+	if (version == 1)
+		ctx->checksum = 0;
+	ctx->hsize = version == 2 ? MT_frame_v2size(ctx->checksum) : 16;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetChecksumCCtx(HYBRIDMT_CCtx * ctx, int enable)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	/* selects the version 2 header, which has the field for it */
+	ctx->checksum = enable ? MT_FRAME_CHECKSUM : 0;
+	if (enable || ctx->hsize != 16)
+		ctx->hsize = MT_frame_v2size(ctx->checksum);
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetUnorderedCCtx(HYBRIDMT_CCtx * ctx, fn_write_frame * fn, void *arg)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->fn_write_frame = fn;
+	ctx->arg_write_frame = arg;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetTreeHashCCtx(HYBRIDMT_CCtx * ctx, int mode)
+{
+	if (!ctx || mode < 0 || mode > 2)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->tree = mode;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetVerifyCCtx(HYBRIDMT_CCtx * ctx, int enable)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->verify = enable ? 1 : 0;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetSourceCCtx(HYBRIDMT_CCtx * ctx, const void *src, size_t size)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->src = (const unsigned char *)src;
+	ctx->srcsize = src ? size : 0;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetDedupCCtx(HYBRIDMT_CCtx * ctx, int window)
+{
+	if (!ctx || window < 0 || window > 4096)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->dedup.window = (U64) window << 20;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetPolicyCCtx(HYBRIDMT_CCtx * ctx, int policy, int mbps)
+{
+	if (!ctx || policy < HYBRIDMT_POLICY_SPEED ||
+	    policy > HYBRIDMT_POLICY_RATIO || mbps < 0)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->policy = policy;
+	ctx->mbps = mbps;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetPoolCCtx(HYBRIDMT_CCtx * ctx, POOLMT_Pool * pool, int weight)
+{
+	if (!ctx || weight < 1 || weight > POOLMT_WEIGHT_MAX)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->pool = pool;
+	ctx->weight = weight;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetAffinityCCtx(HYBRIDMT_CCtx * ctx, int policy)
+{
+	if (!ctx || (policy != MT_AFFINITY_NONE &&
+		     policy != MT_AFFINITY_SPREAD))
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->affinity = policy;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetAdaptiveCCtx(HYBRIDMT_CCtx * ctx, int minthreads)
+{
+	if (!ctx || minthreads < 0 || minthreads > ctx->threads)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->minthreads = minthreads;
+
+	return 0;
+}
+
+/**
+ * pt_read - read the input chunk of one frame
+ * - without max latency, one call to fn_read will do it
+ * - otherwise we collect partial reads, until the chunk is full, eof is
+ *   reached or the first byte of the chunk got too old
+ * - tstart is set to the time, where the first byte came in
+ */
+static int pt_read(HYBRIDMT_CCtx * ctx, HYBRIDMT_Buffer * in,
+		   unsigned long long *tstart)
+{
+	unsigned long long limit = (unsigned long long)ctx->maxlatency * 1000;
+	size_t done = 0;
+
+	if (!ctx->maxlatency) {
+		int rv = ctx->fn_read(ctx->arg_read, in);
+		*tstart = mt_time_us();
+		return rv;
+	}
+
+	*tstart = mt_time_us();
+	while (done < in->size) {
+		HYBRIDMT_Buffer part;
+		int rv;
+
+		part.buf = (unsigned char *)in->buf + done;
+		part.size = in->size - done;
+		part.allocated = part.size;
+		rv = ctx->fn_read(ctx->arg_read, &part);
+		if (rv < 0)
+			return rv;
+
+		/* eof */
+		if (rv == 0 && part.size == 0)
+			break;
+
+		if (done == 0 && part.size)
+			*tstart = mt_time_us();
+		done += part.size;
+
+		/* flush, what we have */
+		if (done && mt_time_us() - *tstart >= limit)
+			break;
+	}
+	in->size = done;
+
+	return 0;
+}
+
+/**
+ * pt_readchunk - read the input chunk of one frame, content defined
+ * - the carry of the last call comes first, then it is filled up
+ * - the bytes behind the cut point are carried to the next frame
+ * - a short read (eof or max latency) takes the whole buffer
+ */
+static int pt_readchunk(HYBRIDMT_CCtx * ctx, HYBRIDMT_Buffer * in,
+			unsigned long long *tstart)
+{
+	HYBRIDMT_Buffer part;
+	size_t want, cut;
+	int rv;
+
+	memcpy(in->buf, ctx->carry.buf, ctx->carry.size);
+	part.buf = (unsigned char *)in->buf + ctx->carry.size;
+	part.size = want = ctx->chunker->max - ctx->carry.size;
+	part.allocated = part.size;
+	rv = pt_read(ctx, &part, tstart);
+	if (rv != 0)
+		return rv;
+
+	in->size = ctx->carry.size + part.size;
+	if (part.size < want)
+		cut = in->size;
+	else
+		cut = MT_chunk_cut(ctx->chunker, in->buf, in->size);
+
+	ctx->carry.size = in->size - cut;
+	memcpy(ctx->carry.buf, (unsigned char *)in->buf + cut,
+	       ctx->carry.size);
+	in->size = cut;
+
+	return 0;
+}
+
+/**
+ * pt_slice - borrow the input chunk of one frame from the source
+ * - the chunk points into the memory of HYBRIDMT_SetSourceCCtx(), so
+ *   nothing is copied, the content defined cut is found in place
+ */
+static void pt_slice(HYBRIDMT_CCtx * ctx, HYBRIDMT_Buffer * in)
+{
+	size_t left = ctx->srcsize - ctx->srcpos;
+	size_t max = ctx->chunker ? ctx->chunker->max : (size_t)ctx->inputsize;
+
+	in->buf = (void *)(ctx->src + ctx->srcpos);
+	in->size = left < max ? left : max;
+	in->allocated = in->size;
+	if (ctx->chunker && in->size == max)
+		in->size = MT_chunk_cut(ctx->chunker, in->buf, in->size);
+	ctx->srcpos += in->size;
+}
+
+/**
+ * pt_writebloom - write the bloom frame in front of the data frame
+ */
+static int pt_writebloom(HYBRIDMT_CCtx * ctx, struct writelist *wl)
+{
+	if (!wl->bloom.size)
+		return 0;
+	ctx->outsize += wl->bloom.size;
+
+	return ctx->fn_write(ctx->arg_write, &wl->bloom);
+}
+
+/**
+ * pt_writeframe - unordered writing, without the write mutex
+ */
+static int pt_writeframe(HYBRIDMT_CCtx * ctx, struct writelist *wl)
+{
+	if (!ctx->fn_write_frame)
+		return 0;
+
+	return ctx->fn_write_frame(ctx->arg_write_frame, &wl->out, wl->frame,
+				   wl->offset);
+}
+
+/**
+ * pt_write - queue for compressed output
+ */
+static size_t pt_write(HYBRIDMT_CCtx * ctx, struct writelist *wl)
+{
+	struct list_head *entry;
+
+	/* move the entry to the done list */
+	list_move(&wl->node, &ctx->writelist_done);
+
+	/* the leaf of the frame, before unordered mode renumbers it */
+	if (ctx->tree && MT_tree_set(&ctx->leaves, wl->frame, wl->leaf))
+		return MT_ERROR(memory_allocation);
+
+	/* unordered, the worker has written it already */
+	if (ctx->fn_write_frame)
+		wl->frame = ctx->curframe;
+
+	/* the entry isn't the currently needed, return...  */
+	if (wl->frame != ctx->curframe)
+		return 0;
+
+ again:
+	/* check, what can be written ... */
+	list_for_each(entry, &ctx->writelist_done) {
+		wl = list_entry(entry, struct writelist, node);
+		if (wl->frame == ctx->curframe) {
+			int rv = pt_writebloom(ctx, wl);
+			unsigned long long latency;
+
+
+			if (rv == 0 && !ctx->fn_write_frame)
+				rv = ctx->fn_write(ctx->arg_write, &wl->out);
+			if (rv != 0)
+				return mt_error(rv);
+			latency = mt_time_us() - wl->tstart;
+			ctx->latency_sum += latency;
+			if (latency > ctx->latency_max)
+				ctx->latency_max = latency;
+			ctx->outsize += wl->out.size;
+			ctx->stored += wl->stored;
+			ctx->dedups += wl->dedup;
+			if (wl->codec >= 0)
+				ctx->codecs[wl->codec]++;
+			ctx->curframe++;
+			list_move(entry, &ctx->writelist_free[wl->numa]);
+			goto again;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * pt_account - add the timing of one frame, called with write mutex
+ * - in adaptive mode, one worker is parked or unparked every 100ms
+ * - workers, which mostly wait for reading or writing, can be parked
+ *   without losing throughput, but they would block some core
+ * - workers, which mostly compress, are limited by the cpu, so one more
+ *   worker will help, as long as there are free cores
+ */
+static void pt_account(HYBRIDMT_CCtx * ctx, cwork_t * w,
+		       unsigned long long t_write)
+{
+	unsigned long long now, busy, wait;
+
+	ctx->busy_us += w->t_busy;
+	ctx->read_us += w->t_read;
+	ctx->write_us += t_write;
+
+	if (!ctx->minthreads || ctx->pool)
+		return;
+
+	now = mt_time_us();
+	if (now - ctx->adapt_last < 100000)
+		return;
+
+	busy = ctx->busy_us - ctx->adapt_busy;
+	wait = ctx->read_us + ctx->write_us - ctx->adapt_wait;
+	ctx->adapt_last = now;
+	ctx->adapt_busy = ctx->busy_us;
+	ctx->adapt_wait = ctx->read_us + ctx->write_us;
+
+	if (busy * 4 >= (busy + wait) * 3 && ctx->active < ctx->threads) {
+		/* more than 75% compressing */
+		ctx->active++;
+		ctx->unparked++;
+		pthread_cond_broadcast(&ctx->park_cond);
+	} else if (busy * 2 < busy + wait && ctx->active > ctx->minthreads) {
+		/* more than 50% waiting */
+		ctx->active--;
+		ctx->parked++;
+	}
+}
+
+/**
+ * pt_park - wait, while the worker is parked
+ * - all parked workers are released, when some worker has finished,
+ *   they will see eof then also
+ */
+static void pt_park(cwork_t * w)
+{
+	HYBRIDMT_CCtx *ctx = w->ctx;
+	int id = (int)(w - ctx->cwork);
+
+	if (!ctx->minthreads)
+		return;
+
+	pthread_mutex_lock(&ctx->write_mutex);
+	while (id >= ctx->active && !ctx->stopped)
+		pthread_cond_wait(&ctx->park_cond, &ctx->write_mutex);
+	pthread_mutex_unlock(&ctx->write_mutex);
+}
+
+/**
+ * pt_dedup_chunks - expected number of chunks within the dedup window
+ */
+static size_t pt_dedup_chunks(HYBRIDMT_CCtx * ctx)
+{
+	size_t chunk = ctx->chunker ?
+	    ctx->chunker->min : (size_t)ctx->inputsize / 4;
+
+	return (size_t)(ctx->dedup.window / (chunk ? chunk : 1));
+}
+
+/**
+ * pt_dedup - look for an earlier chunk with the same content
+ * - returns 1, when a reference frame was written instead
+ */
+static int pt_dedup(HYBRIDMT_CCtx * ctx, struct writelist *wl,
+		    HYBRIDMT_Buffer * in)
+{
+	U64 hash[2], distance;
+
+	wl->dedup = 0;
+	if (!ctx->dedup.window || in->size == 0)
+		return 0;
+
+	MT_dedup_hash(in->buf, in->size, hash);
+	pthread_mutex_lock(&ctx->write_mutex);
+	distance = MT_dedup_find(&ctx->dedup, hash, wl->offset, in->size);
+	pthread_mutex_unlock(&ctx->write_mutex);
+	if (!distance)
+		return 0;
+
+	wl->out.size = MT_dedup_ref(wl->out.buf, distance, in->size);
+	wl->stored = 0;
+	wl->dedup = 1;
+
+	return 1;
+}
+
+/* the output buffer of one frame, for each of the codecs */
+static size_t pt_bound(size_t size)
+{
+	size_t bound = ZSTD_compressBound(size);
+
+	if ((size_t)LZ4_compressBound((int)size) > bound)
+		bound = (size_t)LZ4_compressBound((int)size);
+	if (snappy_max_compressed_length(size) > bound)
+		bound = snappy_max_compressed_length(size);
+
+	return bound;
+}
+
+/**
+ * pt_choose - select the codec of a chunk
+ * - random looking chunks are stored, chunks with more than 6 bits
+ *   per byte (collision entropy of the samples) get the faster codec
+ *   of the policy, all others the stronger one
+ * - with a wanted throughput, the next faster codec is taken, while
+ *   the measured speed of all active workers stays below it
+ */
+static int pt_choose(HYBRIDMT_CCtx * ctx, HYBRIDMT_Buffer * in)
+{
+	U32 collision;
+	int codec, high;
+
+	if (MT_incompressible(in->buf, in->size))
+		return HYBRIDMT_CODEC_STORED;
+
+	collision = MT_collision(in->buf, in->size);
+	high = collision && collision < 400;
+	switch (ctx->policy) {
+	case HYBRIDMT_POLICY_SPEED:
+		codec = high ? HYBRIDMT_CODEC_SNAPPY : HYBRIDMT_CODEC_LZ4;
+		break;
+	case HYBRIDMT_POLICY_RATIO:
+		codec = HYBRIDMT_CODEC_ZSTD;
+		break;
+	default:
+		codec = high ? HYBRIDMT_CODEC_LZ4 : HYBRIDMT_CODEC_ZSTD;
+		break;
+	}
+
+	if (ctx->mbps) {
+		pthread_mutex_lock(&ctx->write_mutex);
+		while (codec > HYBRIDMT_CODEC_SNAPPY && ctx->speed[codec] &&
+		       ctx->speed[codec] * (size_t)ctx->active <
+		       (size_t)ctx->mbps)
+			codec--;
+		pthread_mutex_unlock(&ctx->write_mutex);
+	}
+
+	return codec;
+}
+
+/**
+ * pt_encode - compress the chunk with the given codec
+ * - returns the compressed size, zero when it should be stored
+ */
+static size_t pt_encode(cwork_t * w, int codec, HYBRIDMT_Buffer * in,
+			unsigned char *dst, size_t capacity)
+{
+	size_t result;
+	int rv;
+
+	switch (codec) {
+	case HYBRIDMT_CODEC_SNAPPY:
+		result = capacity;
+		rv = snappy_compress(&w->env, (const char *)in->buf, in->size,
+				     (char *)dst, &result);
+		if (rv != 0)
+			return 0;
+		break;
+	case HYBRIDMT_CODEC_LZ4:
+		rv = LZ4_compress_default((const char *)in->buf, (char *)dst,
+					  (int)in->size, (int)capacity);
+		if (rv <= 0)
+			return 0;
+		result = (size_t)rv;
+		break;
+	case HYBRIDMT_CODEC_ZSTD:
+		result = ZSTD_compressCCtx(w->zctx, dst, capacity, in->buf,
+					   in->size, w->ctx->level);
+		if (ZSTD_isError(result))
+			return 0;
+		break;
+	default:
+		return 0;
+	}
+
+	return result < in->size ? result : 0;
+}
+
+/* measured speed of one worker for the codec, called with write mutex */
+static void pt_speed(HYBRIDMT_CCtx * ctx, int codec, size_t size,
+		     unsigned long long us)
+{
+	size_t mbps = size / (us ? us : 1);
+
+	if (!ctx->speed[codec])
+		ctx->speed[codec] = mbps;
+	else
+		ctx->speed[codec] = (ctx->speed[codec] * 7 + mbps) / 8;
+}
+
+/**
+ * pt_verify - decode the frame again and compare it with the chunk
+ * - one more byte of output space finds frames, which are too long
+ */
+static size_t pt_verify(cwork_t * w, int codec, const void *src,
+			size_t size, HYBRIDMT_Buffer * in)
+{
+	HYBRIDMT_Buffer *check = &w->check;
+	size_t dsize = 0;
+	int rv;
+
+	if (check->allocated < in->size + 1) {
+		free(check->buf);
+		check->buf = malloc(in->size + 1);
+		check->allocated = check->buf ? in->size + 1 : 0;
+		if (!check->buf)
+			return MT_ERROR(memory_allocation);
+	}
+
+	switch (codec) {
+	case HYBRIDMT_CODEC_SNAPPY:
+		if (!snappy_uncompressed_length((const char *)src, size,
+						&dsize) || dsize != in->size)
+			return MT_ERROR(verify_failed);
+		if (snappy_uncompress((const char *)src, size,
+				      (char *)check->buf))
+			return MT_ERROR(verify_failed);
+		break;
+	case HYBRIDMT_CODEC_LZ4:
+		rv = LZ4_decompress_safe((const char *)src,
+					 (char *)check->buf, (int)size,
+					 (int)in->size + 1);
+		if (rv < 0)
+			return MT_ERROR(verify_failed);
+		dsize = (size_t)rv;
+		break;
+	case HYBRIDMT_CODEC_ZSTD:
+		if (!w->dctx)
+			w->dctx = ZSTD_createDCtx();
+		if (!w->dctx)
+			return MT_ERROR(memory_allocation);
+		dsize = ZSTD_decompressDCtx(w->dctx, check->buf, in->size + 1,
+					    src, size);
+		if (ZSTD_isError(dsize))
+			return MT_ERROR(verify_failed);
+		break;
+	}
+	if (dsize != in->size || memcmp(check->buf, in->buf, in->size))
+		return MT_ERROR(verify_failed);
+
+	return 0;
+}
+
+/**
+ * pt_compress_step - read, compress and write one frame
+ * - returns zero, when there is more work to do
+ * - otherwise the worker is done and w->result holds the error code
+ */
+static int pt_compress_step(void *arg)
+{
+	cwork_t *w = (cwork_t *) arg;
+	HYBRIDMT_CCtx *ctx = w->ctx;
+	HYBRIDMT_Buffer *in = &w->in;
+	HYBRIDMT_Buffer slice;
+	size_t result;
+	struct list_head *entry;
+	struct writelist *wl;
+	int rv;
+	unsigned long long tstart, now;
+
+	/* allocate space for new output */
+	pthread_mutex_lock(&ctx->write_mutex);
+	if (!list_empty(&ctx->writelist_free[w->numa])) {
+		/* take unused entry */
+		entry = list_first(&ctx->writelist_free[w->numa]);
+		wl = list_entry(entry, struct writelist, node);
+		wl->out.size = pt_bound(ctx->inputsize) + ctx->hsize;
+		list_move(entry, &ctx->writelist_busy);
+	} else {
+		/* allocate new one */
+		wl = (struct writelist *)
+		    malloc(sizeof(struct writelist));
+		if (!wl) {
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = MT_ERROR(memory_allocation);
+			return 1;
+		}
+		wl->out.size = pt_bound(ctx->inputsize) + ctx->hsize;
+		wl->out.buf = malloc(wl->out.size +
+				     MT_BLOOM_FRAMESIZE(ctx->bloom));
+		if (!wl->out.buf) {
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = MT_ERROR(memory_allocation);
+			return 1;
+		}
+		wl->numa = w->numa;
+		list_add(&wl->node, &ctx->writelist_busy);
+	}
+	pthread_mutex_unlock(&ctx->write_mutex);
+
+	/* read new input */
+	tstart = mt_time_us();
+	pthread_mutex_lock(&ctx->read_mutex);
+	if (ctx->errframe) {
+		/* a frame failed its round trip, no more input */
+		pthread_mutex_unlock(&ctx->read_mutex);
+
+		pthread_mutex_lock(&ctx->write_mutex);
+		list_move(&wl->node, &ctx->writelist_free[wl->numa]);
+		pthread_mutex_unlock(&ctx->write_mutex);
+
+		w->result = 0;
+		return 1;
+	}
+	if (ctx->src) {
+		in = &slice;
+		pt_slice(ctx, in);
+		wl->tstart = mt_time_us();
+		rv = 0;
+	} else if (ctx->chunker) {
+		rv = pt_readchunk(ctx, in, &wl->tstart);
+	} else {
+		in->size = ctx->inputsize;
+		rv = pt_read(ctx, in, &wl->tstart);
+	}
+	if (rv != 0) {
+		pthread_mutex_unlock(&ctx->read_mutex);
+		w->result = mt_error(rv);
+		return 1;
+	}
+
+	/* eof */
+	if (in->size == 0 && ctx->frames > 0) {
+		pthread_mutex_unlock(&ctx->read_mutex);
+
+		pthread_mutex_lock(&ctx->write_mutex);
+		list_move(&wl->node, &ctx->writelist_free[wl->numa]);
+		pthread_mutex_unlock(&ctx->write_mutex);
+
+		w->result = 0;
+		return 1;
+	}
+	wl->offset = ctx->insize;
+	ctx->insize += in->size;
+	wl->frame = ctx->frames++;
+	pthread_mutex_unlock(&ctx->read_mutex);
+	w->t_read = mt_time_us() - tstart;
+
+	/* compress whole frame, incompressible data is stored */
+	tstart = mt_time_us();
+	wl->codec = -1;
+	wl->bloom.size = 0;
+	/* the leaf of the tree hash, while the chunk is in the cache */
+	if (ctx->tree)
+		MT_tree_leaf(in->buf, in->size, wl->leaf);
+	if (pt_dedup(ctx, wl, in))
+		goto write;
+
+	/* the bloom filter, while the chunk is still in the cache */
+	if (ctx->bloom && !ctx->fn_write_frame) {
+		wl->bloom.buf = (unsigned char *)wl->out.buf + wl->out.size;
+		wl->bloom.size = MT_bloom_frame(wl->bloom.buf, ctx->bloom,
+						in->buf, in->size);
+	}
+	wl->codec = pt_choose(ctx, in);
+	wl->out.size = pt_encode(w, wl->codec, in,
+				 (unsigned char *)wl->out.buf + ctx->hsize,
+				 wl->out.size - ctx->hsize);
+	if (!wl->out.size) {
+		wl->codec = HYBRIDMT_CODEC_STORED;
+		memcpy((unsigned char *)wl->out.buf + ctx->hsize, in->buf,
+		       in->size);
+		wl->out.size = in->size;
+	}
+	wl->stored = wl->codec == HYBRIDMT_CODEC_STORED;
+
+	/* round trip, while the chunk is still in the cache */
+	if (ctx->verify && !wl->stored) {
+		size_t err = pt_verify(w, wl->codec, (unsigned char *)wl->out.buf +
+				       ctx->hsize, wl->out.size, in);
+
+		if (HYBRIDMT_isError(err)) {
+			pthread_mutex_lock(&ctx->read_mutex);
+			if (err == MT_ERROR(verify_failed) &&
+			    (!ctx->errframe || wl->frame < ctx->errframe - 1)) {
+				ctx->errframe = wl->frame + 1;
+				ctx->erroffset = wl->offset;
+			}
+			pthread_mutex_unlock(&ctx->read_mutex);
+			pthread_mutex_lock(&ctx->write_mutex);
+			list_move(&wl->node, &ctx->writelist_free[wl->numa]);
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = err;
+			return 1;
+		}
+	}
+
+	/* version 2 header, with the exact sizes */
+	if (ctx->hsize != 16) {
+		MT_Frame f;
+
+		f.csize = wl->out.size;
+		f.usize = in->size;
+		f.magic = hybrid_magic[wl->codec];
+		f.flags = ctx->checksum;
+		f.checksum = ctx->checksum ?
+		    MT_XXH64(in->buf, in->size, 0) : 0;
+		MT_frame_write(wl->out.buf, &f);
+		wl->out.size += ctx->hsize;
+		goto write;
+	}
+
+	/* write skippable frame, the magic tells the codec */
+	MEM_writeLE32((unsigned char *)wl->out.buf + 0,
+		      HYBRIDMT_MAGIC_SKIPPABLE);
+	MEM_writeLE32((unsigned char *)wl->out.buf + 4, 8);
+	MEM_writeLE32((unsigned char *)wl->out.buf + 8,
+		      (U32) wl->out.size);
+	MEM_writeLE16((unsigned char *)wl->out.buf + 12,
+		      hybrid_magic[wl->codec]);
+
+	/* number of 64KB blocks needed for decompression */
+	MEM_writeLE16((unsigned char *)wl->out.buf + 14,
+		      (U16) ((in->size + 0xffff) >> 16));
+
+	wl->out.size += 16;
+
+ write:
+	/* write result */
+	now = mt_time_us();
+	w->t_busy = now - tstart;
+	rv = pt_writeframe(ctx, wl);
+	pthread_mutex_lock(&ctx->write_mutex);
+	if (wl->codec > HYBRIDMT_CODEC_STORED)
+		pt_speed(ctx, wl->codec, in->size, w->t_busy);
+	result = rv ? mt_error(rv) : pt_write(ctx, wl);
+	pt_account(ctx, w, mt_time_us() - now);
+	pthread_mutex_unlock(&ctx->write_mutex);
+	if (HYBRIDMT_isError(result)) {
+		w->result = result;
+		return 1;
+	}
+
+	return 0;
+}
+
+static void *pt_compress(void *arg)
+{
+	cwork_t *w = (cwork_t *) arg;
+
+	/* the input buffer is touched first by the pinned worker */
+	if (w->cpu >= 0 && mt_pin(w->cpu) == 0 && w->in.size)
+		memset(w->in.buf, 0, w->in.size);
+
+	while (pt_compress_step(w) == 0)
+		pt_park(w);
+
+	/* release the parked workers */
+	pthread_mutex_lock(&w->ctx->write_mutex);
+	w->ctx->stopped++;
+	pthread_cond_broadcast(&w->ctx->park_cond);
+	pthread_mutex_unlock(&w->ctx->write_mutex);
+
+	return (void *)w->result;
+}
+
+/**
+ * pt_tree - hash the tree up to its root, the trailer frame is optional
+ */
+static size_t pt_tree(HYBRIDMT_CCtx * ctx)
+{
+	unsigned char buf[MT_TREE_FRAMESIZE];
+	HYBRIDMT_Buffer b;
+	int rv;
+
+	MT_tree_root(&ctx->leaves, ctx->root);
+	ctx->treeframes = ctx->leaves.count;
+	if (ctx->tree != 2)
+		return 0;
+
+	b.buf = buf;
+	b.size = MT_tree_frame(buf, ctx->treeframes, ctx->root);
+	b.allocated = b.size;
+	rv = ctx->fn_write(ctx->arg_write, &b);
+	if (rv != 0)
+		return mt_error(rv);
+	ctx->outsize += b.size;
+
+	return 0;
+}
+
+size_t HYBRIDMT_compressCCtx(HYBRIDMT_CCtx * ctx, HYBRIDMT_RdWr_t * rdwr)
+{
+	int t;
+	void *retval_of_thread = 0;
+
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	/* init reading and writing functions */
+	ctx->fn_read = rdwr->fn_read;
+	ctx->fn_write = rdwr->fn_write;
+	ctx->arg_read = rdwr->arg_read;
+	ctx->arg_write = rdwr->arg_write;
+
+	/* reset latency statistic */
+	ctx->latency_sum = 0;
+	ctx->latency_max = 0;
+
+	/* reset thread statistic, all workers start unparked */
+	ctx->active = ctx->threads;
+	ctx->stopped = 0;
+	ctx->stored = 0;
+	ctx->treeframes = 0;
+	MT_tree_free(&ctx->leaves);
+	ctx->errframe = 0;
+	ctx->erroffset = 0;
+	ctx->dedups = 0;
+	memset(ctx->codecs, 0, sizeof(ctx->codecs));
+	memset(ctx->speed, 0, sizeof(ctx->speed));
+	ctx->carry.size = 0;
+	ctx->srcpos = 0;
+	ctx->parked = 0;
+	ctx->unparked = 0;
+	ctx->busy_us = 0;
+	ctx->read_us = 0;
+	ctx->write_us = 0;
+	ctx->adapt_last = mt_time_us();
+	ctx->adapt_busy = 0;
+	ctx->adapt_wait = 0;
+
+	/* deduplication, the window frame comes first */
+	if (ctx->dedup.window) {
+		unsigned char hdr[8 + MT_DEDUP_WINDOWSIZE];
+		HYBRIDMT_Buffer b;
+		int rv;
+
+		if (MT_dedup_init(&ctx->dedup, ctx->dedup.window,
+				  pt_dedup_chunks(ctx)))
+			return MT_ERROR(memory_allocation);
+		b.buf = hdr;
+		b.size = MT_dedup_window(hdr, ctx->dedup.window);
+		b.allocated = b.size;
+		rv = ctx->fn_write(ctx->arg_write, &b);
+		if (rv != 0) {
+			MT_dedup_free(&ctx->dedup);
+			return mt_error(rv);
+		}
+		ctx->outsize += b.size;
+	}
+
+	/* inbuf is constant */
+	for (t = 0; t < ctx->threads; t++) {
+		cwork_t *w = &ctx->cwork[t];
+		w->result = 0;
+		w->cpu = -1;
+		w->numa = 0;
+		if (ctx->affinity == MT_AFFINITY_SPREAD && !ctx->pool)
+			mt_placement(t, &w->cpu, &w->numa);
+		/* the chunks of a source are borrowed */
+		w->in.size = ctx->src ? 0 : ctx->inputsize;
+		w->in.buf = w->in.size ? malloc(w->in.size) : 0;
+		if (w->in.size && !w->in.buf) {
+			while (t--)
+				free(ctx->cwork[t].in.buf);
+			return MT_ERROR(memory_allocation);
+		}
+	}
+
+	if (ctx->pool) {
+		/* run the workers as jobs of the shared pool */
+		if (POOLMT_run(ctx->pool, ctx->weight, pt_compress_step,
+			       ctx->cwork, sizeof(cwork_t), ctx->threads))
+			retval_of_thread = (void *)MT_ERROR(memory_allocation);
+	} else {
+		/* start all workers */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *w = &ctx->cwork[t];
+			pthread_create(&w->pthread, NULL, pt_compress, w);
+		}
+
+		/* wait for all workers */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *w = &ctx->cwork[t];
+			pthread_join(w->pthread, 0);
+		}
+	}
+
+	/* collect the results */
+	for (t = 0; t < ctx->threads; t++) {
+		cwork_t *w = &ctx->cwork[t];
+		if (w->result)
+			retval_of_thread = (void *)w->result;
+		free(w->in.buf);
+	}
+
+	/* frames behind a failed one were not written */
+	while (!list_empty(&ctx->writelist_done)) {
+		struct writelist *wl;
+		struct list_head *entry;
+		entry = list_first(&ctx->writelist_done);
+		wl = list_entry(entry, struct writelist, node);
+		list_move(entry, &ctx->writelist_free[wl->numa]);
+	}
+
+	/* clean up lists */
+	for (t = 0; t < MT_NODE_MAX; t++) {
+		while (!list_empty(&ctx->writelist_free[t])) {
+			struct writelist *wl;
+			struct list_head *entry;
+			entry = list_first(&ctx->writelist_free[t]);
+			wl = list_entry(entry, struct writelist, node);
+			free(wl->out.buf);
+			list_del(&wl->node);
+			free(wl);
+		}
+	}
+
+	/* the root of the tree hash, behind the last frame */
+	if (ctx->tree && !retval_of_thread)
+		retval_of_thread = (void *)pt_tree(ctx);
+	MT_tree_free(&ctx->leaves);
+
+	MT_dedup_free(&ctx->dedup);
+
+	return (size_t) retval_of_thread;
+}
+
+/* returns current uncompressed data size */
+size_t HYBRIDMT_GetInsizeCCtx(HYBRIDMT_CCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return ctx->insize;
+}
+
+/* returns the current compressed data size */
+size_t HYBRIDMT_GetOutsizeCCtx(HYBRIDMT_CCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return ctx->outsize;
+}
+
+/* returns the current compressed frames */
+size_t HYBRIDMT_GetFramesCCtx(HYBRIDMT_CCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return ctx->curframe;
+}
+
+/* returns the frames of the tree hash, root gets its root */
+size_t HYBRIDMT_GetTreeHashCCtx(HYBRIDMT_CCtx * ctx, unsigned long long *root)
+{
+	if (!ctx || !ctx->tree)
+		return 0;
+
+	root[0] = ctx->root[0];
+	root[1] = ctx->root[1];
+
+	return ctx->treeframes;
+}
+
+size_t HYBRIDMT_GetErrorFrameCCtx(HYBRIDMT_CCtx * ctx, unsigned long long *offset)
+{
+	if (!ctx)
+		return 0;
+
+	if (offset)
+		*offset = ctx->erroffset;
+
+	return ctx->errframe;
+}
+
+/* returns the estimated memory usage of all workers and the dedup table */
+size_t HYBRIDMT_GetMemoryCCtx(HYBRIDMT_CCtx * ctx)
+{
+	size_t worker, shared;
+
+	if (!ctx)
+		return 0;
+
+	/* input, two outputs (one may wait for writing) and the encoders */
+	worker = ctx->src ? 0 : ctx->inputsize;
+	worker += 2 * (pt_bound(ctx->inputsize) + ctx->hsize +
+		       MT_BLOOM_FRAMESIZE(ctx->bloom));
+	worker += ZSTD_estimateCCtxSize(ctx->level);
+	worker += snappy_max_compressed_length(ctx->inputsize);
+
+	/* the decoded frame and the zstd dctx of the round trip */
+	if (ctx->verify)
+		worker += ctx->inputsize + ZSTD_estimateDCtxSize();
+
+	/* the table of the deduplication is shared by all threads */
+	shared = ctx->dedup.window ? MT_dedup_memory(pt_dedup_chunks(ctx)) : 0;
+
+	return worker * ctx->threads + shared;
+}
+
+/* returns the thread statistic of the last compression */
+size_t HYBRIDMT_GetStatsCCtx(HYBRIDMT_CCtx * ctx, HYBRIDMT_Stats * stats)
+{
+	if (!ctx || !stats)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	stats->threads = ctx->threads;
+	stats->active = ctx->active;
+	stats->parked = ctx->parked;
+	stats->unparked = ctx->unparked;
+	stats->busy_us = ctx->busy_us;
+	stats->read_us = ctx->read_us;
+	stats->write_us = ctx->write_us;
+	stats->stored = ctx->stored;
+	stats->dedup = ctx->dedups;
+	memcpy(stats->codecs, ctx->codecs, sizeof(stats->codecs));
+	memcpy(stats->speed, ctx->speed, sizeof(stats->speed));
+
+	return 0;
+}
+
+/* returns the max latency of the written frames in us */
+size_t HYBRIDMT_GetLatencyMaxCCtx(HYBRIDMT_CCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return (size_t)ctx->latency_max;
+}
+
+/* returns the average latency of the written frames in us */
+size_t HYBRIDMT_GetLatencyAvgCCtx(HYBRIDMT_CCtx * ctx)
+{
+	if (!ctx || !ctx->curframe)
+		return 0;
+
+	return (size_t)(ctx->latency_sum / ctx->curframe);
+}
+
+void HYBRIDMT_freeCCtx(HYBRIDMT_CCtx * ctx)
+{
+	int t;
+
+	if (!ctx)
+		return;
+
+	for (t = 0; t < ctx->threads; t++) {
+		ZSTD_freeCCtx(ctx->cwork[t].zctx);
+		ZSTD_freeDCtx(ctx->cwork[t].dctx);
+		snappy_free_env(&ctx->cwork[t].env);
+		free(ctx->cwork[t].check.buf);
+	}
+
+	pthread_mutex_destroy(&ctx->read_mutex);
+	pthread_mutex_destroy(&ctx->write_mutex);
+	pthread_cond_destroy(&ctx->park_cond);
+	free(ctx->chunker);
+	free(ctx->carry.buf);
+	MT_dedup_free(&ctx->dedup);
+	MT_tree_free(&ctx->leaves);
+	free(ctx->cwork);
+	free(ctx);
+	ctx = 0;
+
+	return;
+}
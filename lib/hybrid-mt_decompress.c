@@ -0,0 +1,1378 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "zstd.h"
+#include "lz4.h"
+#include "snappy.h"
+
+#include "hybrid-mt.h"
+#include "memmt.h"
+#include "dedup-mt.h"
+#include "bloom-mt.h"
+#include "frame-mt.h"
+#include "tree-mt.h"
+#include "range-mt.h"
+#include "threading.h"
+#include "list.h"
+#include "pool-mt.h"
+
+/**
+ * multi threaded hybrid - multiple workers version
+ *
+ * - the magic of each frame header tells the codec of the frame, so
+ *   the workers decode snappy, lz4 and zstd frames in parallel
+ *
+ * - each thread works on his own
+ * - no main thread which does reading and then starting the work
+ * - needs a callback for reading / writing
+ * - each worker does his:
+ *   1) get read mutex and read some input
+ *   2) release read mutex and do compression
+ *   3) get write mutex and write result
+ *   4) begin with step 1 again, until no input
+ * - one such round is done by pt_decompress_step(), so the workers can
+ *   also run as jobs of a shared pool (see pool-mt.h)
+ */
+
+/* worker for compression */
+typedef struct {
+	HYBRIDMT_DCtx *ctx;
+	pthread_t pthread;
+	HYBRIDMT_Buffer in;
+	size_t result;
+	ZSTD_DCtx *zctx;
+} cwork_t;
+
+struct writelist;
+struct writelist {
+	size_t frame;
+	U64 ref[2];		/* distance and size of a reference frame */
+	U64 sum[2];		/* flag and value of the frame checksum */
+	U64 leaf[2];		/* hash of the output, see tree-mt.h */
+	U64 offset;		/* of the frame in the compressed input */
+	U64 outoffset;		/* of the frame in the uncompressed output */
+	HYBRIDMT_Buffer out;
+	struct list_head node;
+};
+
+struct HYBRIDMT_DCtx_s {
+
+	/* threads: 1..HYBRIDMT_THREAD_MAX */
+	int threads;
+
+	/* should be used for read from input */
+	size_t inputsize;
+
+	/* shared pool, zero when not used */
+	POOLMT_Pool *pool;
+	int weight;
+
+	/* last output of a deduplicated stream, see dedup-mt.h */
+	MT_Ring ring;
+
+	/* statistic */
+	size_t insize;
+	size_t outsize;
+	size_t curframe;
+	size_t frames;
+
+	/* first frame with a wrong checksum, counted from one */
+	size_t errframe;
+	U64 erroffset;
+
+	/* tree hash of the output, see tree-mt.h */
+	int tree;
+	MT_Tree leaves;
+	U64 root[2];
+	size_t treeframes;
+	U64 trailer[3];		/* frames and root, zero without trailer */
+
+	/* threading */
+	cwork_t *cwork;
+
+	/* reading input */
+	pthread_mutex_t read_mutex;
+	fn_read *fn_read;
+	void *arg_read;
+
+	/* writing output */
+	pthread_mutex_t write_mutex;
+	fn_write *fn_write;
+	void *arg_write;
+
+	/* unordered writing, zero when not used */
+	fn_write_frame *fn_write_frame;
+	void *arg_write_frame;
+	U64 outpos;		/* offset of the next frame, see pt_outpos() */
+
+	/* verification only, the output is dropped */
+	int verify;
+
+	/* filter of the decoded output, zero when not used */
+	fn_filter *fn_filter;
+	void *arg_filter;
+
+	/* range of the input, see range-mt.h */
+	MT_Range range;
+	fn_read *fn_readrange;
+	void *arg_readrange;
+
+	/* bloom filters of the frames, see bloom-mt.h */
+	HYBRIDMT_Buffer bloom;
+	const void *pattern;
+	size_t patlen;
+	int bloom_line;
+	int bloom_seen;
+	int bloom_skip;
+	size_t skipped;
+
+	/* lists for writing queue */
+	struct list_head writelist_free;
+	struct list_head writelist_busy;
+	struct list_head writelist_done;
+};
+
+/* **************************************
+ * Decompression
+ ****************************************/
+
+HYBRIDMT_DCtx *HYBRIDMT_createDCtx(int threads, int inputsize)
+{
+	HYBRIDMT_DCtx *ctx;
+	int t;
+
+	/* allocate ctx */
+	ctx = (HYBRIDMT_DCtx *) malloc(sizeof(HYBRIDMT_DCtx));
+	if (!ctx)
+		return 0;
+
+	/* check threads value */
+	if (threads < 1 || threads > HYBRIDMT_THREAD_MAX)
+		return 0;
+
+	/* setup ctx */
+	ctx->threads = threads;
+	ctx->insize = 0;
+	ctx->outsize = 0;
+	ctx->frames = 0;
+	ctx->errframe = 0;
+	ctx->erroffset = 0;
+	ctx->tree = 0;
+	MT_tree_init(&ctx->leaves);
+	ctx->treeframes = 0;
+	ctx->trailer[0] = 0;
+	ctx->curframe = 0;
+	ctx->pool = 0;
+	ctx->weight = 1;
+	ctx->ring.buf = 0;
+	ctx->ring.size = 0;
+	ctx->fn_write_frame = 0;
+	ctx->verify = 0;
+	ctx->arg_write_frame = 0;
+	ctx->fn_filter = 0;
+	ctx->arg_filter = 0;
+	MT_range_init(&ctx->range);
+	ctx->bloom.buf = 0;
+	ctx->bloom.size = 0;
+	ctx->bloom.allocated = 0;
+	ctx->pattern = 0;
+	ctx->patlen = 0;
+	ctx->skipped = 0;
+
+	/* will be used for single stream only */
+	if (inputsize)
+		ctx->inputsize = inputsize;
+	else
+		ctx->inputsize = 1024 * 64;	/* 64K buffer */
+
+	pthread_mutex_init(&ctx->read_mutex, NULL);
+	pthread_mutex_init(&ctx->write_mutex, NULL);
+
+	INIT_LIST_HEAD(&ctx->writelist_free);
+	INIT_LIST_HEAD(&ctx->writelist_busy);
+	INIT_LIST_HEAD(&ctx->writelist_done);
+
+	ctx->cwork = (cwork_t *) malloc(sizeof(cwork_t) * threads);
+	if (!ctx->cwork)
+		goto err_cwork;
+
+	for (t = 0; t < threads; t++) {
+		cwork_t *w = &ctx->cwork[t];
+		w->ctx = ctx;
+		w->zctx = ZSTD_createDCtx();
+		if (!w->zctx)
+			goto err_codec;
+	}
+
+	return ctx;
+
+ err_codec:
+	while (t--)
+		ZSTD_freeDCtx(ctx->cwork[t].zctx);
+	free(ctx->cwork);
+ err_cwork:
+	free(ctx);
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetPoolDCtx(HYBRIDMT_DCtx * ctx, POOLMT_Pool * pool, int weight)
+{
+	if (!ctx || weight < 1 || weight > POOLMT_WEIGHT_MAX)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->pool = pool;
+	ctx->weight = weight;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetUnorderedDCtx(HYBRIDMT_DCtx * ctx, fn_write_frame * fn, void *arg)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->fn_write_frame = fn;
+	ctx->arg_write_frame = arg;
+
+	return 0;
+}
+
+/**
+ * pt_verify - sink of the verification, the buffer is reused at once
+ */
+static int pt_verify(void *arg, HYBRIDMT_Buffer * out, size_t frame,
+		     unsigned long long offset)
+{
+	(void)arg;
+	(void)out;
+	(void)frame;
+	(void)offset;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetVerifyDCtx(HYBRIDMT_DCtx * ctx, int enable)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->verify = enable != 0;
+	ctx->fn_write_frame = enable ? pt_verify : 0;
+	ctx->arg_write_frame = 0;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetTreeHashDCtx(HYBRIDMT_DCtx * ctx, int enable)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->tree = enable != 0;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetRangeDCtx(HYBRIDMT_DCtx * ctx, unsigned long long start,
+			  unsigned long long end)
+{
+	if (!ctx || (end && end <= start))
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->range.start = start;
+	ctx->range.end = end;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetFilterDCtx(HYBRIDMT_DCtx * ctx, fn_filter * fn, void *arg)
+{
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->fn_filter = fn;
+	ctx->arg_filter = arg;
+
+	return 0;
+}
+
+size_t HYBRIDMT_SetBloomDCtx(HYBRIDMT_DCtx * ctx, const void *pattern, int len)
+{
+	if (!ctx || len < 0)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	ctx->pattern = len ? pattern : 0;
+	ctx->patlen = (size_t)len;
+
+	return 0;
+}
+
+/**
+ * mt_error - return mt lib specific error code
+ */
+static size_t mt_error(int rv)
+{
+	switch (rv) {
+	case -1:
+		return MT_ERROR(read_fail);
+	case -2:
+		return MT_ERROR(canceled);
+	case -3:
+		return MT_ERROR(memory_allocation);
+	}
+
+	/* XXX, some catch all other errors */
+	return MT_ERROR(read_fail);
+}
+
+/**
+ * pt_filter - run the filter on some decoded output
+ */
+static size_t pt_filter(HYBRIDMT_DCtx * ctx, HYBRIDMT_Buffer * out)
+{
+	int rv;
+
+	if (!ctx->fn_filter)
+		return 0;
+	rv = ctx->fn_filter(ctx->arg_filter, out);
+	if (rv != 0)
+		return mt_error(rv);
+
+	return 0;
+}
+
+/**
+ * pt_writeframe - write a decoded frame, without waiting for the others
+ */
+static size_t pt_writeframe(HYBRIDMT_DCtx * ctx, struct writelist *wl)
+{
+	int rv;
+
+	rv = ctx->fn_write_frame(ctx->arg_write_frame, &wl->out, wl->frame,
+				 wl->outoffset);
+	if (rv != 0)
+		return mt_error(rv);
+
+	return 0;
+}
+
+/**
+ * pt_write - queue for decompressed output
+ */
+static size_t pt_write(HYBRIDMT_DCtx * ctx, struct writelist *wl)
+{
+	struct list_head *entry;
+
+	/* move the entry to the done list */
+	list_move(&wl->node, &ctx->writelist_done);
+
+	/* the leaf of the frame, the frames may come in any order here */
+	if (ctx->tree && !wl->ref[0] &&
+	    MT_tree_set(&ctx->leaves, wl->frame, wl->leaf))
+		return MT_ERROR(memory_allocation);
+
+	/* unordered, the worker has written it already */
+	if (ctx->fn_write_frame && !ctx->ring.buf)
+		wl->frame = ctx->curframe;
+ again:
+	/* check, what can be written ... */
+	list_for_each(entry, &ctx->writelist_done) {
+		wl = list_entry(entry, struct writelist, node);
+		if (wl->frame == ctx->curframe) {
+			int rv;
+
+			/* copy the referenced output */
+			if (wl->ref[0] &&
+			    MT_ring_get(&ctx->ring, wl->out.buf, wl->ref[0],
+					wl->ref[1]))
+				return MT_ERROR(data_error);
+			if (wl->ref[0] && ctx->tree) {
+				MT_tree_leaf(wl->out.buf, wl->out.size,
+					     wl->leaf);
+				if (MT_tree_set(&ctx->leaves, wl->frame,
+						wl->leaf))
+					return MT_ERROR(memory_allocation);
+			}
+
+			/* the ring needs the output, before it's filtered */
+			if (ctx->ring.buf) {
+				size_t result;
+
+				wl->outoffset = ctx->ring.pos;
+				MT_ring_put(&ctx->ring, wl->out.buf,
+					    wl->out.size);
+				result = pt_filter(ctx, &wl->out);
+				if (HYBRIDMT_isError(result))
+					return result;
+			}
+			if (!ctx->fn_write_frame) {
+				rv = ctx->fn_write(ctx->arg_write, &wl->out);
+				if (rv != 0)
+					return mt_error(rv);
+			} else if (ctx->ring.buf) {
+				size_t result = pt_writeframe(ctx, wl);
+
+				if (HYBRIDMT_isError(result))
+					return result;
+			}
+			ctx->outsize += wl->out.size;
+			ctx->curframe++;
+			list_move(entry, &ctx->writelist_free);
+			goto again;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * pt_window - read the window frame of a deduplicated stream
+ * - the magic is already read, the ring buffer gets allocated
+ */
+static size_t pt_window(HYBRIDMT_DCtx * ctx)
+{
+	unsigned char buf[4 + MT_DEDUP_WINDOWSIZE];
+	HYBRIDMT_Buffer in;
+	U64 window;
+	int rv;
+
+	in.buf = buf;
+	in.size = sizeof(buf);
+	rv = ctx->fn_read(ctx->arg_read, &in);
+	if (rv != 0)
+		return mt_error(rv);
+	if (in.size != sizeof(buf) ||
+	    MEM_readLE32(buf) != MT_DEDUP_WINDOWSIZE)
+		return MT_ERROR(data_error);
+
+	window = MEM_readLE64(buf + 4);
+	if (window == 0 || window > MT_DEDUP_WINDOW_MAX)
+		return MT_ERROR(data_error);
+	if (MT_ring_init(&ctx->ring, window))
+		return MT_ERROR(memory_allocation);
+	ctx->insize += 8 + MT_DEDUP_WINDOWSIZE;
+
+	return 0;
+}
+
+/**
+ * pt_readref - read the rest of a reference frame
+ * - done bytes of it are already in hdr, behind the magic
+ */
+static int pt_readref(HYBRIDMT_DCtx * ctx, unsigned char *hdr, size_t done,
+		      U64 * ref)
+{
+	unsigned char buf[4 + MT_DEDUP_REFSIZE];
+	HYBRIDMT_Buffer in;
+	int rv;
+
+	memcpy(buf, hdr + 4, done);
+	in.buf = buf + done;
+	in.size = sizeof(buf) - done;
+	rv = ctx->fn_read(ctx->arg_read, &in);
+	if (rv != 0)
+		return rv;
+	if (in.size != sizeof(buf) - done || !ctx->ring.buf ||
+	    MEM_readLE32(buf) != MT_DEDUP_REFSIZE)
+		return 1;
+
+	ref[0] = MEM_readLE64(buf + 4);
+	ref[1] = MEM_readLE64(buf + 12);
+	if (ref[0] == 0 || ref[0] > ctx->ring.size || ref[1] > ref[0])
+		return 1;
+	ctx->insize += 8 + MT_DEDUP_REFSIZE;
+
+	return 0;
+}
+
+/**
+ * pt_trailer - read the rest of the trailer frame of the tree hash
+ * - done bytes of it are already in hdr, behind the magic
+ */
+static int pt_trailer(HYBRIDMT_DCtx * ctx, unsigned char *hdr, size_t done)
+{
+	unsigned char buf[4 + MT_TREE_SIZE];
+	HYBRIDMT_Buffer in;
+	int rv;
+
+	memcpy(buf, hdr + 4, done);
+	in.buf = buf + done;
+	in.size = sizeof(buf) - done;
+	rv = ctx->fn_read(ctx->arg_read, &in);
+	if (rv != 0)
+		return rv;
+	if (in.size != sizeof(buf) - done ||
+	    MEM_readLE32(buf) != MT_TREE_SIZE ||
+	    MT_tree_read(buf + 4, &ctx->trailer[0], ctx->trailer + 1))
+		return 1;
+	ctx->insize += MT_TREE_FRAMESIZE;
+
+	return 0;
+}
+
+/**
+ * pt_bloom - read the rest of a bloom frame
+ * - done bytes of it are already in hdr, behind the magic
+ * - with a pattern, the next data frame is marked for skipping, when
+ *   the pattern is not in its filter and the frame has whole lines
+ */
+static int pt_bloom(HYBRIDMT_DCtx * ctx, unsigned char *hdr, size_t done)
+{
+	unsigned char buf[8];
+	HYBRIDMT_Buffer in;
+	size_t size, have = done < 8 ? done : 8;
+	U32 flags;
+	int rv;
+
+	memcpy(buf, hdr + 4, have);
+	in.buf = buf + have;
+	in.size = 8 - have;
+	if (in.size) {
+		rv = ctx->fn_read(ctx->arg_read, &in);
+		if (rv != 0)
+			return rv;
+		if (in.size != 8 - have)
+			return 1;
+	}
+
+	size = MEM_readLE32(buf);
+	flags = MEM_readLE32(buf + 4);
+	if (size < 4 + MT_BLOOM_MIN || size > 4 + MT_BLOOM_MAX)
+		return 1;
+	size -= 4;
+	if (size & (size - 1))
+		return 1;
+
+	if (ctx->bloom.allocated < size) {
+		void *b = realloc(ctx->bloom.buf, size);
+		if (!b)
+			return 1;
+		ctx->bloom.buf = b;
+		ctx->bloom.allocated = size;
+	}
+	memcpy(ctx->bloom.buf, hdr + 12, done - have);
+	in.buf = (unsigned char *)ctx->bloom.buf + (done - have);
+	in.size = size - (done - have);
+	rv = ctx->fn_read(ctx->arg_read, &in);
+	if (rv != 0)
+		return rv;
+	if (in.size != size - (done - have))
+		return 1;
+	ctx->insize += MT_BLOOM_HDRSIZE + size;
+
+	/* a deduplicated stream needs all frames for the ring buffer */
+	ctx->bloom_skip = ctx->pattern && !ctx->ring.buf && ctx->bloom_line &&
+	    (flags & MT_BLOOM_NEWLINE) &&
+	    !MT_bloom_test(ctx->bloom.buf, size, ctx->pattern, ctx->patlen);
+	ctx->bloom_line = flags & MT_BLOOM_NEWLINE;
+	ctx->bloom_seen = 1;
+
+	return 0;
+}
+
+/**
+ * pt_header - read the rest of a frame header and parse it
+ * - done bytes of it are already in hdr, which has MT_FRAME_MAXSIZE
+ */
+static int pt_header(HYBRIDMT_DCtx * ctx, unsigned char *hdr, size_t done,
+		     MT_Frame * f)
+{
+	HYBRIDMT_Buffer in;
+	size_t hsize = MT_frame_hsize(hdr);
+	int rv;
+
+	if (hsize > done) {
+		in.buf = hdr + done;
+		in.size = hsize - done;
+		in.allocated = 0;
+		rv = ctx->fn_read(ctx->arg_read, &in);
+		if (rv != 0)
+			return rv;
+		if (in.size != hsize - done)
+			return 1;
+	}
+	if (MT_frame_read(f, hdr))
+		return 1;
+
+	/* version 1 has 8 bytes behind the magic */
+	return f->version == 1 && f->hsize != 16;
+}
+
+/**
+ * pt_valid - check a frame header, while searching the range start
+ */
+static int pt_valid(const BYTE * hdr, size_t avail)
+{
+	if (MEM_readLE32(hdr + 4) != 8)
+		return MT_frame_valid(hdr, avail);
+	if (MEM_readLE32(hdr + 8) == 0)
+		return 0;
+
+	switch (MEM_readLE16(hdr + 12)) {
+	case HYBRIDMT_MAGIC_STORED:
+	case HYBRIDMT_MAGIC_SNAPPY:
+	case HYBRIDMT_MAGIC_LZ4:
+	case HYBRIDMT_MAGIC_ZSTD:
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+ * pt_readrange - the bytes of the range search come first
+ */
+static int pt_readrange(void *arg, HYBRIDMT_Buffer * in)
+{
+	HYBRIDMT_DCtx *ctx = (HYBRIDMT_DCtx *) arg;
+	HYBRIDMT_Buffer rest;
+	size_t done = MT_range_get(&ctx->range, in->buf, in->size);
+	int rv;
+
+	if (done == in->size)
+		return 0;
+	rest.buf = (unsigned char *)in->buf + done;
+	rest.size = in->size - done;
+	rest.allocated = 0;
+	rv = ctx->fn_readrange(ctx->arg_readrange, &rest);
+	in->size = done + rest.size;
+
+	return rv;
+}
+
+/**
+ * pt_resync - go to the first frame header of the range
+ * - the input begins at range.start, returns 1 when there is none
+ */
+static int pt_resync(HYBRIDMT_DCtx * ctx)
+{
+	MT_Range *r = &ctx->range;
+	HYBRIDMT_Buffer in;
+	U64 pos = r->start;
+	size_t keep = 0, found;
+	int rv;
+
+	MT_range_free(r);
+	r->insize = ctx->insize;
+	r->left = r->end ? r->end - r->start : 0;
+	if (!r->start)
+		return 0;
+
+	r->buf = (BYTE *) malloc(MT_RANGE_BUFSIZE);
+	if (!r->buf)
+		return -3;
+	for (;;) {
+		in.buf = r->buf + keep;
+		in.size = MT_RANGE_BUFSIZE - keep;
+		in.allocated = 0;
+		rv = ctx->fn_read(ctx->arg_read, &in);
+		if (rv != 0)
+			return rv;
+		r->size = keep + in.size;
+		found = MT_range_find(r->buf, r->size, MT_RANGE_HDRMIN,
+				      pt_valid);
+		if (found < r->size)
+			break;
+
+		/* a header may begin within the last bytes */
+		keep = r->size < MT_RANGE_HDRMAX - 1 ?
+		    r->size : MT_RANGE_HDRMAX - 1;
+		pos += r->size - keep;
+		if (in.size == 0 || (r->end && pos >= r->end))
+			return 1;
+		memmove(r->buf, r->buf + r->size - keep, keep);
+	}
+	if (r->end && pos + found >= r->end)
+		return 1;
+
+	/* the following reads begin with the frame header */
+	r->pos = found;
+	r->left = r->end ? r->end - (pos + found) : 0;
+	ctx->fn_readrange = ctx->fn_read;
+	ctx->arg_readrange = ctx->arg_read;
+	ctx->fn_read = pt_readrange;
+	ctx->arg_read = ctx;
+
+	return 0;
+}
+
+/**
+ * pt_usize - uncompressed size of a data frame
+ * - version 2 headers have it, otherwise the size within the data of
+ *   the codec, lz4 has none, MT_INFO_UNKNOWN then
+ */
+static U64 pt_usize(const MT_Frame * f, const BYTE * data, size_t size)
+{
+	unsigned long long fcs;
+	size_t n;
+
+	if (f->version == 2)
+		return f->usize;
+
+	switch (f->magic) {
+	case HYBRIDMT_MAGIC_STORED:
+		return f->csize;
+	case HYBRIDMT_MAGIC_SNAPPY:
+		if (snappy_uncompressed_length((const char *)data, size, &n))
+			return n;
+		break;
+	case HYBRIDMT_MAGIC_ZSTD:
+		fcs = ZSTD_getFrameContentSize(data, size);
+		if (fcs != ZSTD_CONTENTSIZE_UNKNOWN &&
+		    fcs != ZSTD_CONTENTSIZE_ERROR)
+			return fcs;
+		break;
+	}
+
+	return MT_INFO_UNKNOWN;
+}
+
+/**
+ * pt_outpos - offset of the next frame in the uncompressed output
+ * - called under the read mutex in the order of the input, the offsets
+ *   of the frames are known before the earlier ones are decoded
+ * - after a frame of unknown size, all offsets are MT_INFO_UNKNOWN
+ */
+static U64 pt_outpos(HYBRIDMT_DCtx * ctx, U64 usize)
+{
+	U64 pos = ctx->outpos;
+
+	if (pos != MT_INFO_UNKNOWN)
+		ctx->outpos = usize == MT_INFO_UNKNOWN ?
+		    MT_INFO_UNKNOWN : pos + usize;
+
+	return pos;
+}
+
+/**
+ * pt_read - read compressed output
+ */
+static size_t pt_read(HYBRIDMT_DCtx * ctx, HYBRIDMT_Buffer * in, size_t * frame,
+		      size_t * uncompressed, int *codec, U64 * offset,
+		      U64 * outoffset, U64 * ref, U64 * sum)
+{
+	unsigned char hdrbuf[MT_FRAME_MAXSIZE];
+	HYBRIDMT_Buffer hdr;
+	MT_Frame f;
+	int rv;
+
+	/* read skippable frame (12 or 16 bytes) */
+	pthread_mutex_lock(&ctx->read_mutex);
+	ref[0] = 0;
+	sum[0] = 0;
+	*offset = ctx->insize;
+
+	/* special case, first 4 bytes already read */
+	if (ctx->frames == 0 && !ctx->skipped) {
+		MEM_writeLE32(hdrbuf, HYBRIDMT_MAGIC_SKIPPABLE);
+		hdr.buf = hdrbuf + 4;
+		hdr.size = 12;
+		rv = ctx->fn_read(ctx->arg_read, &hdr);
+		if (rv != 0) {
+			pthread_mutex_unlock(&ctx->read_mutex);
+			return mt_error(rv);
+		}
+		if (hdr.size != 12)
+			goto error_read;
+		hdr.buf = hdrbuf;
+	} else {
+ next:
+		*offset = ctx->insize;
+		/* end of the range ? */
+		if (MT_range_done(&ctx->range, ctx->insize)) {
+			pthread_mutex_unlock(&ctx->read_mutex);
+			in->size = 0;
+			return 0;
+		}
+		hdr.buf = hdrbuf;
+		hdr.size = 16;
+		rv = ctx->fn_read(ctx->arg_read, &hdr);
+		if (rv != 0) {
+			pthread_mutex_unlock(&ctx->read_mutex);
+			return mt_error(rv);
+		}
+		/* eof reached ? */
+		if (hdr.size == 0) {
+			pthread_mutex_unlock(&ctx->read_mutex);
+			in->size = 0;
+			return 0;
+		}
+		if (hdr.size != 16)
+			goto error_read;
+		if (MEM_readLE32((unsigned char *)hdr.buf + 0) ==
+		    MT_BLOOM_MAGIC) {
+			if (pt_bloom(ctx, hdr.buf, 12))
+				goto error_data;
+			goto next;
+		}
+		if (MEM_readLE32((unsigned char *)hdr.buf + 0) ==
+		    MT_TREE_MAGIC) {
+			if (pt_trailer(ctx, hdr.buf, 12))
+				goto error_data;
+			goto next;
+		}
+		if (MEM_readLE32((unsigned char *)hdr.buf + 0) ==
+		    MT_DEDUP_MAGIC)
+			goto dedup_ref;
+		if (MEM_readLE32((unsigned char *)hdr.buf + 0) !=
+		    HYBRIDMT_MAGIC_SKIPPABLE)
+			goto error_data;
+	}
+
+	/* check header data, version 1 or 2 */
+	if (pt_header(ctx, hdr.buf, 16, &f))
+		goto error_data;
+	sum[0] = f.flags & MT_FRAME_CHECKSUM;
+	sum[1] = f.checksum;
+	switch (f.magic) {
+	case HYBRIDMT_MAGIC_STORED:
+		*codec = HYBRIDMT_CODEC_STORED;
+		break;
+	case HYBRIDMT_MAGIC_SNAPPY:
+		*codec = HYBRIDMT_CODEC_SNAPPY;
+		break;
+	case HYBRIDMT_MAGIC_LZ4:
+		*codec = HYBRIDMT_CODEC_LZ4;
+		break;
+	case HYBRIDMT_MAGIC_ZSTD:
+		*codec = HYBRIDMT_CODEC_ZSTD;
+		break;
+	default:
+		goto error_data;
+	}
+
+	/* get uncompressed size for output buffer, exact with version 2 */
+	if (f.version == 2) {
+		*uncompressed = (size_t)f.usize;
+	} else {
+		U16 hintsize = MEM_readLE16((unsigned char *)hdr.buf + 14);
+		*uncompressed = hintsize << 16;
+	}
+
+	ctx->insize += f.hsize;
+	/* read new inputsize */
+	{
+		size_t toRead = (size_t)f.csize;
+		if (in->allocated < toRead) {
+			/* need bigger input buffer */
+			if (in->allocated)
+				in->buf = realloc(in->buf, toRead);
+			else
+				in->buf = malloc(toRead);
+			if (!in->buf)
+				goto error_nomem;
+			in->allocated = toRead;
+		}
+
+		in->size = toRead;
+		rv = ctx->fn_read(ctx->arg_read, in);
+		/* generic read failure! */
+		if (rv != 0) {
+			pthread_mutex_unlock(&ctx->read_mutex);
+			return mt_error(rv);
+		}
+		/* needed more bytes! */
+		if (in->size != toRead)
+			goto error_data;
+		if (*codec == HYBRIDMT_CODEC_STORED)
+			*uncompressed = toRead;
+
+		ctx->insize += in->size;
+	}
+	*outoffset = pt_outpos(ctx, pt_usize(&f, in->buf, in->size));
+
+	/* the pattern is not in this frame, go on with the next one */
+	if (ctx->bloom_skip) {
+		ctx->bloom_skip = 0;
+		ctx->bloom_seen = 0;
+		ctx->skipped++;
+		goto next;
+	}
+	if (!ctx->bloom_seen)
+		ctx->bloom_line = 0;
+	ctx->bloom_seen = 0;
+	*frame = ctx->frames++;
+	pthread_mutex_unlock(&ctx->read_mutex);
+
+	/* done, no error */
+	return 0;
+
+ dedup_ref:
+	/* the output is copied from the ring buffer by pt_write() */
+	if (pt_readref(ctx, hdr.buf, 12, ref))
+		goto error_data;
+	*uncompressed = (size_t)ref[1];
+	*codec = HYBRIDMT_CODEC_STORED;
+	in->size = 0;
+	*outoffset = pt_outpos(ctx, ref[1]);
+	*frame = ctx->frames++;
+	pthread_mutex_unlock(&ctx->read_mutex);
+	return 0;
+
+ error_data:
+	pthread_mutex_unlock(&ctx->read_mutex);
+	return MT_ERROR(data_error);
+ error_read:
+	pthread_mutex_unlock(&ctx->read_mutex);
+	return MT_ERROR(read_fail);
+ error_nomem:
+	pthread_mutex_unlock(&ctx->read_mutex);
+	return MT_ERROR(memory_allocation);
+}
+
+/**
+ * pt_decode - decompress one frame with its codec
+ * - out->size is the allocated size before, the real size afterwards
+ */
+static size_t pt_decode(cwork_t * w, int codec, HYBRIDMT_Buffer * in,
+			HYBRIDMT_Buffer * out)
+{
+	size_t size;
+	int rv;
+
+	switch (codec) {
+	case HYBRIDMT_CODEC_SNAPPY:
+		if (snappy_uncompressed_length((const char *)in->buf, in->size,
+					       &size) == 0 ||
+		    size > out->size)
+			return MT_ERROR(data_error);
+		rv = snappy_uncompress((const char *)in->buf, in->size,
+				       (char *)out->buf);
+		if (rv != 0)
+			return MT_ERROR(frame_decompress);
+		out->size = size;
+		break;
+	case HYBRIDMT_CODEC_LZ4:
+		rv = LZ4_decompress_safe((const char *)in->buf,
+					 (char *)out->buf, (int)in->size,
+					 (int)out->size);
+		if (rv < 0)
+			return MT_ERROR(frame_decompress);
+		out->size = (size_t)rv;
+		break;
+	case HYBRIDMT_CODEC_ZSTD:
+		size = ZSTD_decompressDCtx(w->zctx, out->buf, out->size,
+					   in->buf, in->size);
+		if (ZSTD_isError(size))
+			return MT_ERROR(frame_decompress);
+		out->size = size;
+		break;
+	default:
+		return MT_ERROR(data_error);
+	}
+
+	return 0;
+}
+
+/**
+ * pt_corrupt - a frame has a wrong checksum or can not be decoded,
+ * remember the first one, returns err
+ */
+static size_t pt_corrupt(HYBRIDMT_DCtx * ctx, struct writelist *wl, size_t err)
+{
+	pthread_mutex_lock(&ctx->write_mutex);
+	if (!ctx->errframe || wl->frame < ctx->errframe - 1) {
+		ctx->errframe = wl->frame + 1;
+		ctx->erroffset = wl->offset;
+	}
+	pthread_mutex_unlock(&ctx->write_mutex);
+
+	return err;
+}
+
+/**
+ * pt_decompress_step - read, decompress and write one frame
+ * - returns zero, when there is more work to do
+ * - otherwise the worker is done and w->result holds the error code
+ */
+static int pt_decompress_step(void *arg)
+{
+	cwork_t *w = (cwork_t *) arg;
+	HYBRIDMT_Buffer *in = &w->in;
+	HYBRIDMT_DCtx *ctx = w->ctx;
+	size_t result = 0;
+	struct writelist *wl;
+	struct list_head *entry;
+	HYBRIDMT_Buffer *out;
+	int codec = HYBRIDMT_CODEC_STORED;
+
+	/* allocate space for new output */
+	pthread_mutex_lock(&ctx->write_mutex);
+	if (!list_empty(&ctx->writelist_free)) {
+		/* take unused entry */
+		entry = list_first(&ctx->writelist_free);
+		wl = list_entry(entry, struct writelist, node);
+		list_move(entry, &ctx->writelist_busy);
+	} else {
+		/* allocate new one */
+		wl = (struct writelist *)
+		    malloc(sizeof(struct writelist));
+		if (!wl) {
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = MT_ERROR(memory_allocation);
+			return 1;
+		}
+		wl->out.buf = 0;
+		wl->out.size = 0;
+		wl->out.allocated = 0;
+		list_add(&wl->node, &ctx->writelist_busy);
+	}
+	pthread_mutex_unlock(&ctx->write_mutex);
+	out = &wl->out;
+
+	/* zero should not happen here! */
+	result = pt_read(ctx, in, &wl->frame, &wl->out.size, &codec,
+			 &wl->offset, &wl->outoffset, wl->ref, wl->sum);
+	if (HYBRIDMT_isError(result))
+		goto done_lock;
+
+	/* eof, everything is okay */
+	if (in->size == 0 && !wl->ref[0])
+		goto done_lock;
+
+	/* stored frame, just exchange the buffers */
+	if (codec == HYBRIDMT_CODEC_STORED && !wl->ref[0]) {
+		HYBRIDMT_Buffer tmp = *out;
+		*out = *in;
+		*in = tmp;
+		goto write;
+	}
+
+	if (out->allocated < out->size) {
+		if (out->allocated)
+			out->buf = realloc(out->buf, out->size);
+		else
+			out->buf = malloc(out->size);
+		if (!out->buf) {
+			result = MT_ERROR(memory_allocation);
+			goto done_lock;
+		}
+		out->allocated = out->size;
+	}
+	if (wl->ref[0])
+		goto write;
+
+	result = pt_decode(w, codec, in, out);
+	if (HYBRIDMT_isError(result)) {
+		result = pt_corrupt(ctx, wl, result);
+		goto done_lock;
+	}
+
+ write:
+	/* the checksum of the frame header, checked in parallel */
+	if (wl->sum[0] && MT_XXH64(out->buf, out->size, 0) != wl->sum[1]) {
+		result = pt_corrupt(ctx, wl, MT_ERROR(checksum_wrong));
+		goto done_lock;
+	}
+	/* the leaf of the tree hash, while it is in the cache */
+	if (ctx->tree && !wl->ref[0])
+		MT_tree_leaf(out->buf, out->size, wl->leaf);
+	/* write result */
+	/* filter and unordered writing in parallel, see pt_write() */
+	if (!ctx->ring.buf) {
+		result = pt_filter(ctx, out);
+		if (!HYBRIDMT_isError(result) && ctx->fn_write_frame)
+			result = pt_writeframe(ctx, wl);
+		if (HYBRIDMT_isError(result))
+			goto done_lock;
+	}
+
+	pthread_mutex_lock(&ctx->write_mutex);
+	result = pt_write(ctx, wl);
+	if (HYBRIDMT_isError(result))
+		goto done_unlock;
+	pthread_mutex_unlock(&ctx->write_mutex);
+
+	return 0;
+
+ done_lock:
+	pthread_mutex_lock(&ctx->write_mutex);
+ done_unlock:
+	list_move(&wl->node, &ctx->writelist_free);
+	pthread_mutex_unlock(&ctx->write_mutex);
+	w->result = result;
+	return 1;
+}
+
+static void *pt_decompress(void *arg)
+{
+	cwork_t *w = (cwork_t *) arg;
+
+	while (pt_decompress_step(w) == 0)
+		;
+
+	return (void *)w->result;
+}
+
+/**
+ * pt_tree - hash the tree up to its root, compare it with the trailer
+ * - a range or skipped frames have only a part of the tree
+ */
+static size_t pt_tree(HYBRIDMT_DCtx * ctx)
+{
+	MT_tree_root(&ctx->leaves, ctx->root);
+	ctx->treeframes = ctx->leaves.count;
+	MT_tree_free(&ctx->leaves);
+	if (!ctx->trailer[0] || ctx->range.start || ctx->range.end ||
+	    ctx->skipped)
+		return 0;
+
+	if (ctx->trailer[0] != ctx->treeframes ||
+	    ctx->trailer[1] != ctx->root[0] || ctx->trailer[2] != ctx->root[1])
+		return MT_ERROR(tree_wrong);
+
+	return 0;
+}
+
+size_t HYBRIDMT_decompressDCtx(HYBRIDMT_DCtx * ctx, HYBRIDMT_RdWr_t * rdwr)
+{
+	unsigned char buf[4];
+	int t, rv;
+	cwork_t *w = &ctx->cwork[0];
+	HYBRIDMT_Buffer *in = &w->in;
+	void *retval_of_thread = 0;
+
+	if (!ctx)
+		return MT_ERROR(compressionParameter_unsupported);
+
+	/* init reading and writing functions */
+	ctx->fn_read = rdwr->fn_read;
+	ctx->fn_write = rdwr->fn_write;
+	ctx->arg_read = rdwr->arg_read;
+	ctx->arg_write = rdwr->arg_write;
+
+	/* a range of the input begins with the first frame header in it */
+	if (ctx->range.start || ctx->range.end) {
+		rv = pt_resync(ctx);
+		if (rv == 1)
+			return 0;
+		if (rv != 0)
+			return mt_error(rv);
+	}
+
+	/* check for HYBRIDMT_MAGIC_SKIPPABLE */
+	in->buf = buf;
+	in->size = 4;
+	rv = ctx->fn_read(ctx->arg_read, in);
+	if (rv != 0)
+		return mt_error(rv);
+	if (in->size != 4)
+		return MT_ERROR(data_error);
+
+	ctx->bloom_line = 1;
+	ctx->bloom_seen = 0;
+	ctx->bloom_skip = 0;
+	ctx->skipped = 0;
+	ctx->outpos = 0;
+	ctx->trailer[0] = 0;
+	ctx->treeframes = 0;
+	MT_tree_free(&ctx->leaves);
+
+	/* deduplicated stream, the window frame comes first */
+	MT_ring_free(&ctx->ring);
+	if (MEM_readLE32(buf) == MT_DEDUP_MAGIC) {
+		size_t result = pt_window(ctx);
+		if (HYBRIDMT_isError(result))
+			return result;
+		in->size = 4;
+		rv = ctx->fn_read(ctx->arg_read, in);
+		if (rv != 0)
+			return mt_error(rv);
+		if (in->size != 4)
+			return MT_ERROR(data_error);
+	}
+
+	/* bloom filter of the first frame */
+	if (MEM_readLE32(buf) == MT_BLOOM_MAGIC) {
+		if (pt_bloom(ctx, buf, 0))
+			return MT_ERROR(data_error);
+		if (MT_range_done(&ctx->range, ctx->insize))
+			return 0;
+		in->size = 4;
+		rv = ctx->fn_read(ctx->arg_read, in);
+		if (rv != 0)
+			return mt_error(rv);
+		if (in->size != 4)
+			return MT_ERROR(data_error);
+	}
+
+	/* single threaded with unknown sizes */
+	if (MEM_readLE32(buf) != HYBRIDMT_MAGIC_SKIPPABLE)
+		return MT_ERROR(data_error);
+
+	/* mark unused */
+	for (t = 0; t < ctx->threads; t++) {
+		cwork_t *wt = &ctx->cwork[t];
+		wt->in.buf = 0;
+		wt->in.size = 0;
+		wt->in.allocated = 0;
+		wt->result = 0;
+	}
+
+	if (ctx->pool) {
+		/* run the workers as jobs of the shared pool */
+		if (POOLMT_run(ctx->pool, ctx->weight, pt_decompress_step,
+			       ctx->cwork, sizeof(cwork_t), ctx->threads))
+			retval_of_thread = (void *)MT_ERROR(memory_allocation);
+	} else if (ctx->threads == 1) {
+		/* single threaded, but with known sizes */
+		pt_decompress(w);
+	} else {
+		/* multi threaded */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *wt = &ctx->cwork[t];
+			pthread_create(&wt->pthread, NULL, pt_decompress, wt);
+		}
+
+		/* wait for all workers */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *wt = &ctx->cwork[t];
+			pthread_join(wt->pthread, 0);
+		}
+	}
+
+	/* collect the results */
+	for (t = 0; t < ctx->threads; t++) {
+		cwork_t *wt = &ctx->cwork[t];
+		if (wt->result)
+			retval_of_thread = (void *)wt->result;
+		if (wt->in.allocated)
+			free(wt->in.buf);
+	}
+
+	/* clean up the buffers */
+	while (!list_empty(&ctx->writelist_free)) {
+		struct writelist *wl;
+		struct list_head *entry;
+		entry = list_first(&ctx->writelist_free);
+		wl = list_entry(entry, struct writelist, node);
+		free(wl->out.buf);
+		list_del(&wl->node);
+		free(wl);
+	}
+	/* the root of the tree hash, compared with the trailer frame */
+	if (ctx->tree && !retval_of_thread)
+		retval_of_thread = (void *)pt_tree(ctx);
+	MT_tree_free(&ctx->leaves);
+	MT_range_free(&ctx->range);
+	MT_ring_free(&ctx->ring);
+
+	return (size_t) retval_of_thread;
+}
+
+/* returns current uncompressed data size */
+size_t HYBRIDMT_GetInsizeDCtx(HYBRIDMT_DCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return ctx->insize;
+}
+
+/* returns the current compressed data size */
+size_t HYBRIDMT_GetOutsizeDCtx(HYBRIDMT_DCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return ctx->outsize;
+}
+
+/* returns the current compressed frames */
+size_t HYBRIDMT_GetFramesDCtx(HYBRIDMT_DCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return ctx->curframe;
+}
+
+size_t HYBRIDMT_GetErrorFrameDCtx(HYBRIDMT_DCtx * ctx, unsigned long long *offset)
+{
+	if (!ctx)
+		return 0;
+
+	if (offset)
+		*offset = ctx->erroffset;
+
+	return ctx->errframe;
+}
+
+size_t HYBRIDMT_GetTreeHashDCtx(HYBRIDMT_DCtx * ctx, unsigned long long *root)
+{
+	if (!ctx || !ctx->tree)
+		return 0;
+
+	root[0] = ctx->root[0];
+	root[1] = ctx->root[1];
+
+	return ctx->treeframes;
+}
+
+void HYBRIDMT_freeDCtx(HYBRIDMT_DCtx * ctx)
+{
+	int t;
+
+	if (!ctx)
+		return;
+
+	for (t = 0; t < ctx->threads; t++)
+		ZSTD_freeDCtx(ctx->cwork[t].zctx);
+
+	pthread_mutex_destroy(&ctx->read_mutex);
+	pthread_mutex_destroy(&ctx->write_mutex);
+	free(ctx->bloom.buf);
+	MT_range_free(&ctx->range);
+	MT_tree_free(&ctx->leaves);
+	MT_ring_free(&ctx->ring);
+	free(ctx->cwork);
+	free(ctx);
+	ctx = 0;
+
+	return;
+}
+
+size_t HYBRIDMT_GetFrameInfo(const void *src, size_t size,
+			     unsigned long long *csize, unsigned long long *usize)
+{
+	const BYTE *p = (const BYTE *)src;
+	MT_Frame f;
+	U64 cs, us;
+	int kind = MT_frame_info(p, size, &f, &cs, &us);
+
+	if (kind < 0 || (kind == MT_INFO_DATA && f.version == 1 &&
+			 f.hsize != 16))
+		return MT_ERROR(data_error);
+	if (kind != MT_INFO_DATA)
+		goto done;
+
+	switch (f.magic) {
+	case HYBRIDMT_MAGIC_STORED:
+	case HYBRIDMT_MAGIC_SNAPPY:
+	case HYBRIDMT_MAGIC_LZ4:
+	case HYBRIDMT_MAGIC_ZSTD:
+		break;
+	default:
+		return MT_ERROR(data_error);
+	}
+	us = pt_usize(&f, p + f.hsize, size - f.hsize);
+
+ done:
+	*csize = cs;
+	*usize = us;
+	return (size_t)kind;
+}
@@ -24,6 +24,8 @@ extern "C" {
 
 #include <stddef.h>   /* size_t */
 
+#include "pool-mt.h"
+
 /* current maximum the library will accept */
 #define LIZARDMT_THREAD_MAX 128
 #define LIZARDMT_LEVEL_MIN   10
@@ -32,6 +34,10 @@ extern "C" {
 #define LIZARDFMT_MAGICNUMBER     0x184D2206U
 #define LIZARDFMT_MAGIC_SKIPPABLE 0x184D2A50U
 
+/* incompressible frames are stored with 64 KiB blocks, 0 disables it */
+#define LIZARDFMT_STORED_BLOCKID  0
+#define LIZARDFMT_STORED_BLOCK    (64 * 1024)
+
 /* **************************************
  * Error Handling
  ****************************************/
@@ -49,6 +55,9 @@ typedef enum {
   LIZARDMT_error_compressionParameter_unsupported,
   LIZARDMT_error_compression_library,
   LIZARDMT_error_canceled,
+  LIZARDMT_error_checksum_wrong,
+  LIZARDMT_error_verify_failed,
+  LIZARDMT_error_tree_wrong,
   LIZARDMT_error_maxCode
 } LIZARDMT_ErrorCode;
 
@@ -77,9 +86,16 @@ typedef struct {
  * - a sample is given in 7-Zip ZS or lizardmt.c
  * - the function should return -1 on error and zero on success
  * - the read or written bytes will go to in->size or out->size
+ * - with a max latency (see LIZARDMT_SetMaxLatencyCCtx) fn_read may also
+ *   return less bytes than requested, zero bytes are still eof; it
+ *   should return 1 when no input arrived for a while (some fraction
+ *   of the latency), so the library can cut the current frame
  */
 typedef int (fn_read) (void *args, LIZARDMT_Buffer * in);
 typedef int (fn_write) (void *args, LIZARDMT_Buffer * out);
+typedef int (fn_filter) (void *args, LIZARDMT_Buffer * out);
+typedef int (fn_write_frame) (void *args, LIZARDMT_Buffer * out, size_t frame,
+			   unsigned long long offset);
 
 typedef struct {
 	fn_read *fn_read;
@@ -105,6 +121,161 @@ typedef struct LIZARDMT_CCtx_s LIZARDMT_CCtx;
  */
 LIZARDMT_CCtx *LIZARDMT_createCCtx(int threads, int level, int inputsize);
 
+/**
+ * 1a) optional: set max latency for streaming input
+ * - a partially filled input chunk is compressed and written as a
+ *   short frame, when its first byte waits longer than msec
+ * - zero disables it (default), the chunk is then always filled up
+ */
+size_t LIZARDMT_SetMaxLatencyCCtx(LIZARDMT_CCtx * ctx, int msec);
+
+/**
+ * 1b) optional: run within a shared pool (see pool-mt.h)
+ * - the threads value of the cctx is then the max number of frames,
+ *   which are compressed in parallel
+ * - weight: 1 .. POOLMT_WEIGHT_MAX, the share within the pool
+ * - pool can be zero, to use own threads again
+ */
+size_t LIZARDMT_SetPoolCCtx(LIZARDMT_CCtx * ctx, POOLMT_Pool * pool, int weight);
+
+/**
+ * 1c) optional: placement of the worker threads (see pool-mt.h)
+ * - MT_AFFINITY_NONE: the scheduler decides (default)
+ * - MT_AFFINITY_SPREAD: pin the workers over the physical cores of all
+ *   numa nodes first, output buffers are reused per node then
+ * - has no effect, when running within a shared pool
+ */
+size_t LIZARDMT_SetAffinityCCtx(LIZARDMT_CCtx * ctx, int policy);
+
+/**
+ * 1d) optional: adaptive number of active workers
+ * - every 100ms one worker is parked, when the workers wait most of
+ *   the time for input or output, or unparked, when they compress
+ *   most of the time
+ * - minthreads: min active workers, the max is the threads value of
+ *   the cctx, zero disables it (default)
+ * - has no effect, when running within a shared pool
+ */
+size_t LIZARDMT_SetAdaptiveCCtx(LIZARDMT_CCtx * ctx, int minthreads);
+
+/**
+ * 1e) optional: adaptive level between minlevel and maxlevel
+ * - every 100ms, the level goes up, when the workers wait more than 1/4
+ *   of the time for writing or frames pile up in the reorder queue
+ * - it goes down, when they mostly compress and the writer is idle
+ * - it starts with the level of the cctx, both zero disables it
+ */
+size_t LIZARDMT_SetLevelRangeCCtx(LIZARDMT_CCtx * ctx, int minlevel, int maxlevel);
+
+/**
+ * 1f) optional: content defined chunking (FastCDC)
+ * - the frame boundaries are found by a rolling hash over the input, so
+ *   unchanged regions of a file give the same frames again, also when
+ *   some bytes were inserted or removed before them
+ * - avgsize: wanted frame size, rounded down to a power of two
+ * - minsize, maxsize: limits of the frame size, zero for avgsize / 4
+ *   and avgsize * 4, the input size of the cctx becomes maxsize
+ * - avgsize zero disables it (default)
+ */
+size_t LIZARDMT_SetChunkingCCtx(LIZARDMT_CCtx * ctx, int minsize, int avgsize,
+			     int maxsize);
+
+/**
+ * 1g) optional: frame level deduplication
+ * - chunks, which were seen within the last window MiB of input, are
+ *   written as a reference to the earlier data instead of a new frame
+ * - works best together with content defined chunking (1f)
+ * - the decompressor needs window MiB of memory for it
+ * - window zero disables it (default), max is 4096
+ */
+size_t LIZARDMT_SetDedupCCtx(LIZARDMT_CCtx * ctx, int window);
+
+/**
+ * 1h) optional: record aware chunking
+ * - the frames are cut only behind the delimiter, so each frame gives
+ *   whole records, which can be processed on their own (log files)
+ * - delim: 1 .. 16 bytes, like "\n", dlen zero disables it
+ * - tolerance: 1 .. 99 percent, the frame size is the input size of the
+ *   cctx +/- this, longer records are cut anyway
+ * - replaces the content defined chunking (1f)
+ */
+size_t LIZARDMT_SetDelimiterCCtx(LIZARDMT_CCtx * ctx, const void *delim, int dlen,
+                              int tolerance);
+
+/**
+ * 1i) optional: bloom filter of each frame (see bloom-mt.h)
+ * - a skippable frame with the trigrams of the chunk is written in
+ *   front of each data frame, other decompressors just skip it
+ * - a search can skip the frames, which can not contain its pattern
+ *   (see LIZARDMT_SetBloomDCtx), best with record aware chunking (1h)
+ * - size: bytes of each filter, rounded down to a power of two,
+ *   64 .. 1 MiB, zero disables it (default)
+ */
+size_t LIZARDMT_SetBloomCCtx(LIZARDMT_CCtx * ctx, int size);
+
+/**
+ * 1j) optional: unordered writing
+ * - fn is called for each frame, as soon as it is compressed, with its
+ *   number and the offset of its input, so a slow frame does not stall
+ *   the others
+ * - it runs within the workers, without a lock, so it must be thread
+ *   safe, fn_write gets only the window frame of a deduplicated stream
+ * - no bloom frames are written then
+ * - fn zero disables it (default)
+ */
+size_t LIZARDMT_SetUnorderedCCtx(LIZARDMT_CCtx * ctx, fn_write_frame * fn, void *arg);
+
+/**
+ * 1k) optional: version of the frame headers (see frame-mt.h)
+ * - 1: 12 bytes with 32 bit compressed size (default)
+ * - 2: 32 bytes with 64 bit compressed and uncompressed size, so the
+ *   decompressors allocate the exact output and a reader can get the
+ *   offsets and sizes of all frames without decoding them
+ * - the decompressors read both versions
+ */
+size_t LIZARDMT_SetHeaderCCtx(LIZARDMT_CCtx * ctx, int version);
+
+/**
+ * 1l) optional: checksum of each frame
+ * - the workers store the xxHash64 of the uncompressed data of their
+ *   frame in its version 2 header, which is selected by this
+ *   (version 1 has no field for it and drops it again)
+ * - the decompression workers check it in parallel, before the frame
+ *   is written, a wrong one gives LIZARDMT_error_checksum_wrong
+ * - enable zero disables it (default)
+ */
+size_t LIZARDMT_SetChecksumCCtx(LIZARDMT_CCtx * ctx, int enable);
+
+/**
+ * 1m) optional: tree hash of the input (see tree-mt.h)
+ * - the workers hash their chunks, the hashes are combined in the order
+ *   of the frames to a root of 128 bit
+ * - mode 1 computes the root, mode 2 also writes it as trailer frame,
+ *   zero disables it (default)
+ */
+size_t LIZARDMT_SetTreeHashCCtx(LIZARDMT_CCtx * ctx, int mode);
+
+/**
+ * 1n) optional: round trip of each frame
+ * - the workers decode their frame again and compare it with the chunk,
+ *   before the frame goes to the writer
+ * - a mismatch stops the other workers and gives
+ *   LIZARDMT_error_verify_failed, see LIZARDMT_GetErrorFrameCCtx()
+ * - enable zero disables it (default)
+ */
+size_t LIZARDMT_SetVerifyCCtx(LIZARDMT_CCtx * ctx, int enable);
+
+/**
+ * 1o) optional: read the input from memory, like a mapped file
+ * - the workers take their chunks straight from src, without copying
+ *   them and without calling fn_read, which may be zero then
+ * - src must stay valid and unchanged until LIZARDMT_compressCCtx()
+ *   returns, the max latency does not apply
+ * - each following LIZARDMT_compressCCtx() reads it from the start, src
+ *   zero goes back to fn_read (default)
+ */
+size_t LIZARDMT_SetSourceCCtx(LIZARDMT_CCtx * ctx, const void *src, size_t size);
+
 /**
  * 2) threaded compression
  * - errorcheck via 
@@ -118,6 +289,55 @@ size_t LIZARDMT_GetFramesCCtx(LIZARDMT_CCtx * ctx);
 size_t LIZARDMT_GetInsizeCCtx(LIZARDMT_CCtx * ctx);
 size_t LIZARDMT_GetOutsizeCCtx(LIZARDMT_CCtx * ctx);
 
+/**
+ * 3b) estimated memory usage of all workers in bytes
+ * - can be used before compressing, for checking some memory limit
+ * - it depends on the other settings, so call it after all setters, the
+ *   table of the deduplication is included
+ */
+size_t LIZARDMT_GetMemoryCCtx(LIZARDMT_CCtx * ctx);
+
+/**
+ * 3c) thread statistic of the last compression
+ * - the times are the sums of all workers in microseconds
+ */
+typedef struct {
+	int threads;		/* max workers of the cctx */
+	int active;		/* active workers, the others are parked */
+	size_t parked;		/* decisions for parking a worker */
+	size_t unparked;	/* decisions for unparking a worker */
+	unsigned long long busy_us;	/* compressing */
+	unsigned long long read_us;	/* waiting for and reading input */
+	unsigned long long write_us;	/* waiting for and writing output */
+	size_t stored;		/* frames, which are stored */
+	size_t dedup;		/* frames, which are references */
+	int level;		/* level for the next frame */
+	size_t levels[LIZARDMT_LEVEL_MAX + 1];	/* written frames per level */
+} LIZARDMT_Stats;
+
+size_t LIZARDMT_GetStatsCCtx(LIZARDMT_CCtx * ctx, LIZARDMT_Stats * stats);
+
+/**
+ * 3d) root of the tree hash, of the last compression
+ * - returns the number of frames, zero when it is not used
+ */
+size_t LIZARDMT_GetTreeHashCCtx(LIZARDMT_CCtx * ctx, unsigned long long *root);
+
+/**
+ * 3e) the first frame, which failed its round trip
+ * - returns its number, counted from one, or zero
+ * - offset gets the offset of its chunk in the input, it may be zero
+ */
+size_t LIZARDMT_GetErrorFrameCCtx(LIZARDMT_CCtx * ctx, unsigned long long *offset);
+
+/**
+ * 3a) latency of the written frames in microseconds
+ * - time from the arrival of the first input byte of a frame,
+ *   until the frame was given to fn_write
+ */
+size_t LIZARDMT_GetLatencyMaxCCtx(LIZARDMT_CCtx * ctx);
+size_t LIZARDMT_GetLatencyAvgCCtx(LIZARDMT_CCtx * ctx);
+
 /**
  * 4) free cctx
  * - no special return value
@@ -139,6 +359,82 @@ typedef struct LIZARDMT_DCtx_s LIZARDMT_DCtx;
  */
 LIZARDMT_DCtx *LIZARDMT_createDCtx(int threads, int inputsize);
 
+/**
+ * 1b) optional: run within a shared pool (see pool-mt.h)
+ * - same as LIZARDMT_SetPoolCCtx()
+ */
+size_t LIZARDMT_SetPoolDCtx(LIZARDMT_DCtx * ctx, POOLMT_Pool * pool, int weight);
+
+/**
+ * 1c) optional: filter the decoded frames
+ * - fn is called for each decoded output buffer, before it goes to
+ *   fn_write, within the workers, so in parallel and in any order
+ * - it may change the buffer in place and shrink out->size, e.g. to
+ *   keep only the lines, which match some pattern (see --grep)
+ * - returns zero on success, or a negative value like fn_write
+ * - with deduplication, it runs while writing in the order of frames
+ * - fn zero disables it (default)
+ */
+size_t LIZARDMT_SetFilterDCtx(LIZARDMT_DCtx * ctx, fn_filter * fn, void *arg);
+
+/**
+ * 1d) optional: skip the frames, which can not contain the pattern
+ * - uses the bloom filters of the frames (see LIZARDMT_SetBloomCCtx)
+ * - a frame is skipped only, when it and the frame before it end with
+ *   a newline, so the lines of the other frames stay complete
+ * - pattern is kept by pointer, len zero disables it (default)
+ * - no frames are skipped in a deduplicated stream
+ */
+size_t LIZARDMT_SetBloomDCtx(LIZARDMT_DCtx * ctx, const void *pattern, int len);
+
+/**
+ * 1e) optional: unordered writing
+ * - fn is called for each frame, as soon as it is decoded and filtered,
+ *   with its number and its offset in the uncompressed output (before
+ *   the filter), fn_write is not used then
+ * - the offset is -1 from the first frame on, whose size is not known
+ *   before decoding it (the lizard frame header without content size),
+ *   version 2 headers always have it
+ * - with SetRangeDCtx() the offsets count from the start of the range
+ * - it runs within the workers, without a lock, so it must be thread
+ *   safe, with deduplication the frames come in order, their offsets
+ *   are always known
+ * - standard lizard streams without skippable frames go to fn_write
+ * - fn zero disables it (default)
+ */
+size_t LIZARDMT_SetUnorderedDCtx(LIZARDMT_DCtx * ctx, fn_write_frame * fn, void *arg);
+
+/**
+ * 1f) optional: decompress a byte range of the input
+ * - only the frames, whose headers begin within [start, end), are
+ *   decompressed, the last one is read up to its end
+ * - fn_read must begin at offset start of the input (seek there), the
+ *   first frame header is searched by its skippable and codec magic
+ * - end zero: up to the end of the input, start and end zero disable
+ *   it (default)
+ * - not for deduplicated streams, the references need earlier frames
+ */
+size_t LIZARDMT_SetRangeDCtx(LIZARDMT_DCtx * ctx, unsigned long long start,
+			  unsigned long long end);
+
+/**
+ * 1g) optional: verification only
+ * - the frames are decoded and checked (the checksums of the codec and
+ *   of the frame headers), then the output is dropped, fn_write is not
+ *   used and the frames are not put in order
+ * - replaces the unordered writing (1e), the filter still runs
+ * - enable zero disables it (default)
+ */
+size_t LIZARDMT_SetVerifyDCtx(LIZARDMT_DCtx * ctx, int enable);
+
+/**
+ * 1h) optional: tree hash of the output (see LIZARDMT_SetTreeHashCCtx)
+ * - the workers hash the decoded frames, the root is compared with the
+ *   one of the trailer frame, a wrong one gives LIZARDMT_error_tree_wrong
+ * - not for byte ranges and skipped frames, they have only a part
+ */
+size_t LIZARDMT_SetTreeHashDCtx(LIZARDMT_DCtx * ctx, int enable);
+
 /**
  * 2) threaded compression
  * - return -1 on error
@@ -152,12 +448,47 @@ size_t LIZARDMT_GetFramesDCtx(LIZARDMT_DCtx * ctx);
 size_t LIZARDMT_GetInsizeDCtx(LIZARDMT_DCtx * ctx);
 size_t LIZARDMT_GetOutsizeDCtx(LIZARDMT_DCtx * ctx);
 
+/**
+ * 3b) the first frame with a wrong checksum (see LIZARDMT_SetChecksumCCtx)
+ *   or one, which could not be decoded
+ * - returns its number, counted from one, and gives its offset in the
+ *   compressed input, zero when all frames were right
+ * - offset may be zero
+ */
+size_t LIZARDMT_GetErrorFrameDCtx(LIZARDMT_DCtx * ctx, unsigned long long *offset);
+
+/**
+ * 3c) root of the tree hash of the decoded frames
+ * - returns the number of frames, zero when it is not used
+ */
+size_t LIZARDMT_GetTreeHashDCtx(LIZARDMT_DCtx * ctx, unsigned long long *root);
+
 /**
  * 4) free cctx
  * - no special return value
  */
 void LIZARDMT_freeDCtx(LIZARDMT_DCtx * ctx);
 
+/**
+ * 5) list the frames of a stream, without decompressing them
+ * - src: the first bytes of a frame, LIZARDMT_INFO_PEEK or the rest of
+ *   the input, when it is shorter
+ * - *csize gets the bytes of the whole frame (the next one begins
+ *   behind it) and *usize its uncompressed size, or -1 when the frame
+ *   does not tell it, so it must be decoded to know it
+ * - returns the kind of frame (LIZARDMT_INFO_xxx) or an error code, when
+ *   src is no frame of the multi-threaded format
+ */
+#define LIZARDMT_INFO_PEEK    96
+#define LIZARDMT_INFO_DATA     0	/* compressed data */
+#define LIZARDMT_INFO_BLOOM    1	/* bloom filter */
+#define LIZARDMT_INFO_WINDOW   2	/* window of the deduplication */
+#define LIZARDMT_INFO_REF      3	/* reference of the deduplication */
+#define LIZARDMT_INFO_SKIP     4	/* other skippable frame */
+#define LIZARDMT_INFO_TREE     5	/* root of the tree hash */
+size_t LIZARDMT_GetFrameInfo(const void *src, size_t size,
+			  unsigned long long *csize, unsigned long long *usize);
+
 #if defined (__cplusplus)
 }
 #endif
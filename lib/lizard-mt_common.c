@@ -56,6 +56,12 @@ const char *LIZARDMT_getErrorString(size_t code)
 		return "Compression parameter is out of bound";
 	case PREFIX(compression_library):
 		return "Compression library reports failure";
+	case PREFIX(checksum_wrong):
+		return "Checksum of a frame is wrong";
+	case PREFIX(verify_failed):
+		return "Round trip of a frame failed";
+	case PREFIX(tree_wrong):
+		return "Tree hash of the output is wrong";
 	case PREFIX(maxCode):
 	default:
 		return noErrorCode;
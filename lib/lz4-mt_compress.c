@@ -18,8 +18,16 @@
 #include "lz4frame.h"
 
 #include "memmt.h"
+#include "entropy-mt.h"
+#include "chunk-mt.h"
+#include "dedup-mt.h"
+#include "bloom-mt.h"
+#include "frame-mt.h"
+#include "tree-mt.h"
+#include "xxhash-mt.h"
 #include "threading.h"
 #include "list.h"
+#include "pool-mt.h"
 #include "lz4-mt.h"
 
 /**
@@ -33,6 +41,8 @@
  *   2) release read mutex and do compression
  *   3) get write mutex and write result
  *   4) begin with step 1 again, until no input
+ * - one such round is done by pt_compress_step(), so the workers can
+ *   also run as jobs of a shared pool (see pool-mt.h)
  */
 
 /* worker for compression */
@@ -40,12 +50,34 @@ typedef struct {
 	LZ4MT_CCtx *ctx;
 	LZ4F_preferences_t zpref;
 	pthread_t pthread;
+	LZ4MT_Buffer in;
+	size_t result;
+
+	/* placement, see mt_placement() */
+	int cpu;
+	int numa;
+
+	/* timing of the current frame, see pt_account() */
+	unsigned long long t_read;
+	unsigned long long t_busy;
+
+	/* round trip of the frames, see pt_verify() */
+	LZ4F_decompressionContext_t dctx;
+	LZ4MT_Buffer check;
 } cwork_t;
 
 struct writelist;
 struct writelist {
 	size_t frame;
+	unsigned long long tstart;
+	int numa;
+	int stored;
+	int dedup;
+	U64 offset;
+	U64 leaf[2];		/* hash of the chunk, see tree-mt.h */
+	int level;
 	LZ4MT_Buffer out;
+	LZ4MT_Buffer bloom;	/* bloom frame, behind the output */
 	struct list_head node;
 };
 
@@ -60,11 +92,85 @@ struct LZ4MT_CCtx_s {
 	/* should be used for read from input */
 	int inputsize;
 
+	/* max latency in ms, 0 = disabled */
+	int maxlatency;
+
+	/* content defined chunking, zero when not used */
+	MT_Chunker *chunker;
+	LZ4MT_Buffer carry;
+
+	/* borrowed input instead of fn_read, zero when not used */
+	const unsigned char *src;
+	size_t srcsize;
+	size_t srcpos;
+
+	/* frame level deduplication, window zero when not used */
+	MT_Dedup dedup;
+
+	/* bloom filter of each frame in bytes, zero when not used */
+	int bloom;
+
+	/* bytes of the frame header, 12 or MT_frame_v2size() */
+	size_t hsize;
+
+	/* checksum of each frame in its header, MT_FRAME_CHECKSUM or 0 */
+	unsigned checksum;
+
+	/* tree hash of the input: 0 off, 1 root, 2 root and trailer */
+	int tree;
+	MT_Tree leaves;
+	U64 root[2];
+	size_t treeframes;
+
+	/* round trip of each frame, the first failed one counted from one */
+	int verify;
+	size_t errframe;
+	U64 erroffset;
+
+	/* shared pool, zero when not used */
+	POOLMT_Pool *pool;
+	int weight;
+
+	/* placement of the workers, MT_AFFINITY_xxx */
+	int affinity;
+
+	/* adaptive mode: minthreads .. threads are active, 0 = disabled */
+	int minthreads;
+	int active;
+	int stopped;
+	pthread_cond_t park_cond;
+	size_t parked;
+	size_t unparked;
+
+	/* time of all workers, for the last decision in adapt_xxx */
+	unsigned long long busy_us;
+	unsigned long long read_us;
+	unsigned long long write_us;
+	unsigned long long adapt_last;
+	unsigned long long adapt_busy;
+	unsigned long long adapt_wait;
+
+	/* adaptive level: minlevel .. maxlevel, 0 = disabled */
+	int minlevel;
+	int maxlevel;
+	int curlevel;
+	unsigned long long level_last;
+	unsigned long long level_all;
+	unsigned long long level_busy;
+	unsigned long long level_write;
+
+	/* written frames per level */
+	size_t levels[LZ4MT_LEVEL_MAX + 1];
+
 	/* statistic */
 	size_t insize;
 	size_t outsize;
 	size_t curframe;
 	size_t frames;
+	size_t stored;
+	size_t dedups;
+	unsigned long long latency_sum;
+	unsigned long long latency_max;
 
 	/* threading */
 	cwork_t *cwork;
@@ -79,8 +185,12 @@ struct LZ4MT_CCtx_s {
 	fn_write *fn_write;
 	void *arg_write;
 
+	/* unordered writing, zero when not used */
+	fn_write_frame *fn_write_frame;
+	void *arg_write_frame;
+
 	/* lists for writing queue */
-	struct list_head writelist_free;
+	struct list_head writelist_free[MT_NODE_MAX];
 	struct list_head writelist_busy;
 	struct list_head writelist_done;
 };
@@ -120,12 +230,43 @@ LZ4MT_CCtx *LZ4MT_createCCtx(int threads, int level, int inputsize)
 	ctx->outsize = 0;
 	ctx->frames = 0;
 	ctx->curframe = 0;
+	ctx->maxlatency = 0;
+	ctx->chunker = 0;
+	ctx->carry.buf = 0;
+	ctx->src = 0;
+	ctx->srcsize = 0;
+	ctx->carry.size = 0;
+	ctx->dedup.entry = 0;
+	ctx->dedup.window = 0;
+	ctx->bloom = 0;
+	ctx->hsize = 12;
+	ctx->checksum = 0;
+	ctx->tree = 0;
+	MT_tree_init(&ctx->leaves);
+	ctx->root[0] = 0;
+	ctx->root[1] = 0;
+	ctx->treeframes = 0;
+	ctx->verify = 0;
+	ctx->errframe = 0;
+	ctx->erroffset = 0;
+	ctx->fn_write_frame = 0;
+	ctx->arg_write_frame = 0;
+	ctx->pool = 0;
+	ctx->weight = 1;
+	ctx->affinity = MT_AFFINITY_NONE;
+	ctx->minthreads = 0;
+	ctx->minlevel = 0;
+	ctx->maxlevel = 0;
+	ctx->latency_sum = 0;
+	ctx->latency_max = 0;
 
 	pthread_mutex_init(&ctx->read_mutex, NULL);
 	pthread_mutex_init(&ctx->write_mutex, NULL);
+	pthread_cond_init(&ctx->park_cond, NULL);
 
 	/* free -> busy -> out -> free -> ... */
-	INIT_LIST_HEAD(&ctx->writelist_free);	/* free, can be used */
+	for (t = 0; t < MT_NODE_MAX; t++)	/* free, per numa node */
+		INIT_LIST_HEAD(&ctx->writelist_free[t]);
 	INIT_LIST_HEAD(&ctx->writelist_busy);	/* busy */
 	INIT_LIST_HEAD(&ctx->writelist_done);	/* can be written */
 
@@ -144,7 +285,9 @@ LZ4MT_CCtx *LZ4MT_createCCtx(int threads, int level, int inputsize)
 		w->zpref.frameInfo.contentSize = 1;
 		w->zpref.frameInfo.contentChecksumFlag =
 		    LZ4F_contentChecksumEnabled;
-
+		w->dctx = 0;
+		w->check.buf = 0;
+		w->check.allocated = 0;
 	}
 
 	return ctx;
@@ -172,6 +315,352 @@ static size_t mt_error(int rv)
 	return ERROR(read_fail);
 }
 
+size_t LZ4MT_SetMaxLatencyCCtx(LZ4MT_CCtx * ctx, int msec)
+{
+	if (!ctx || msec < 0)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->maxlatency = msec;
+
+	return 0;
+}
+
+size_t LZ4MT_SetChunkingCCtx(LZ4MT_CCtx * ctx, int minsize, int avgsize,
+			     int maxsize)
+{
+	if (!ctx || minsize < 0 || avgsize < 0 || maxsize < 0 ||
+	    maxsize > MT_CHUNK_MAX)
+		return ERROR(compressionParameter_unsupported);
+
+	free(ctx->chunker);
+	free(ctx->carry.buf);
+	ctx->chunker = 0;
+	ctx->carry.buf = 0;
+	if (!avgsize)
+		return 0;
+
+	ctx->chunker = (MT_Chunker *) malloc(sizeof(MT_Chunker));
+	if (!ctx->chunker)
+		return ERROR(memory_allocation);
+	MT_chunk_init(ctx->chunker, minsize, avgsize, maxsize);
+
+	/* the bytes behind the last cut, at most one chunk */
+	ctx->carry.buf = malloc(ctx->chunker->max);
+	if (!ctx->carry.buf) {
+		free(ctx->chunker);
+		ctx->chunker = 0;
+		return ERROR(memory_allocation);
+	}
+	ctx->carry.allocated = ctx->chunker->max;
+	ctx->inputsize = (int)ctx->chunker->max;
+
+	return 0;
+}
+
+size_t LZ4MT_SetDelimiterCCtx(LZ4MT_CCtx * ctx, const void *delim, int dlen,
+                              int tolerance)
+{
+	if (!ctx || dlen < 0 || dlen > MT_DELIM_MAX || (dlen && !delim) ||
+	    tolerance < 1 || tolerance > 99)
+		return ERROR(compressionParameter_unsupported);
+
+	free(ctx->chunker);
+	free(ctx->carry.buf);
+	ctx->chunker = 0;
+	ctx->carry.buf = 0;
+	if (!dlen)
+		return 0;
+
+	ctx->chunker = (MT_Chunker *) malloc(sizeof(MT_Chunker));
+	if (!ctx->chunker)
+		return ERROR(memory_allocation);
+	MT_chunk_delim(ctx->chunker, delim, (size_t)dlen,
+		       (size_t)ctx->inputsize, tolerance);
+
+	/* the bytes behind the last cut, at most one chunk */
+	ctx->carry.buf = malloc(ctx->chunker->max);
+	if (!ctx->carry.buf) {
+		free(ctx->chunker);
+		ctx->chunker = 0;
+		return ERROR(memory_allocation);
+	}
+	ctx->carry.allocated = ctx->chunker->max;
+	ctx->inputsize = (int)ctx->chunker->max;
+
+	return 0;
+}
+
+size_t LZ4MT_SetBloomCCtx(LZ4MT_CCtx * ctx, int size)
+{
+	int bloom = MT_BLOOM_MIN;
+
+	if (!ctx || size < 0 || size > MT_BLOOM_MAX)
+		return ERROR(compressionParameter_unsupported);
+
+	/* rounded down to a power of two */
+	while (bloom * 2 <= size)
+		bloom *= 2;
+	ctx->bloom = size ? bloom : 0;
+
+	return 0;
+}
+
+size_t LZ4MT_SetHeaderCCtx(LZ4MT_CCtx * ctx, int version)
+{
+	if (!ctx || version < 1 || version > 2)
+		return ERROR(compressionParameter_unsupported);
+
+	/* the checksum is part of the version 2 header */
+	if (version == 1)
+		ctx->checksum = 0;
+	ctx->hsize = version == 2 ? MT_frame_v2size(ctx->checksum) : 12;
+
+	return 0;
+}
+
+size_t LZ4MT_SetChecksumCCtx(LZ4MT_CCtx * ctx, int enable)
+{
+	if (!ctx)
+		return ERROR(compressionParameter_unsupported);
+
+	/* selects the version 2 header, which has the field for it */
+	ctx->checksum = enable ? MT_FRAME_CHECKSUM : 0;
+	if (enable || ctx->hsize != 12)
+		ctx->hsize = MT_frame_v2size(ctx->checksum);
+
+	return 0;
+}
+
+size_t LZ4MT_SetUnorderedCCtx(LZ4MT_CCtx * ctx, fn_write_frame * fn, void *arg)
+{
+	if (!ctx)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->fn_write_frame = fn;
+	ctx->arg_write_frame = arg;
+
+	return 0;
+}
+
+size_t LZ4MT_SetTreeHashCCtx(LZ4MT_CCtx * ctx, int mode)
+{
+	if (!ctx || mode < 0 || mode > 2)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->tree = mode;
+
+	return 0;
+}
+
+size_t LZ4MT_SetVerifyCCtx(LZ4MT_CCtx * ctx, int enable)
+{
+	if (!ctx)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->verify = enable ? 1 : 0;
+
+	return 0;
+}
+
+size_t LZ4MT_SetSourceCCtx(LZ4MT_CCtx * ctx, const void *src, size_t size)
+{
+	if (!ctx)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->src = (const unsigned char *)src;
+	ctx->srcsize = src ? size : 0;
+
+	return 0;
+}
+
+size_t LZ4MT_SetDedupCCtx(LZ4MT_CCtx * ctx, int window)
+{
+	if (!ctx || window < 0 || window > 4096)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->dedup.window = (U64) window << 20;
+
+	return 0;
+}
+
+size_t LZ4MT_SetPoolCCtx(LZ4MT_CCtx * ctx, POOLMT_Pool * pool, int weight)
+{
+	if (!ctx || weight < 1 || weight > POOLMT_WEIGHT_MAX)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->pool = pool;
+	ctx->weight = weight;
+
+	return 0;
+}
+
+size_t LZ4MT_SetAffinityCCtx(LZ4MT_CCtx * ctx, int policy)
+{
+	if (!ctx || (policy != MT_AFFINITY_NONE &&
+		     policy != MT_AFFINITY_SPREAD))
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->affinity = policy;
+
+	return 0;
+}
+
+size_t LZ4MT_SetAdaptiveCCtx(LZ4MT_CCtx * ctx, int minthreads)
+{
+	if (!ctx || minthreads < 0 || minthreads > ctx->threads)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->minthreads = minthreads;
+
+	return 0;
+}
+
+size_t LZ4MT_SetLevelRangeCCtx(LZ4MT_CCtx * ctx, int minlevel, int maxlevel)
+{
+	if (!ctx)
+		return ERROR(compressionParameter_unsupported);
+
+	if (minlevel == 0 && maxlevel == 0) {
+		ctx->minlevel = 0;
+		ctx->maxlevel = 0;
+		return 0;
+	}
+
+	if (minlevel < LZ4MT_LEVEL_MIN || maxlevel > LZ4MT_LEVEL_MAX ||
+	    minlevel > maxlevel)
+		return ERROR(compressionParameter_unsupported);
+
+	ctx->minlevel = minlevel;
+	ctx->maxlevel = maxlevel;
+
+	return 0;
+}
+
+/**
+ * pt_read - read the input chunk of one frame
+ * - without max latency, one call to fn_read will do it
+ * - otherwise we collect partial reads, until the chunk is full, eof is
+ *   reached or the first byte of the chunk got too old
+ * - tstart is set to the time, where the first byte came in
+ */
+static int pt_read(LZ4MT_CCtx * ctx, LZ4MT_Buffer * in,
+		   unsigned long long *tstart)
+{
+	unsigned long long limit = (unsigned long long)ctx->maxlatency * 1000;
+	size_t done = 0;
+
+	if (!ctx->maxlatency) {
+		int rv = ctx->fn_read(ctx->arg_read, in);
+		*tstart = mt_time_us();
+		return rv;
+	}
+
+	*tstart = mt_time_us();
+	while (done < in->size) {
+		LZ4MT_Buffer part;
+		int rv;
+
+		part.buf = (unsigned char *)in->buf + done;
+		part.size = in->size - done;
+		part.allocated = part.size;
+		rv = ctx->fn_read(ctx->arg_read, &part);
+		if (rv < 0)
+			return rv;
+
+		/* eof */
+		if (rv == 0 && part.size == 0)
+			break;
+
+		if (done == 0 && part.size)
+			*tstart = mt_time_us();
+		done += part.size;
+
+		/* flush, what we have */
+		if (done && mt_time_us() - *tstart >= limit)
+			break;
+	}
+	in->size = done;
+
+	return 0;
+}
+
+/**
+ * pt_readchunk - read the input chunk of one frame, content defined
+ * - the carry of the last call comes first, then it is filled up
+ * - the bytes behind the cut point are carried to the next frame
+ * - a short read (eof or max latency) takes the whole buffer
+ */
+static int pt_readchunk(LZ4MT_CCtx * ctx, LZ4MT_Buffer * in,
+			unsigned long long *tstart)
+{
+	LZ4MT_Buffer part;
+	size_t want, cut;
+	int rv;
+
+	memcpy(in->buf, ctx->carry.buf, ctx->carry.size);
+	part.buf = (unsigned char *)in->buf + ctx->carry.size;
+	part.size = want = ctx->chunker->max - ctx->carry.size;
+	part.allocated = part.size;
+	rv = pt_read(ctx, &part, tstart);
+	if (rv != 0)
+		return rv;
+
+	in->size = ctx->carry.size + part.size;
+	if (part.size < want)
+		cut = in->size;
+	else
+		cut = MT_chunk_cut(ctx->chunker, in->buf, in->size);
+
+	ctx->carry.size = in->size - cut;
+	memcpy(ctx->carry.buf, (unsigned char *)in->buf + cut,
+	       ctx->carry.size);
+	in->size = cut;
+
+	return 0;
+}
+
+/**
+ * pt_slice - borrow the input chunk of one frame from the source
+ * - the chunk points into the memory of LZ4MT_SetSourceCCtx(), so
+ *   nothing is copied, the content defined cut is found in place
+ */
+static void pt_slice(LZ4MT_CCtx * ctx, LZ4MT_Buffer * in)
+{
+	size_t left = ctx->srcsize - ctx->srcpos;
+	size_t max = ctx->chunker ? ctx->chunker->max : (size_t)ctx->inputsize;
+
+	in->buf = (void *)(ctx->src + ctx->srcpos);
+	in->size = left < max ? left : max;
+	in->allocated = in->size;
+	if (ctx->chunker && in->size == max)
+		in->size = MT_chunk_cut(ctx->chunker, in->buf, in->size);
+	ctx->srcpos += in->size;
+}
+
+/**
+ * pt_writebloom - write the bloom frame in front of the data frame
+ */
+static int pt_writebloom(LZ4MT_CCtx * ctx, struct writelist *wl)
+{
+	if (!wl->bloom.size)
+		return 0;
+	ctx->outsize += wl->bloom.size;
+
+	return ctx->fn_write(ctx->arg_write, &wl->bloom);
+}
+
+/**
+ * pt_writeframe - unordered writing, without the write mutex
+ */
+static int pt_writeframe(LZ4MT_CCtx * ctx, struct writelist *wl)
+{
+	if (!ctx->fn_write_frame)
+		return 0;
+
+	return ctx->fn_write_frame(ctx->arg_write_frame, &wl->out, wl->frame,
+				   wl->offset);
+}
+
 /**
  * pt_write - queue for compressed output
  */
@@ -182,6 +671,14 @@ static size_t pt_write(LZ4MT_CCtx * ctx, struct writelist *wl)
 	/* move the entry to the done list */
 	list_move(&wl->node, &ctx->writelist_done);
 
+	/* the leaf of the frame, before unordered mode renumbers it */
+	if (ctx->tree && MT_tree_set(&ctx->leaves, wl->frame, wl->leaf))
+		return ERROR(memory_allocation);
+
+	/* unordered, the worker has written it already */
+	if (ctx->fn_write_frame)
+		wl->frame = ctx->curframe;
+
 	/* the entry isn't the currently needed, return...  */
 	if (wl->frame != ctx->curframe)
 		return 0;
@@ -191,12 +688,24 @@ static size_t pt_write(LZ4MT_CCtx * ctx, struct writelist *wl)
 	list_for_each(entry, &ctx->writelist_done) {
 		wl = list_entry(entry, struct writelist, node);
 		if (wl->frame == ctx->curframe) {
-			int rv = ctx->fn_write(ctx->arg_write, &wl->out);
+			int rv = pt_writebloom(ctx, wl);
+			unsigned long long latency;
+
+
+			if (rv == 0 && !ctx->fn_write_frame)
+				rv = ctx->fn_write(ctx->arg_write, &wl->out);
 			if (rv != 0)
 				return mt_error(rv);
+			latency = mt_time_us() - wl->tstart;
+			ctx->latency_sum += latency;
+			if (latency > ctx->latency_max)
+				ctx->latency_max = latency;
 			ctx->outsize += wl->out.size;
+			ctx->stored += wl->stored;
+			ctx->dedups += wl->dedup;
+			ctx->levels[wl->level]++;
 			ctx->curframe++;
-			list_move(entry, &ctx->writelist_free);
+			list_move(entry, &ctx->writelist_free[wl->numa]);
 			goto again;
 		}
 	}
@@ -204,108 +713,472 @@ static size_t pt_write(LZ4MT_CCtx * ctx, struct writelist *wl)
 	return 0;
 }
 
-static void *pt_compress(void *arg)
+/**
+ * pt_account - add the timing of one frame, called with write mutex
+ * - in adaptive mode, one worker is parked or unparked every 100ms
+ * - workers, which mostly wait for reading or writing, can be parked
+ *   without losing throughput, but they would block some core
+ * - workers, which mostly compress, are limited by the cpu, so one more
+ *   worker will help, as long as there are free cores
+ */
+static void pt_account(LZ4MT_CCtx * ctx, cwork_t * w,
+		       unsigned long long t_write)
+{
+	unsigned long long now, busy, wait;
+
+	ctx->busy_us += w->t_busy;
+	ctx->read_us += w->t_read;
+	ctx->write_us += t_write;
+
+	if (!ctx->minthreads || ctx->pool)
+		return;
+
+	now = mt_time_us();
+	if (now - ctx->adapt_last < 100000)
+		return;
+
+	busy = ctx->busy_us - ctx->adapt_busy;
+	wait = ctx->read_us + ctx->write_us - ctx->adapt_wait;
+	ctx->adapt_last = now;
+	ctx->adapt_busy = ctx->busy_us;
+	ctx->adapt_wait = ctx->read_us + ctx->write_us;
+
+	if (busy * 4 >= (busy + wait) * 3 && ctx->active < ctx->threads) {
+		/* more than 75% compressing */
+		ctx->active++;
+		ctx->unparked++;
+		pthread_cond_broadcast(&ctx->park_cond);
+	} else if (busy * 2 < busy + wait && ctx->active > ctx->minthreads) {
+		/* more than 50% waiting */
+		ctx->active--;
+		ctx->parked++;
+	}
+}
+
+/**
+ * pt_level - adapt the level of the next frames, called with write mutex
+ * - the output is the bottleneck, when the workers wait more than 1/4
+ *   of their time for writing, or when more frames wait in the reorder
+ *   queue than there are threads: the spare cpu time goes into a higher
+ *   level then
+ * - when the workers mostly compress and the writer is idle, the level
+ *   goes down again, for more throughput
+ */
+static void pt_level(LZ4MT_CCtx * ctx)
+{
+	struct list_head *entry;
+	unsigned long long now, all, busy, wait;
+	int depth = 0;
+
+	if (!ctx->minlevel)
+		return;
+
+	now = mt_time_us();
+	if (now - ctx->level_last < 100000)
+		return;
+
+	list_for_each(entry, &ctx->writelist_done)
+		depth++;
+
+	all = ctx->busy_us + ctx->read_us + ctx->write_us - ctx->level_all;
+	busy = ctx->busy_us - ctx->level_busy;
+	wait = ctx->write_us - ctx->level_write;
+	ctx->level_last = now;
+	ctx->level_all = ctx->busy_us + ctx->read_us + ctx->write_us;
+	ctx->level_busy = ctx->busy_us;
+	ctx->level_write = ctx->write_us;
+
+	if (wait * 4 > all || depth > ctx->threads) {
+		if (ctx->curlevel < ctx->maxlevel)
+			ctx->curlevel++;
+	} else if (wait * 20 < all && depth == 0 && busy * 2 > all) {
+		if (ctx->curlevel > ctx->minlevel)
+			ctx->curlevel--;
+	}
+}
+
+/**
+ * pt_park - wait, while the worker is parked
+ * - all parked workers are released, when some worker has finished,
+ *   they will see eof then also
+ */
+static void pt_park(cwork_t * w)
 {
-	cwork_t *w = (cwork_t *) arg;
 	LZ4MT_CCtx *ctx = w->ctx;
-	size_t result;
-	LZ4MT_Buffer in;
+	int id = (int)(w - ctx->cwork);
 
-	/* inbuf is constant */
-	in.size = ctx->inputsize;
-	in.buf = malloc(in.size);
-	if (!in.buf)
-		return (void *)ERROR(memory_allocation);
+	if (!ctx->minthreads)
+		return;
 
-	for (;;) {
-		struct list_head *entry;
-		struct writelist *wl;
-		int rv;
+	pthread_mutex_lock(&ctx->write_mutex);
+	while (id >= ctx->active && !ctx->stopped)
+		pthread_cond_wait(&ctx->park_cond, &ctx->write_mutex);
+	pthread_mutex_unlock(&ctx->write_mutex);
+}
 
-		/* allocate space for new output */
-		pthread_mutex_lock(&ctx->write_mutex);
-		if (!list_empty(&ctx->writelist_free)) {
-			/* take unused entry */
-			entry = list_first(&ctx->writelist_free);
-			wl = list_entry(entry, struct writelist, node);
-			wl->out.size =
-			    LZ4F_compressFrameBound(ctx->inputsize,
-						    &w->zpref) + 12;
-			list_move(entry, &ctx->writelist_busy);
-		} else {
-			/* allocate new one */
-			wl = (struct writelist *)
-			    malloc(sizeof(struct writelist));
-			if (!wl) {
-				pthread_mutex_unlock(&ctx->write_mutex);
-				return (void *)ERROR(memory_allocation);
-			}
-			wl->out.size =
-			    LZ4F_compressFrameBound(ctx->inputsize,
-						    &w->zpref) + 12;;
-			wl->out.buf = malloc(wl->out.size);
-			if (!wl->out.buf) {
-				pthread_mutex_unlock(&ctx->write_mutex);
-				return (void *)ERROR(memory_allocation);
-			}
-			list_add(&wl->node, &ctx->writelist_busy);
-		}
-		pthread_mutex_unlock(&ctx->write_mutex);
+/* size of a stored frame, see pt_store() */
+static size_t pt_storedsize(size_t size)
+{
+	size_t blocks = (size + LZ4FMT_STORED_BLOCK - 1) / LZ4FMT_STORED_BLOCK;
 
-		/* read new input */
-		pthread_mutex_lock(&ctx->read_mutex);
-		in.size = ctx->inputsize;
-		rv = ctx->fn_read(ctx->arg_read, &in);
-		if (rv != 0) {
-			pthread_mutex_unlock(&ctx->read_mutex);
-			return (void *)mt_error(rv);
-		}
-		
-		/* eof */
-		if (in.size == 0 && ctx->frames > 0) {
-			free(in.buf);
-			pthread_mutex_unlock(&ctx->read_mutex);
+	return 15 + size + 4 * blocks + 8;
+}
 
-			pthread_mutex_lock(&ctx->write_mutex);
-			list_move(&wl->node, &ctx->writelist_free);
-			pthread_mutex_unlock(&ctx->write_mutex);
+/**
+ * pt_store - write a lz4 frame with uncompressed blocks
+ * - independent blocks, content size and content checksum, like the
+ *   compressed frames; the lz4 decoder just copies such blocks
+ */
+static size_t pt_store(unsigned char *dst, const void *src, size_t size)
+{
+	const unsigned char *ip = (const unsigned char *)src;
+	unsigned char *op = dst;
+	size_t left = size;
+
+	/* version 1, independent blocks, content size and checksum */
+	MEM_writeLE32(op, LZ4FMT_MAGICNUMBER);
+	op[4] = 0x6C;
+	op[5] = LZ4FMT_STORED_BLOCKID << 4;
+	MEM_writeLE64(op + 6, (U64) size);
+	op[14] = (unsigned char)(MT_XXH32(op + 4, 10, 0) >> 8);
+	op += 15;
+
+	/* the highest bit of the block size marks uncompressed blocks */
+	while (left) {
+		size_t block = left < LZ4FMT_STORED_BLOCK ?
+		    left : LZ4FMT_STORED_BLOCK;
+
+		MEM_writeLE32(op, (U32) block | 0x80000000U);
+		memcpy(op + 4, ip, block);
+		op += 4 + block;
+		ip += block;
+		left -= block;
+	}
 
-			goto okay;
+	/* end mark and content checksum */
+	MEM_writeLE32(op, 0);
+	MEM_writeLE32(op + 4, MT_XXH32(src, size, 0));
+
+	return (size_t)(op + 8 - dst);
+}
+
+/**
+ * pt_dedup_chunks - expected number of chunks within the dedup window
+ */
+static size_t pt_dedup_chunks(LZ4MT_CCtx * ctx)
+{
+	size_t chunk = ctx->chunker ?
+	    ctx->chunker->min : (size_t)ctx->inputsize / 4;
+
+	return (size_t)(ctx->dedup.window / (chunk ? chunk : 1));
+}
+
+/**
+ * pt_dedup - look for an earlier chunk with the same content
+ * - returns 1, when a reference frame was written instead
+ */
+static int pt_dedup(LZ4MT_CCtx * ctx, struct writelist *wl,
+		    LZ4MT_Buffer * in)
+{
+	U64 hash[2], distance;
+
+	wl->dedup = 0;
+	if (!ctx->dedup.window || in->size == 0)
+		return 0;
+
+	MT_dedup_hash(in->buf, in->size, hash);
+	pthread_mutex_lock(&ctx->write_mutex);
+	distance = MT_dedup_find(&ctx->dedup, hash, wl->offset, in->size);
+	pthread_mutex_unlock(&ctx->write_mutex);
+	if (!distance)
+		return 0;
+
+	wl->out.size = MT_dedup_ref(wl->out.buf, distance, in->size);
+	wl->stored = 0;
+	wl->dedup = 1;
+
+	return 1;
+}
+
+/**
+ * pt_verify - decode the frame again and compare it with the chunk
+ * - one more byte of output space finds frames, which are too long
+ */
+static size_t pt_verify(cwork_t * w, const void *src, size_t size,
+			LZ4MT_Buffer * in)
+{
+	LZ4MT_Buffer *check = &w->check;
+	size_t dsize = in->size + 1, ssize = size, result;
+
+	if (check->allocated < dsize) {
+		free(check->buf);
+		check->buf = malloc(dsize);
+		check->allocated = check->buf ? dsize : 0;
+		if (!check->buf)
+			return ERROR(memory_allocation);
+	}
+	if (!w->dctx &&
+	    LZ4F_isError(LZ4F_createDecompressionContext(&w->dctx,
+							 LZ4F_VERSION)))
+		return ERROR(memory_allocation);
+
+	result = LZ4F_decompress(w->dctx, check->buf, &dsize, src, &ssize, 0);
+	if (LZ4F_isError(result) || result != 0 || ssize != size ||
+	    dsize != in->size || memcmp(check->buf, in->buf, in->size)) {
+		/* the state is undefined now */
+		LZ4F_freeDecompressionContext(w->dctx);
+		w->dctx = 0;
+		return ERROR(verify_failed);
+	}
+
+	return 0;
+}
+
+/**
+ * pt_compress_step - read, compress and write one frame
+ * - returns zero, when there is more work to do
+ * - otherwise the worker is done and w->result holds the error code
+ */
+static int pt_compress_step(void *arg)
+{
+	cwork_t *w = (cwork_t *) arg;
+	LZ4MT_CCtx *ctx = w->ctx;
+	LZ4MT_Buffer *in = &w->in;
+	LZ4MT_Buffer slice;
+	struct list_head *entry;
+	struct writelist *wl;
+	size_t result = 0;
+	int rv;
+	unsigned long long tstart, now;
+
+	/* allocate space for new output */
+	pthread_mutex_lock(&ctx->write_mutex);
+	if (!list_empty(&ctx->writelist_free[w->numa])) {
+		/* take unused entry */
+		entry = list_first(&ctx->writelist_free[w->numa]);
+		wl = list_entry(entry, struct writelist, node);
+		wl->out.size =
+		    LZ4F_compressFrameBound(ctx->inputsize, &w->zpref) +
+		    ctx->hsize;
+		list_move(entry, &ctx->writelist_busy);
+	} else {
+		/* allocate new one */
+		wl = (struct writelist *)
+		    malloc(sizeof(struct writelist));
+		if (!wl) {
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = ERROR(memory_allocation);
+			return 1;
+		}
+		wl->out.size =
+		    LZ4F_compressFrameBound(ctx->inputsize, &w->zpref) +
+		    ctx->hsize;
+		wl->out.buf = malloc(wl->out.size +
+				     MT_BLOOM_FRAMESIZE(ctx->bloom));
+		if (!wl->out.buf) {
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = ERROR(memory_allocation);
+			return 1;
 		}
-		ctx->insize += in.size;
-		wl->frame = ctx->frames++;
+		wl->numa = w->numa;
+		list_add(&wl->node, &ctx->writelist_busy);
+	}
+	wl->level = ctx->curlevel;
+	pthread_mutex_unlock(&ctx->write_mutex);
+
+	/* read new input */
+	tstart = mt_time_us();
+	pthread_mutex_lock(&ctx->read_mutex);
+	if (ctx->errframe) {
+		/* a frame failed its round trip, no more input */
+		pthread_mutex_unlock(&ctx->read_mutex);
+
+		pthread_mutex_lock(&ctx->write_mutex);
+		list_move(&wl->node, &ctx->writelist_free[wl->numa]);
+		pthread_mutex_unlock(&ctx->write_mutex);
+
+		w->result = 0;
+		return 1;
+	}
+	if (ctx->src) {
+		in = &slice;
+		pt_slice(ctx, in);
+		wl->tstart = mt_time_us();
+		rv = 0;
+	} else if (ctx->chunker) {
+		rv = pt_readchunk(ctx, in, &wl->tstart);
+	} else {
+		in->size = ctx->inputsize;
+		rv = pt_read(ctx, in, &wl->tstart);
+	}
+	if (rv != 0) {
 		pthread_mutex_unlock(&ctx->read_mutex);
+		w->result = mt_error(rv);
+		return 1;
+	}
+
+	/* eof */
+	if (in->size == 0 && ctx->frames > 0) {
+		pthread_mutex_unlock(&ctx->read_mutex);
+
+		pthread_mutex_lock(&ctx->write_mutex);
+		list_move(&wl->node, &ctx->writelist_free[wl->numa]);
+		pthread_mutex_unlock(&ctx->write_mutex);
 
-		/* compress whole frame */
+		w->result = 0;
+		return 1;
+	}
+	wl->offset = ctx->insize;
+	ctx->insize += in->size;
+	wl->frame = ctx->frames++;
+	pthread_mutex_unlock(&ctx->read_mutex);
+	w->t_read = mt_time_us() - tstart;
+
+	/* compress whole frame, incompressible data is stored */
+	tstart = mt_time_us();
+	wl->bloom.size = 0;
+	/* the leaf of the tree hash, while the chunk is in the cache */
+	if (ctx->tree)
+		MT_tree_leaf(in->buf, in->size, wl->leaf);
+	if (pt_dedup(ctx, wl, in))
+		goto write;
+
+	/* the bloom filter, while the chunk is still in the cache */
+	if (ctx->bloom && !ctx->fn_write_frame) {
+		wl->bloom.buf = (unsigned char *)wl->out.buf + wl->out.size;
+		wl->bloom.size = MT_bloom_frame(wl->bloom.buf, ctx->bloom,
+						in->buf, in->size);
+	}
+	w->zpref.compressionLevel = wl->level;
+	wl->stored = LZ4FMT_STORED_BLOCKID &&
+	    MT_incompressible(in->buf, in->size);
+	if (!wl->stored) {
 		result =
-		    LZ4F_compressFrame((unsigned char *)wl->out.buf + 12,
-				       wl->out.size - 12, in.buf, in.size,
+		    LZ4F_compressFrame((unsigned char *)wl->out.buf +
+				       ctx->hsize, wl->out.size - ctx->hsize,
+				       in->buf, in->size,
 				       &w->zpref);
 		if (LZ4F_isError(result)) {
 			pthread_mutex_lock(&ctx->write_mutex);
-			list_move(&wl->node, &ctx->writelist_free);
+			list_move(&wl->node,
+				  &ctx->writelist_free[wl->numa]);
 			pthread_mutex_unlock(&ctx->write_mutex);
 			/* user can lookup that code */
 			lz4mt_errcode = result;
-			return (void *)ERROR(compression_library);
+			w->result = ERROR(compression_library);
+			return 1;
 		}
+		wl->stored = LZ4FMT_STORED_BLOCKID &&
+		    result > pt_storedsize(in->size);
+	}
+	if (wl->stored)
+		result = pt_store((unsigned char *)wl->out.buf + ctx->hsize,
+				  in->buf, in->size);
+
+	/* round trip, while the chunk is still in the cache */
+	if (ctx->verify) {
+		size_t err = pt_verify(w, (unsigned char *)wl->out.buf +
+				       ctx->hsize, result, in);
+
+		if (LZ4MT_isError(err)) {
+			pthread_mutex_lock(&ctx->read_mutex);
+			if (err == ERROR(verify_failed) &&
+			    (!ctx->errframe || wl->frame < ctx->errframe - 1)) {
+				ctx->errframe = wl->frame + 1;
+				ctx->erroffset = wl->offset;
+			}
+			pthread_mutex_unlock(&ctx->read_mutex);
+			pthread_mutex_lock(&ctx->write_mutex);
+			list_move(&wl->node,
+				  &ctx->writelist_free[wl->numa]);
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = err;
+			return 1;
+		}
+	}
 
-		/* write skippable frame */
-		MEM_writeLE32((unsigned char *)wl->out.buf + 0,
-			      LZ4FMT_MAGIC_SKIPPABLE);
-		MEM_writeLE32((unsigned char *)wl->out.buf + 4, 4);
-		MEM_writeLE32((unsigned char *)wl->out.buf + 8, (U32) result);
-		wl->out.size = result + 12;
+	/* version 2 header, with the exact sizes */
+	if (ctx->hsize != 12) {
+		MT_Frame f;
+
+		f.csize = result;
+		f.usize = in->size;
+		f.magic = 0;
+		f.flags = ctx->checksum;
+		f.checksum = ctx->checksum ?
+		    MT_XXH64(in->buf, in->size, 0) : 0;
+		MT_frame_write(wl->out.buf, &f);
+		wl->out.size = result + ctx->hsize;
+		goto write;
+	}
 
-		/* write result */
-		pthread_mutex_lock(&ctx->write_mutex);
-		result = pt_write(ctx, wl);
-		pthread_mutex_unlock(&ctx->write_mutex);
-		if (LZ4MT_isError(result))
-			return (void *)result;
+	/* write skippable frame */
+	MEM_writeLE32((unsigned char *)wl->out.buf + 0,
+		      LZ4FMT_MAGIC_SKIPPABLE);
+	MEM_writeLE32((unsigned char *)wl->out.buf + 4, 4);
+	MEM_writeLE32((unsigned char *)wl->out.buf + 8, (U32) result);
+	wl->out.size = result + 12;
+
+ write:
+	/* write result */
+	now = mt_time_us();
+	w->t_busy = now - tstart;
+	rv = pt_writeframe(ctx, wl);
+	pthread_mutex_lock(&ctx->write_mutex);
+	result = rv ? mt_error(rv) : pt_write(ctx, wl);
+	pt_account(ctx, w, mt_time_us() - now);
+	pt_level(ctx);
+	pthread_mutex_unlock(&ctx->write_mutex);
+	if (LZ4MT_isError(result)) {
+		w->result = result;
+		return 1;
 	}
 
- okay:
+	return 0;
+}
+
+static void *pt_compress(void *arg)
+{
+	cwork_t *w = (cwork_t *) arg;
+
+	/* the input buffer is touched first by the pinned worker */
+	if (w->cpu >= 0 && mt_pin(w->cpu) == 0 && w->in.size)
+		memset(w->in.buf, 0, w->in.size);
+
+	while (pt_compress_step(w) == 0)
+		pt_park(w);
+
+	/* release the parked workers */
+	pthread_mutex_lock(&w->ctx->write_mutex);
+	w->ctx->stopped++;
+	pthread_cond_broadcast(&w->ctx->park_cond);
+	pthread_mutex_unlock(&w->ctx->write_mutex);
+
+	return (void *)w->result;
+}
+
+/**
+ * pt_tree - hash the tree up to its root, the trailer frame is optional
+ */
+static size_t pt_tree(LZ4MT_CCtx * ctx)
+{
+	unsigned char buf[MT_TREE_FRAMESIZE];
+	LZ4MT_Buffer b;
+	int rv;
+
+	MT_tree_root(&ctx->leaves, ctx->root);
+	ctx->treeframes = ctx->leaves.count;
+	if (ctx->tree != 2)
+		return 0;
+
+	b.buf = buf;
+	b.size = MT_tree_frame(buf, ctx->treeframes, ctx->root);
+	b.allocated = b.size;
+	rv = ctx->fn_write(ctx->arg_write, &b);
+	if (rv != 0)
+		return mt_error(rv);
+	ctx->outsize += b.size;
+
 	return 0;
 }
 
@@ -323,32 +1196,136 @@ size_t LZ4MT_compressCCtx(LZ4MT_CCtx * ctx, LZ4MT_RdWr_t * rdwr)
 	ctx->arg_read = rdwr->arg_read;
 	ctx->arg_write = rdwr->arg_write;
 
-	/* start all workers */
+	/* reset latency statistic */
+	ctx->latency_sum = 0;
+	ctx->latency_max = 0;
+
+	/* reset thread statistic, all workers start unparked */
+	ctx->active = ctx->threads;
+	ctx->stopped = 0;
+	ctx->stored = 0;
+	ctx->treeframes = 0;
+	MT_tree_free(&ctx->leaves);
+	ctx->errframe = 0;
+	ctx->erroffset = 0;
+	ctx->dedups = 0;
+	ctx->carry.size = 0;
+	ctx->srcpos = 0;
+	ctx->parked = 0;
+	ctx->unparked = 0;
+	ctx->busy_us = 0;
+	ctx->read_us = 0;
+	ctx->write_us = 0;
+	ctx->adapt_last = mt_time_us();
+	ctx->adapt_busy = 0;
+	ctx->adapt_wait = 0;
+
+	/* the adaptive level starts with the level of the cctx */
+	ctx->curlevel = ctx->level;
+	if (ctx->minlevel && ctx->curlevel < ctx->minlevel)
+		ctx->curlevel = ctx->minlevel;
+	if (ctx->maxlevel && ctx->curlevel > ctx->maxlevel)
+		ctx->curlevel = ctx->maxlevel;
+	ctx->level_last = mt_time_us();
+	ctx->level_all = 0;
+	ctx->level_busy = 0;
+	ctx->level_write = 0;
+	memset(ctx->levels, 0, sizeof(ctx->levels));
+
+	/* deduplication, the window frame comes first */
+	if (ctx->dedup.window) {
+		unsigned char hdr[8 + MT_DEDUP_WINDOWSIZE];
+		LZ4MT_Buffer b;
+		int rv;
+
+		if (MT_dedup_init(&ctx->dedup, ctx->dedup.window,
+				  pt_dedup_chunks(ctx)))
+			return ERROR(memory_allocation);
+		b.buf = hdr;
+		b.size = MT_dedup_window(hdr, ctx->dedup.window);
+		b.allocated = b.size;
+		rv = ctx->fn_write(ctx->arg_write, &b);
+		if (rv != 0) {
+			MT_dedup_free(&ctx->dedup);
+			return mt_error(rv);
+		}
+		ctx->outsize += b.size;
+	}
+
+	/* inbuf is constant */
 	for (t = 0; t < ctx->threads; t++) {
 		cwork_t *w = &ctx->cwork[t];
-		pthread_create(&w->pthread, NULL, pt_compress, w);
+		w->result = 0;
+		w->cpu = -1;
+		w->numa = 0;
+		if (ctx->affinity == MT_AFFINITY_SPREAD && !ctx->pool)
+			mt_placement(t, &w->cpu, &w->numa);
+		/* the chunks of a source are borrowed */
+		w->in.size = ctx->src ? 0 : ctx->inputsize;
+		w->in.buf = w->in.size ? malloc(w->in.size) : 0;
+		if (w->in.size && !w->in.buf) {
+			while (t--)
+				free(ctx->cwork[t].in.buf);
+			return ERROR(memory_allocation);
+		}
+	}
+
+	if (ctx->pool) {
+		/* run the workers as jobs of the shared pool */
+		if (POOLMT_run(ctx->pool, ctx->weight, pt_compress_step,
+			       ctx->cwork, sizeof(cwork_t), ctx->threads))
+			retval_of_thread = (void *)ERROR(memory_allocation);
+	} else {
+		/* start all workers */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *w = &ctx->cwork[t];
+			pthread_create(&w->pthread, NULL, pt_compress, w);
+		}
+
+		/* wait for all workers */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *w = &ctx->cwork[t];
+			pthread_join(w->pthread, 0);
+		}
 	}
 
-	/* wait for all workers */
+	/* collect the results */
 	for (t = 0; t < ctx->threads; t++) {
 		cwork_t *w = &ctx->cwork[t];
-		void *p = 0;
-		pthread_join(w->pthread, &p);
-		if (p)
-			retval_of_thread = p;
+		if (w->result)
+			retval_of_thread = (void *)w->result;
+		free(w->in.buf);
 	}
 
-	/* clean up lists */
-	while (!list_empty(&ctx->writelist_free)) {
+	/* frames behind a failed one were not written */
+	while (!list_empty(&ctx->writelist_done)) {
 		struct writelist *wl;
 		struct list_head *entry;
-		entry = list_first(&ctx->writelist_free);
+		entry = list_first(&ctx->writelist_done);
 		wl = list_entry(entry, struct writelist, node);
-		free(wl->out.buf);
-		list_del(&wl->node);
-		free(wl);
+		list_move(entry, &ctx->writelist_free[wl->numa]);
+	}
+
+	/* clean up lists */
+	for (t = 0; t < MT_NODE_MAX; t++) {
+		while (!list_empty(&ctx->writelist_free[t])) {
+			struct writelist *wl;
+			struct list_head *entry;
+			entry = list_first(&ctx->writelist_free[t]);
+			wl = list_entry(entry, struct writelist, node);
+			free(wl->out.buf);
+			list_del(&wl->node);
+			free(wl);
+		}
 	}
 
+	/* the root of the tree hash, behind the last frame */
+	if (ctx->tree && !retval_of_thread)
+		retval_of_thread = (void *)pt_tree(ctx);
+	MT_tree_free(&ctx->leaves);
+
+	MT_dedup_free(&ctx->dedup);
+
 	return (size_t) retval_of_thread;
 }
 
@@ -379,13 +1356,116 @@ size_t LZ4MT_GetFramesCCtx(LZ4MT_CCtx * ctx)
 	return ctx->curframe;
 }
 
+/* returns the frames of the tree hash, root gets its root */
+size_t LZ4MT_GetTreeHashCCtx(LZ4MT_CCtx * ctx, unsigned long long *root)
+{
+	if (!ctx || !ctx->tree)
+		return 0;
+
+	root[0] = ctx->root[0];
+	root[1] = ctx->root[1];
+
+	return ctx->treeframes;
+}
+
+size_t LZ4MT_GetErrorFrameCCtx(LZ4MT_CCtx * ctx, unsigned long long *offset)
+{
+	if (!ctx)
+		return 0;
+
+	if (offset)
+		*offset = ctx->erroffset;
+
+	return ctx->errframe;
+}
+
+/* returns the estimated memory usage of all workers and the dedup table */
+size_t LZ4MT_GetMemoryCCtx(LZ4MT_CCtx * ctx)
+{
+	size_t worker, shared;
+
+	if (!ctx)
+		return 0;
+
+	/**
+	 * input, two outputs (one may wait for writing) and some space,
+	 * which LZ4F_compressFrame() allocates for the hc state
+	 */
+	worker = ctx->src ? 0 : ctx->inputsize;
+	worker += 2 * (LZ4F_compressFrameBound(ctx->inputsize,
+					       &ctx->cwork[0].zpref) +
+		       ctx->hsize + MT_BLOOM_FRAMESIZE(ctx->bloom));
+	worker += 1024 * 256;
+
+	/* the decoded frame of the round trip */
+	if (ctx->verify)
+		worker += ctx->inputsize;
+
+	/* the table of the deduplication is shared by all threads */
+	shared = ctx->dedup.window ? MT_dedup_memory(pt_dedup_chunks(ctx)) : 0;
+
+	return worker * ctx->threads + shared;
+}
+
+/* returns the thread statistic of the last compression */
+size_t LZ4MT_GetStatsCCtx(LZ4MT_CCtx * ctx, LZ4MT_Stats * stats)
+{
+	if (!ctx || !stats)
+		return ERROR(compressionParameter_unsupported);
+
+	stats->threads = ctx->threads;
+	stats->active = ctx->active;
+	stats->parked = ctx->parked;
+	stats->unparked = ctx->unparked;
+	stats->busy_us = ctx->busy_us;
+	stats->read_us = ctx->read_us;
+	stats->write_us = ctx->write_us;
+	stats->stored = ctx->stored;
+	stats->dedup = ctx->dedups;
+	stats->level = ctx->curlevel;
+	memcpy(stats->levels, ctx->levels, sizeof(stats->levels));
+
+	return 0;
+}
+
+/* returns the max latency of the written frames in us */
+size_t LZ4MT_GetLatencyMaxCCtx(LZ4MT_CCtx * ctx)
+{
+	if (!ctx)
+		return 0;
+
+	return (size_t)ctx->latency_max;
+}
+
+/* returns the average latency of the written frames in us */
+size_t LZ4MT_GetLatencyAvgCCtx(LZ4MT_CCtx * ctx)
+{
+	if (!ctx || !ctx->curframe)
+		return 0;
+
+	return (size_t)(ctx->latency_sum / ctx->curframe);
+}
+
 void LZ4MT_freeCCtx(LZ4MT_CCtx * ctx)
 {
+	int t;
+
 	if (!ctx)
 		return;
 
 	pthread_mutex_destroy(&ctx->read_mutex);
 	pthread_mutex_destroy(&ctx->write_mutex);
+	pthread_cond_destroy(&ctx->park_cond);
+	free(ctx->chunker);
+	free(ctx->carry.buf);
+	MT_dedup_free(&ctx->dedup);
+	MT_tree_free(&ctx->leaves);
+	for (t = 0; t < ctx->threads; t++) {
+		cwork_t *w = &ctx->cwork[t];
+		if (w->dctx)
+			LZ4F_freeDecompressionContext(w->dctx);
+		free(w->check.buf);
+	}
 	free(ctx->cwork);
 	free(ctx);
 	ctx = 0;
@@ -0,0 +1,257 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#include <stdlib.h>
+
+#include "threading.h"
+#include "list.h"
+#include "pool-mt.h"
+
+/**
+ * shared worker pool - stride scheduling
+ *
+ * - every caller of POOLMT_run() becomes a client of the pool
+ * - each client has a pass value, which grows by its stride for every
+ *   started job step, the stride is (POOLMT_STRIDE / weight)
+ * - an idle thread of the pool takes the client with the lowest pass,
+ *   which has some job ready, and runs one step of that job
+ * - new clients start with the pass of the last started step, so they
+ *   do not get a huge bonus against the ones, which are running longer
+ */
+
+#define POOLMT_STRIDE (1 << 20)
+
+struct client {
+	POOLMT_fn *fn;
+	char *base;
+	size_t size;
+	int count;
+
+	/* jobs, which are ready for the next step */
+	int *ready;
+	int nready;
+
+	/* jobs, which returned nonzero */
+	int finished;
+
+	/* stride scheduling */
+	unsigned long long pass;
+	unsigned long long stride;
+
+	/* signaled, when all jobs are finished */
+	pthread_cond_t cond;
+	struct list_head node;
+};
+
+struct POOLMT_Pool_s {
+	int threads;
+	pthread_t *pthread;
+
+	/* protects everything below */
+	pthread_mutex_t mutex;
+
+	/* signaled, when new jobs are there or on shutdown */
+	pthread_cond_t cond;
+
+	struct list_head clients;
+	unsigned long long pass;
+	size_t steps;
+	int shutdown;
+};
+
+/* get client with lowest pass, which has some job ready */
+static struct client *pt_pick(POOLMT_Pool * pool)
+{
+	struct client *best = 0;
+	struct list_head *entry;
+
+	list_for_each(entry, &pool->clients) {
+		struct client *c = list_entry(entry, struct client, node);
+		if (c->nready == 0)
+			continue;
+		if (!best || c->pass < best->pass)
+			best = c;
+	}
+
+	return best;
+}
+
+static void *pt_worker(void *arg)
+{
+	POOLMT_Pool *pool = (POOLMT_Pool *) arg;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		struct client *c;
+		int job, rv;
+
+		c = pt_pick(pool);
+		if (!c) {
+			if (pool->shutdown)
+				break;
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+			continue;
+		}
+
+		/* take job and charge the client */
+		job = c->ready[--c->nready];
+		pool->pass = c->pass;
+		c->pass += c->stride;
+		pool->steps++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		rv = c->fn(c->base + c->size * job);
+
+		pthread_mutex_lock(&pool->mutex);
+		if (rv == 0) {
+			c->ready[c->nready++] = job;
+		} else if (++c->finished == c->count) {
+			pthread_cond_signal(&c->cond);
+		}
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return 0;
+}
+
+POOLMT_Pool *POOLMT_create(int threads)
+{
+	POOLMT_Pool *pool;
+	int t;
+
+	/* check threads value */
+	if (threads < 1 || threads > POOLMT_THREAD_MAX)
+		return 0;
+
+	/* allocate pool */
+	pool = (POOLMT_Pool *) malloc(sizeof(POOLMT_Pool));
+	if (!pool)
+		return 0;
+
+	pool->pthread = (pthread_t *) malloc(sizeof(pthread_t) * threads);
+	if (!pool->pthread) {
+		free(pool);
+		return 0;
+	}
+
+	pool->threads = threads;
+	pool->pass = 0;
+	pool->steps = 0;
+	pool->shutdown = 0;
+	INIT_LIST_HEAD(&pool->clients);
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->cond, NULL);
+
+	for (t = 0; t < threads; t++) {
+		if (pthread_create(&pool->pthread[t], NULL, pt_worker, pool)) {
+			/* stop and join only the threads, which were started */
+			pool->threads = t;
+			POOLMT_free(pool);
+			return 0;
+		}
+	}
+
+	return pool;
+}
+
+int POOLMT_run(POOLMT_Pool * pool, int weight, POOLMT_fn * fn,
+	       void *base, size_t size, int count)
+{
+	struct client c;
+	int i;
+
+	if (count < 1)
+		return 0;
+
+	/* check weight */
+	if (weight < 1)
+		weight = 1;
+	else if (weight > POOLMT_WEIGHT_MAX)
+		weight = POOLMT_WEIGHT_MAX;
+
+	c.ready = (int *)malloc(sizeof(int) * count);
+	if (!c.ready)
+		return -1;
+
+	c.fn = fn;
+	c.base = (char *)base;
+	c.size = size;
+	c.count = count;
+	c.finished = 0;
+	c.stride = POOLMT_STRIDE / weight;
+	for (i = 0; i < count; i++)
+		c.ready[i] = count - i - 1;
+	c.nready = count;
+	pthread_cond_init(&c.cond, NULL);
+
+	pthread_mutex_lock(&pool->mutex);
+	c.pass = pool->pass;
+	list_add(&c.node, &pool->clients);
+	pthread_cond_broadcast(&pool->cond);
+	while (c.finished != c.count)
+		pthread_cond_wait(&c.cond, &pool->mutex);
+	list_del(&c.node);
+	pthread_mutex_unlock(&pool->mutex);
+
+	pthread_cond_destroy(&c.cond);
+	free(c.ready);
+
+	return 0;
+}
+
+/* returns the number of threads */
+int POOLMT_GetThreads(POOLMT_Pool * pool)
+{
+	if (!pool)
+		return 0;
+
+	return pool->threads;
+}
+
+/* returns the number of executed job steps */
+size_t POOLMT_GetSteps(POOLMT_Pool * pool)
+{
+	size_t steps;
+
+	if (!pool)
+		return 0;
+
+	pthread_mutex_lock(&pool->mutex);
+	steps = pool->steps;
+	pthread_mutex_unlock(&pool->mutex);
+
+	return steps;
+}
+
+void POOLMT_free(POOLMT_Pool * pool)
+{
+	int t;
+
+	if (!pool)
+		return;
+
+	pthread_mutex_lock(&pool->mutex);
+	pool->shutdown = 1;
+	pthread_cond_broadcast(&pool->cond);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (t = 0; t < pool->threads; t++)
+		pthread_join(pool->pthread[t], 0);
+
+	pthread_cond_destroy(&pool->cond);
+	pthread_mutex_destroy(&pool->mutex);
+	free(pool->pthread);
+	free(pool);
+
+	return;
+}
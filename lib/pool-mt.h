@@ -0,0 +1,93 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef POOLMT_H
+#define POOLMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+/**
+ * shared worker pool
+ *
+ * - by default, each context starts its own threads for every call of
+ *   the compress or decompress function
+ * - when many contexts run in parallel, this will oversubscribe the cpu
+ * - so all contexts (of all codecs) can be attached to one pool, then
+ *   the per-frame work of all of them runs on the threads of the pool
+ * - each attached context has a weight, the pool hands out the frames
+ *   in proportion of these weights (stride scheduling), so a big stream
+ *   can not starve the smaller ones
+ */
+
+#define POOLMT_THREAD_MAX 128
+#define POOLMT_WEIGHT_MAX 1000
+
+/**
+ * placement of the own threads of a context, see XXX_SetAffinityCCtx()
+ * - MT_AFFINITY_NONE: the scheduler decides (default)
+ * - MT_AFFINITY_SPREAD: pin the workers to the physical cores of all
+ *   numa nodes first, then to their SMT siblings
+ */
+#define MT_AFFINITY_NONE   0
+#define MT_AFFINITY_SPREAD 1
+
+typedef struct POOLMT_Pool_s POOLMT_Pool;
+
+/**
+ * 1) create a pool with some threads
+ * - return pool or zero on error
+ *
+ * @threads - 1 .. POOLMT_THREAD_MAX
+ */
+POOLMT_Pool *POOLMT_create(int threads);
+
+/**
+ * 2) attach the contexts via XXX_SetPoolCCtx() and XXX_SetPoolDCtx()
+ * - weight: 1 .. POOLMT_WEIGHT_MAX
+ * - the pool must not be freed, while some context is using it
+ */
+
+/**
+ * internal: run count jobs within the pool
+ * - fn is called again and again with the job as argument, until it
+ *   returns nonzero, then the job is done
+ * - the jobs are the count elements of size bytes, starting at base
+ * - at most count jobs of one caller run at the same time
+ * - the caller blocks, until all jobs are done
+ * - it must not be called from within a job of the same pool
+ * - returns zero on success or -1 when out of memory
+ */
+typedef int (POOLMT_fn) (void *job);
+int POOLMT_run(POOLMT_Pool * pool, int weight, POOLMT_fn * fn,
+	       void *base, size_t size, int count);
+
+/**
+ * 3) get some statistic
+ * - number of threads and the number of executed job steps
+ */
+int POOLMT_GetThreads(POOLMT_Pool * pool);
+size_t POOLMT_GetSteps(POOLMT_Pool * pool);
+
+/**
+ * 4) free the pool, waits for its threads
+ */
+void POOLMT_free(POOLMT_Pool * pool);
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* POOLMT_H */
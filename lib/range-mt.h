@@ -0,0 +1,131 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef RANGEMT_H
+#define RANGEMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memmt.h"
+#include "frame-mt.h"
+
+/**
+ * decompression of a byte range of the compressed input
+ *
+ * - for splitting a file into independent parts, each part decodes the
+ *   frames, whose headers begin within [start, end)
+ * - the input of the part begins at start, so the first frame header
+ *   is searched: the skippable magic 0x184D2A50, the header size and
+ *   the magic of the codec behind it (version 1) or the checksum of
+ *   the header (version 2) must fit, so that the bytes of compressed
+ *   data or of other headers are not taken for a frame
+ * - the bytes, which were read ahead by the search, are given to the
+ *   following reads again, before the real input
+ * - the last frame is read up to its end, also behind the range
+ */
+
+#define MT_RANGE_HDRMIN   16
+#define MT_RANGE_HDRMAX   MT_FRAME_MAXSIZE
+#define MT_RANGE_BUFSIZE  (64 * 1024)
+
+/* checks a frame header of the codec, avail bytes can be read */
+typedef int (MT_range_fn) (const BYTE * hdr, size_t avail);
+
+typedef struct {
+	U64 start;		/* offset of the input */
+	U64 end;		/* end of the range, zero when not used */
+	U64 left;		/* bytes for frame starts, behind the first */
+	U64 insize;		/* insize of the ctx at the first frame */
+	BYTE *buf;		/* read ahead by the search */
+	size_t pos;
+	size_t size;
+} MT_Range;
+
+MEM_STATIC void MT_range_init(MT_Range * r)
+{
+	r->start = 0;
+	r->end = 0;
+	r->buf = 0;
+	r->pos = 0;
+	r->size = 0;
+}
+
+MEM_STATIC void MT_range_free(MT_Range * r)
+{
+	free(r->buf);
+	r->buf = 0;
+	r->pos = 0;
+	r->size = 0;
+}
+
+/**
+ * find the first valid frame header in p, returns n when there is none
+ * - hlen: the bytes, which a header has at least
+ */
+MEM_STATIC size_t MT_range_find(const BYTE * p, size_t n, size_t hlen,
+				MT_range_fn * valid)
+{
+	const BYTE *end = p + n;
+	const BYTE *q = p;
+
+	while ((size_t)(end - q) >= hlen) {
+		q = (const BYTE *)memchr(q, MT_FRAME_MAGIC & 0xff,
+					 (size_t)(end - q) - hlen + 1);
+		if (!q)
+			break;
+		if (MEM_readLE32(q) == MT_FRAME_MAGIC &&
+		    valid(q, (size_t)(end - q)))
+			return (size_t)(q - p);
+		q++;
+	}
+
+	return n;
+}
+
+/**
+ * copy the bytes, which were read ahead, returns their number
+ */
+MEM_STATIC size_t MT_range_get(MT_Range * r, void *dst, size_t n)
+{
+	size_t have = r->size - r->pos;
+
+	if (!have)
+		return 0;
+	if (n > have)
+		n = have;
+	memcpy(dst, r->buf + r->pos, n);
+	r->pos += n;
+	if (r->pos == r->size)
+		MT_range_free(r);
+
+	return n;
+}
+
+/**
+ * true, when the next frame header is behind the range
+ * - insize: the current input size of the ctx
+ */
+MEM_STATIC int MT_range_done(const MT_Range * r, U64 insize)
+{
+	return r->end && insize - r->insize >= r->left;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* RANGEMT_H */
@@ -11,10 +11,13 @@ extern "C" {
 
 #include <stddef.h>   /* size_t */
 
+#include "pool-mt.h"
+
 #define SNAPPY_OK 0
 #define SNAPPYMT_THREAD_MAX 128
 #define SNAPPYMT_MAGICNUMBER 0x5053 // SP
 #define SNAPPYMT_MAGIC_SKIPPABLE 0x184D2A50U  // MT magic number
+#define SNAPPYMT_MAGIC_STORED 0x5353 // SS, uncompressed frame
 
 /* **************************************
  * Error Handling
@@ -31,6 +34,9 @@ typedef enum {
   SNAPPYMT_error_compressionParameter_unsupported,
   SNAPPYMT_error_compression_library,
   SNAPPYMT_error_canceled,
+  SNAPPYMT_error_checksum_wrong,
+  SNAPPYMT_error_verify_failed,
+  SNAPPYMT_error_tree_wrong,
   SNAPPYMT_error_maxCode
 } SNAPPYMT_ErrorCode;
 
@@ -56,9 +62,16 @@ typedef struct {
  * - a sample is given in 7-Zip ZS or bromt.c
  * - the function should return -1 on error and zero on success
  * - the read or written bytes will go to in->size or out->size
+ * - with a max latency (see SNAPPYMT_SetMaxLatencyCCtx) fn_read may also
+ *   return less bytes than requested, zero bytes are still eof; it
+ *   should return 1 when no input arrived for a while (some fraction
+ *   of the latency), so the library can cut the current frame
  */
 typedef int (fnRead) (void *args, SNAPPYMT_Buffer * in);
 typedef int (fnWrite) (void *args, SNAPPYMT_Buffer * out);
+typedef int (fnFilter) (void *args, SNAPPYMT_Buffer * out);
+typedef int (fnWriteFrame) (void *args, SNAPPYMT_Buffer * out, size_t frame,
+			   unsigned long long offset);
 
 typedef struct {
 	fnRead *fn_read;
@@ -85,6 +98,153 @@ typedef struct SNAPPYMT_CCtx_s SNAPPYMT_CCtx;
 SNAPPYMT_CCtx *SNAPPYMT_createCCtx(int threads, int level,/*Not use*/ 
                                    int inputsize);
 
+/**
+ * 1a) optional: set max latency for streaming input
+ * - a partially filled input chunk is compressed and written as a
+ *   short frame, when its first byte waits longer than msec
+ * - zero disables it (default), the chunk is then always filled up
+ */
+size_t SNAPPYMT_SetMaxLatencyCCtx(SNAPPYMT_CCtx * ctx, int msec);
+
+/**
+ * 1b) optional: run within a shared pool (see pool-mt.h)
+ * - the threads value of the cctx is then the max number of frames,
+ *   which are compressed in parallel
+ * - weight: 1 .. POOLMT_WEIGHT_MAX, the share within the pool
+ * - pool can be zero, to use own threads again
+ */
+size_t SNAPPYMT_SetPoolCCtx(SNAPPYMT_CCtx * ctx, POOLMT_Pool * pool, int weight);
+
+/**
+ * 1c) optional: placement of the worker threads (see pool-mt.h)
+ * - MT_AFFINITY_NONE: the scheduler decides (default)
+ * - MT_AFFINITY_SPREAD: pin the workers over the physical cores of all
+ *   numa nodes first, output buffers are reused per node then
+ * - has no effect, when running within a shared pool
+ */
+size_t SNAPPYMT_SetAffinityCCtx(SNAPPYMT_CCtx * ctx, int policy);
+
+/**
+ * 1d) optional: adaptive number of active workers
+ * - every 100ms one worker is parked, when the workers wait most of
+ *   the time for input or output, or unparked, when they compress
+ *   most of the time
+ * - minthreads: min active workers, the max is the threads value of
+ *   the cctx, zero disables it (default)
+ * - has no effect, when running within a shared pool
+ */
+size_t SNAPPYMT_SetAdaptiveCCtx(SNAPPYMT_CCtx * ctx, int minthreads);
+
+/**
+ * 1e) optional: content defined chunking (FastCDC)
+ * - the frame boundaries are found by a rolling hash over the input, so
+ *   unchanged regions of a file give the same frames again, also when
+ *   some bytes were inserted or removed before them
+ * - avgsize: wanted frame size, rounded down to a power of two
+ * - minsize, maxsize: limits of the frame size, zero for avgsize / 4
+ *   and avgsize * 4, the input size of the cctx becomes maxsize
+ * - avgsize zero disables it (default)
+ */
+size_t SNAPPYMT_SetChunkingCCtx(SNAPPYMT_CCtx * ctx, int minsize, int avgsize,
+				int maxsize);
+
+/**
+ * 1f) optional: frame level deduplication
+ * - chunks, which were seen within the last window MiB of input, are
+ *   written as a reference to the earlier data instead of a new frame
+ * - works best together with content defined chunking (1e)
+ * - the decompressor needs window MiB of memory for it
+ * - window zero disables it (default), max is 4096
+ */
+size_t SNAPPYMT_SetDedupCCtx(SNAPPYMT_CCtx * ctx, int window);
+
+/**
+ * 1g) optional: record aware chunking
+ * - the frames are cut only behind the delimiter, so each frame gives
+ *   whole records, which can be processed on their own (log files)
+ * - delim: 1 .. 16 bytes, like "\n", dlen zero disables it
+ * - tolerance: 1 .. 99 percent, the frame size is the input size of the
+ *   cctx +/- this, longer records are cut anyway
+ * - replaces the content defined chunking (1e)
+ */
+size_t SNAPPYMT_SetDelimiterCCtx(SNAPPYMT_CCtx * ctx, const void *delim, int dlen,
+                                 int tolerance);
+
+/**
+ * 1h) optional: bloom filter of each frame (see bloom-mt.h)
+ * - a skippable frame with the trigrams of the chunk is written in
+ *   front of each data frame, other decompressors just skip it
+ * - a search can skip the frames, which can not contain its pattern
+ *   (see SNAPPYMT_SetBloomDCtx), best with record aware chunking (1g)
+ * - size: bytes of each filter, rounded down to a power of two,
+ *   64 .. 1 MiB, zero disables it (default)
+ */
+size_t SNAPPYMT_SetBloomCCtx(SNAPPYMT_CCtx * ctx, int size);
+
+/**
+ * 1i) optional: unordered writing
+ * - fn is called for each frame, as soon as it is compressed, with its
+ *   number and the offset of its input, so a slow frame does not stall
+ *   the others
+ * - it runs within the workers, without a lock, so it must be thread
+ *   safe, fn_write gets only the window frame of a deduplicated stream
+ * - no bloom frames are written then
+ * - fn zero disables it (default)
+ */
+size_t SNAPPYMT_SetUnorderedCCtx(SNAPPYMT_CCtx * ctx, fnWriteFrame * fn, void *arg);
+
+/**
+ * 1j) optional: version of the frame headers (see frame-mt.h)
+ * - 1: 16 bytes with 32 bit compressed size and a size hint (default)
+ * - 2: 32 bytes with 64 bit compressed and uncompressed size, so the
+ *   decompressors allocate the exact output and a reader can get the
+ *   offsets and sizes of all frames without decoding them
+ * - the decompressors read both versions
+ */
+size_t SNAPPYMT_SetHeaderCCtx(SNAPPYMT_CCtx * ctx, int version);
+
+/**
+ * 1k) optional: checksum of each frame
+ * - the workers store the xxHash64 of the uncompressed data of their
+ *   frame in its version 2 header, which is selected by this
+ *   (version 1 has no field for it and drops it again)
+ * - the decompression workers check it in parallel, before the frame
+ *   is written, a wrong one gives SNAPPYMT_error_checksum_wrong
+ * - enable zero disables it (default)
+ */
+size_t SNAPPYMT_SetChecksumCCtx(SNAPPYMT_CCtx * ctx, int enable);
+
+/**
+ * 1l) optional: tree hash of the input (see tree-mt.h)
+ * - the workers hash their chunks, the hashes are combined in the order
+ *   of the frames to a root of 128 bit
+ * - mode 1 computes the root, mode 2 also writes it as trailer frame,
+ *   zero disables it (default)
+ */
+size_t SNAPPYMT_SetTreeHashCCtx(SNAPPYMT_CCtx * ctx, int mode);
+
+/**
+ * 1m) optional: round trip of each frame
+ * - the workers decode their frame again and compare it with the chunk,
+ *   before the frame goes to the writer
+ * - a mismatch stops the other workers and gives
+ *   SNAPPYMT_error_verify_failed, see SNAPPYMT_GetErrorFrameCCtx()
+ * - enable zero disables it (default)
+ */
+size_t SNAPPYMT_SetVerifyCCtx(SNAPPYMT_CCtx * ctx, int enable);
+
+/**
+ * 1n) optional: read the input from memory, like a mapped file
+ * - the workers take their chunks straight from src, without copying
+ *   them and without calling fn_read, which may be zero then
+ * - src must stay valid and unchanged until SNAPPYMT_compressCCtx()
+ *   returns, the max latency does not apply
+ * - each following SNAPPYMT_compressCCtx() reads it from the start, src
+ *   zero goes back to fn_read (default)
+ */
+size_t SNAPPYMT_SetSourceCCtx(SNAPPYMT_CCtx * ctx, const void *src,
+			      size_t size);
+
 /**
  * 2) threaded compression
  * - errorcheck via 
@@ -98,6 +258,53 @@ size_t SNAPPYMT_GetFramesCCtx(SNAPPYMT_CCtx * ctx);
 size_t SNAPPYMT_GetInsizeCCtx(SNAPPYMT_CCtx * ctx);
 size_t SNAPPYMT_GetOutsizeCCtx(SNAPPYMT_CCtx * ctx);
 
+/**
+ * 3b) estimated memory usage of all workers in bytes
+ * - can be used before compressing, for checking some memory limit
+ * - it depends on the other settings, so call it after all setters, the
+ *   table of the deduplication is included
+ */
+size_t SNAPPYMT_GetMemoryCCtx(SNAPPYMT_CCtx * ctx);
+
+/**
+ * 3c) thread statistic of the last compression
+ * - the times are the sums of all workers in microseconds
+ */
+typedef struct {
+	int threads;		/* max workers of the cctx */
+	int active;		/* active workers, the others are parked */
+	size_t parked;		/* decisions for parking a worker */
+	size_t unparked;	/* decisions for unparking a worker */
+	unsigned long long busy_us;	/* compressing */
+	unsigned long long read_us;	/* waiting for and reading input */
+	unsigned long long write_us;	/* waiting for and writing output */
+	size_t stored;		/* frames, which are stored */
+	size_t dedup;		/* frames, which are references */
+} SNAPPYMT_Stats;
+
+size_t SNAPPYMT_GetStatsCCtx(SNAPPYMT_CCtx * ctx, SNAPPYMT_Stats * stats);
+
+/**
+ * 3d) root of the tree hash, of the last compression
+ * - returns the number of frames, zero when it is not used
+ */
+size_t SNAPPYMT_GetTreeHashCCtx(SNAPPYMT_CCtx * ctx, unsigned long long *root);
+
+/**
+ * 3e) the first frame, which failed its round trip
+ * - returns its number, counted from one, or zero
+ * - offset gets the offset of its chunk in the input, it may be zero
+ */
+size_t SNAPPYMT_GetErrorFrameCCtx(SNAPPYMT_CCtx * ctx, unsigned long long *offset);
+
+/**
+ * 3a) latency of the written frames in microseconds
+ * - time from the arrival of the first input byte of a frame,
+ *   until the frame was given to fn_write
+ */
+size_t SNAPPYMT_GetLatencyMaxCCtx(SNAPPYMT_CCtx * ctx);
+size_t SNAPPYMT_GetLatencyAvgCCtx(SNAPPYMT_CCtx * ctx);
+
 /**
  * 4) free cctx
  * - no special return value
@@ -120,6 +327,80 @@ typedef struct SNAPPYMT_DCtx_s SNAPPYMT_DCtx;
  */
 SNAPPYMT_DCtx *SNAPPYMT_createDCtx(int threads, int inputsize);
 
+/**
+ * 1b) optional: run within a shared pool (see pool-mt.h)
+ * - same as SNAPPYMT_SetPoolCCtx()
+ */
+size_t SNAPPYMT_SetPoolDCtx(SNAPPYMT_DCtx * ctx, POOLMT_Pool * pool, int weight);
+
+/**
+ * 1c) optional: filter the decoded frames
+ * - fn is called for each decoded output buffer, before it goes to
+ *   fn_write, within the workers, so in parallel and in any order
+ * - it may change the buffer in place and shrink out->size, e.g. to
+ *   keep only the lines, which match some pattern (see --grep)
+ * - returns zero on success, or a negative value like fn_write
+ * - with deduplication, it runs while writing in the order of frames
+ * - fn zero disables it (default)
+ */
+size_t SNAPPYMT_SetFilterDCtx(SNAPPYMT_DCtx * ctx, fnFilter * fn, void *arg);
+
+/**
+ * 1d) optional: skip the frames, which can not contain the pattern
+ * - uses the bloom filters of the frames (see SNAPPYMT_SetBloomCCtx)
+ * - a frame is skipped only, when it and the frame before it end with
+ *   a newline, so the lines of the other frames stay complete
+ * - pattern is kept by pointer, len zero disables it (default)
+ * - no frames are skipped in a deduplicated stream
+ */
+size_t SNAPPYMT_SetBloomDCtx(SNAPPYMT_DCtx * ctx, const void *pattern, int len);
+
+/**
+ * 1e) optional: unordered writing
+ * - fn is called for each frame, as soon as it is decoded and filtered,
+ *   with its number and its offset in the uncompressed output (before
+ *   the filter), fn_write is not used then
+ * - the offset is -1 from the first frame on, whose size is not known
+ *   before decoding it (a broken length in front of the data)
+ * - with SetRangeDCtx() the offsets count from the start of the range
+ * - it runs within the workers, without a lock, so it must be thread
+ *   safe, with deduplication the frames come in order, their offsets
+ *   are always known
+ * - fn zero disables it (default)
+ */
+size_t SNAPPYMT_SetUnorderedDCtx(SNAPPYMT_DCtx * ctx, fnWriteFrame * fn, void *arg);
+
+/**
+ * 1f) optional: decompress a byte range of the input
+ * - only the frames, whose headers begin within [start, end), are
+ *   decompressed, the last one is read up to its end
+ * - fn_read must begin at offset start of the input (seek there), the
+ *   first frame header is searched by its skippable and codec magic
+ * - end zero: up to the end of the input, start and end zero disable
+ *   it (default)
+ * - not for deduplicated streams, the references need earlier frames
+ */
+size_t SNAPPYMT_SetRangeDCtx(SNAPPYMT_DCtx * ctx, unsigned long long start,
+			  unsigned long long end);
+
+/**
+ * 1g) optional: verification only
+ * - the frames are decoded and checked (the checksums of the codec and
+ *   of the frame headers), then the output is dropped, fn_write is not
+ *   used and the frames are not put in order
+ * - replaces the unordered writing (1e), the filter still runs
+ * - enable zero disables it (default)
+ */
+size_t SNAPPYMT_SetVerifyDCtx(SNAPPYMT_DCtx * ctx, int enable);
+
+/**
+ * 1h) optional: tree hash of the output (see SNAPPYMT_SetTreeHashCCtx)
+ * - the workers hash the decoded frames, the root is compared with the
+ *   one of the trailer frame, a wrong one gives SNAPPYMT_error_tree_wrong
+ * - not for byte ranges and skipped frames, they have only a part
+ */
+size_t SNAPPYMT_SetTreeHashDCtx(SNAPPYMT_DCtx * ctx, int enable);
+
 /**
  * 2) threaded compression
  * - return -1 on error
@@ -133,12 +414,47 @@ size_t SNAPPYMT_GetFramesDCtx(SNAPPYMT_DCtx * ctx);
 size_t SNAPPYMT_GetInsizeDCtx(SNAPPYMT_DCtx * ctx);
 size_t SNAPPYMT_GetOutsizeDCtx(SNAPPYMT_DCtx * ctx);
 
+/**
+ * 3b) the first frame with a wrong checksum (see SNAPPYMT_SetChecksumCCtx)
+ *   or one, which could not be decoded
+ * - returns its number, counted from one, and gives its offset in the
+ *   compressed input, zero when all frames were right
+ * - offset may be zero
+ */
+size_t SNAPPYMT_GetErrorFrameDCtx(SNAPPYMT_DCtx * ctx, unsigned long long *offset);
+
+/**
+ * 3c) root of the tree hash of the decoded frames
+ * - returns the number of frames, zero when it is not used
+ */
+size_t SNAPPYMT_GetTreeHashDCtx(SNAPPYMT_DCtx * ctx, unsigned long long *root);
+
 /**
  * 4) free cctx
  * - no special return value
  */
 void SNAPPYMT_freeDCtx(SNAPPYMT_DCtx * ctx);
 
+/**
+ * 5) list the frames of a stream, without decompressing them
+ * - src: the first bytes of a frame, SNAPPYMT_INFO_PEEK or the rest of
+ *   the input, when it is shorter
+ * - *csize gets the bytes of the whole frame (the next one begins
+ *   behind it) and *usize its uncompressed size, or -1 when the frame
+ *   does not tell it, so it must be decoded to know it
+ * - returns the kind of frame (SNAPPYMT_INFO_xxx) or an error code, when
+ *   src is no frame of the multi-threaded format
+ */
+#define SNAPPYMT_INFO_PEEK    96
+#define SNAPPYMT_INFO_DATA     0	/* compressed data */
+#define SNAPPYMT_INFO_BLOOM    1	/* bloom filter */
+#define SNAPPYMT_INFO_WINDOW   2	/* window of the deduplication */
+#define SNAPPYMT_INFO_REF      3	/* reference of the deduplication */
+#define SNAPPYMT_INFO_SKIP     4	/* other skippable frame */
+#define SNAPPYMT_INFO_TREE     5	/* root of the tree hash */
+size_t SNAPPYMT_GetFrameInfo(const void *src, size_t size,
+			     unsigned long long *csize, unsigned long long *usize);
+
 #if defined (__cplusplus)
 }
 #endif
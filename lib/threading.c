@@ -13,6 +13,7 @@
 
 /**
  * This file will hold wrapper for systems, which do not support Pthreads
+ * and some small helpers, which differ between the platforms
  */
 
 #ifdef _WIN32
@@ -70,4 +71,246 @@ int _pthread_join(pthread_t * thread, void **value_ptr)
 	}
 }
 
+unsigned long long mt_time_us(void)
+{
+	static LARGE_INTEGER freq;
+	LARGE_INTEGER now;
+
+	if (!freq.QuadPart)
+		QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+
+	return (unsigned long long)(now.QuadPart / freq.QuadPart) * 1000000 +
+	    (unsigned long long)(now.QuadPart % freq.QuadPart) * 1000000 /
+	    freq.QuadPart;
+}
+
+/* no topology support for windows yet */
+int mt_placement(int worker, int *cpu, int *node)
+{
+	(void)worker;
+	*cpu = -1;
+	*node = 0;
+	return -1;
+}
+
+int mt_pin(int cpu)
+{
+	(void)cpu;
+	return -1;
+}
+
+#else
+
+/* POSIX Systems */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "threading.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
+
+unsigned long long mt_time_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * topology, sorted in the order of placement:
+ * first smt level, then core within the node, then node
+ */
+#define MT_CPU_MAX 1024
+
+struct mt_cpu {
+	int cpu;
+	int node;
+	int core;
+	int smt;
+};
+
+static struct mt_cpu topo[MT_CPU_MAX];
+static int topo_count;
+static pthread_once_t topo_once = PTHREAD_ONCE_INIT;
+
+static int topo_cmp(const void *a, const void *b)
+{
+	const struct mt_cpu *x = (const struct mt_cpu *)a;
+	const struct mt_cpu *y = (const struct mt_cpu *)b;
+
+	if (x->smt != y->smt)
+		return x->smt - y->smt;
+	if (x->core != y->core)
+		return x->core - y->core;
+	if (x->node != y->node)
+		return x->node - y->node;
+	return x->cpu - y->cpu;
+}
+
+/* simulated topology, "NODESxCORESxSMT", numbered like linux does it */
+static void topo_simulate(const char *spec)
+{
+	int nodes, cores, smt, n, c, s;
+
+	if (sscanf(spec, "%dx%dx%d", &nodes, &cores, &smt) != 3)
+		return;
+	if (nodes < 1 || cores < 1 || smt < 1 ||
+	    nodes * cores * smt > MT_CPU_MAX)
+		return;
+
+	for (s = 0; s < smt; s++)
+		for (n = 0; n < nodes; n++)
+			for (c = 0; c < cores; c++) {
+				struct mt_cpu *p = &topo[topo_count++];
+				p->cpu = (s * nodes + n) * cores + c;
+				p->node = n;
+				p->core = c;
+				p->smt = s;
+			}
+}
+
+#ifdef __linux__
+static int topo_value(int cpu, const char *file)
+{
+	char path[128];
+	FILE *f;
+	int v = -1;
+
+	snprintf(path, sizeof(path),
+		 "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, file);
+	f = fopen(path, "r");
+	if (!f)
+		return -1;
+	if (fscanf(f, "%d", &v) != 1)
+		v = -1;
+	fclose(f);
+
+	return v;
+}
+
+static int topo_node(int cpu)
+{
+	char path[128];
+	struct dirent *d;
+	DIR *dir;
+	int node = 0;
+
+	snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+	dir = opendir(path);
+	if (!dir)
+		return 0;
+	while ((d = readdir(dir)) != 0) {
+		if (strncmp(d->d_name, "node", 4) == 0 &&
+		    sscanf(d->d_name + 4, "%d", &node) == 1)
+			break;
+	}
+	closedir(dir);
+
+	return node;
+}
+
+/* real topology of the cpus, which are usable for us */
+static void topo_linux(void)
+{
+	int pkg[MT_CPU_MAX], id[MT_CPU_MAX];
+	cpu_set_t set;
+	int cpu, i;
+
+	if (sched_getaffinity(0, sizeof(set), &set) != 0)
+		return;
+
+	for (cpu = 0; cpu < CPU_SETSIZE && topo_count < MT_CPU_MAX; cpu++) {
+		struct mt_cpu *p = &topo[topo_count];
+
+		if (!CPU_ISSET(cpu, &set))
+			continue;
+
+		p->cpu = cpu;
+		p->node = topo_node(cpu);
+		p->core = 0;
+		p->smt = 0;
+		pkg[topo_count] = topo_value(cpu, "physical_package_id");
+		id[topo_count] = topo_value(cpu, "core_id");
+
+		/* siblings share package and core id, cores are ranked per node */
+		for (i = 0; i < topo_count; i++) {
+			if (pkg[i] >= 0 && id[i] >= 0 &&
+			    pkg[i] == pkg[topo_count] &&
+			    id[i] == id[topo_count]) {
+				p->core = topo[i].core;
+				p->smt++;
+			} else if (topo[i].smt == 0 && topo[i].node == p->node &&
+				   p->smt == 0) {
+				p->core++;
+			}
+		}
+		topo_count++;
+	}
+}
+#endif
+
+static void topo_init(void)
+{
+	const char *spec = getenv("ZSTDMT_TOPOLOGY");
+
+	if (spec)
+		topo_simulate(spec);
+#ifdef __linux__
+	else
+		topo_linux();
+#endif
+
+	qsort(topo, topo_count, sizeof(struct mt_cpu), topo_cmp);
+}
+
+int mt_placement(int worker, int *cpu, int *node)
+{
+	struct mt_cpu *p;
+
+	pthread_once(&topo_once, topo_init);
+	if (topo_count == 0 || worker < 0) {
+		*cpu = -1;
+		*node = 0;
+		return -1;
+	}
+
+	p = &topo[worker % topo_count];
+	*cpu = p->cpu;
+	*node = p->node % MT_NODE_MAX;
+
+	return 0;
+}
+
+int mt_pin(int cpu)
+{
+#ifdef __linux__
+	cpu_set_t set;
+
+	if (cpu < 0 || cpu >= CPU_SETSIZE)
+		return -1;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (sched_setaffinity(0, sizeof(set), &set) != 0)
+		return -1;
+
+	return 0;
+#else
+	(void)cpu;
+	return -1;
+#endif
+}
+
 #endif
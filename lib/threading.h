@@ -37,6 +37,14 @@ extern "C" {
 #define pthread_mutex_lock        EnterCriticalSection
 #define pthread_mutex_unlock      LeaveCriticalSection
 
+/* condition variables, needs Windows Vista or newer */
+#define pthread_cond_t CONDITION_VARIABLE
+#define pthread_cond_init(a,b)    InitializeConditionVariable((a))
+#define pthread_cond_destroy(a)   do {} while (0)
+#define pthread_cond_wait(a,b)    SleepConditionVariableCS((a),(b),INFINITE)
+#define pthread_cond_signal       WakeConditionVariable
+#define pthread_cond_broadcast    WakeAllConditionVariable
+
 /* pthread_create() and pthread_join() */
 typedef struct {
 	HANDLE handle;
@@ -61,6 +69,44 @@ extern int _pthread_join(pthread_t * thread, void **value_ptr);
 
 #endif /* POSIX Systems */
 
+/**
+ * mt_time_us() - monotonic clock in microseconds
+ *
+ * Used for latency statistics of the worker threads, the absolute
+ * value has no meaning.
+ */
+extern unsigned long long mt_time_us(void);
+
+/**
+ * placement of the worker threads, for MT_AFFINITY_SPREAD (pool-mt.h)
+ *
+ * The workers go round-robin over the physical cores of all numa nodes,
+ * the SMT siblings are used after all physical cores are taken.
+ *
+ * The topology is read from /sys on Linux. For testing, some topology
+ * can be simulated via the environment, e.g. ZSTDMT_TOPOLOGY=2x4x2 is
+ * two nodes with four cores each and two threads per core. Cpus, which
+ * are not usable for us, are not pinned, but keep their node.
+ */
+
+/* max numa nodes, where per node lists are kept */
+#define MT_NODE_MAX 8
+
+/**
+ * mt_placement() - cpu and node of some worker
+ *
+ * Returns zero on success and -1, when the topology is unknown. The
+ * node is in the range 0 .. MT_NODE_MAX-1.
+ */
+extern int mt_placement(int worker, int *cpu, int *node);
+
+/**
+ * mt_pin() - pin the calling thread to one cpu
+ *
+ * Returns zero on success and -1 on error.
+ */
+extern int mt_pin(int cpu);
+
 #if defined (__cplusplus)
 }
 #endif
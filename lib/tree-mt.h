@@ -0,0 +1,176 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef TREEMT_H
+#define TREEMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "memmt.h"
+#include "xxhash-mt.h"
+
+/**
+ * tree hash of the uncompressed stream
+ *
+ * - each worker hashes the chunk of its frame with 128 bit (two xxHash64
+ *   with the seeds of the deduplication), while it is in the cache
+ * - the hashes of the frames are the leaves of a binary tree in the order
+ *   of the frames, two neighbours give the hash of their parent, an odd
+ *   one at the end goes up unchanged, the hash on top is the root
+ * - the parents are hashed with other seeds, so a leaf is never taken
+ *   for a parent
+ * - the root can be written as a skippable trailer frame, behind the
+ *   last data frame:
+ *
+ *   0x184D2A5E, LE32 24, LE64 frames, LE64 root[0], LE64 root[1]
+ *
+ * - this finds damaged or reordered data, like a checksum, but it is no
+ *   cryptographic hash
+ */
+
+#define MT_TREE_MAGIC      0x184D2A5EU
+#define MT_TREE_SIZE       24
+#define MT_TREE_FRAMESIZE  (8 + MT_TREE_SIZE)
+
+/* the seeds of the parents */
+#define MT_TREE_SEED1      1
+#define MT_TREE_SEED2      2
+
+typedef struct {
+	U64 (*leaf)[2];
+	size_t count;		/* frames, the highest index plus one */
+	size_t allocated;
+} MT_Tree;
+
+MEM_STATIC void MT_tree_init(MT_Tree * t)
+{
+	t->leaf = 0;
+	t->count = 0;
+	t->allocated = 0;
+}
+
+MEM_STATIC void MT_tree_free(MT_Tree * t)
+{
+	free(t->leaf);
+	MT_tree_init(t);
+}
+
+MEM_STATIC void MT_tree_leaf(const void *src, size_t size, U64 hash[2])
+{
+	hash[0] = MT_XXH64(src, size, 0);
+	hash[1] = MT_XXH64(src, size, MT_PRIME64_1);
+}
+
+/**
+ * put the leaf of the frame with the given index
+ * - the frames may come in any order, returns nonzero without memory
+ */
+MEM_STATIC int MT_tree_set(MT_Tree * t, size_t index, const U64 hash[2])
+{
+	if (index >= t->allocated) {
+		size_t n = t->allocated ? t->allocated : 256;
+		void *p;
+
+		while (n <= index)
+			n *= 2;
+		p = realloc(t->leaf, n * sizeof(*t->leaf));
+		if (!p)
+			return -1;
+		t->leaf = (U64(*)[2]) p;
+		t->allocated = n;
+	}
+	if (index >= t->count)
+		t->count = index + 1;
+	t->leaf[index][0] = hash[0];
+	t->leaf[index][1] = hash[1];
+
+	return 0;
+}
+
+/**
+ * hash the tree up to its root
+ * - the leaves are overwritten, so it is done once at the end
+ * - empty input has no leaves, also when it was written as one empty
+ *   frame, which some decoders take as the end of the stream
+ */
+MEM_STATIC void MT_tree_root(MT_Tree * t, U64 root[2])
+{
+	size_t n = t->count, i;
+	BYTE buf[32];
+
+	MT_tree_leaf("", 0, root);
+	if (n == 1 && t->leaf[0][0] == root[0] && t->leaf[0][1] == root[1])
+		t->count = n = 0;
+	if (n == 0)
+		return;
+
+	while (n > 1) {
+		for (i = 0; i + 1 < n; i += 2) {
+			MEM_writeLE64(buf + 0, t->leaf[i][0]);
+			MEM_writeLE64(buf + 8, t->leaf[i][1]);
+			MEM_writeLE64(buf + 16, t->leaf[i + 1][0]);
+			MEM_writeLE64(buf + 24, t->leaf[i + 1][1]);
+			t->leaf[i / 2][0] = MT_XXH64(buf, 32, MT_TREE_SEED1);
+			t->leaf[i / 2][1] = MT_XXH64(buf, 32, MT_TREE_SEED2);
+		}
+		if (n & 1) {
+			t->leaf[n / 2][0] = t->leaf[n - 1][0];
+			t->leaf[n / 2][1] = t->leaf[n - 1][1];
+		}
+		n = (n + 1) / 2;
+	}
+
+	root[0] = t->leaf[0][0];
+	root[1] = t->leaf[0][1];
+}
+
+/**
+ * write the trailer frame to dst, which needs MT_TREE_FRAMESIZE bytes
+ */
+MEM_STATIC size_t MT_tree_frame(void *dst, U64 frames, const U64 root[2])
+{
+	BYTE *d = (BYTE *) dst;
+
+	MEM_writeLE32(d + 0, MT_TREE_MAGIC);
+	MEM_writeLE32(d + 4, MT_TREE_SIZE);
+	MEM_writeLE64(d + 8, frames);
+	MEM_writeLE64(d + 16, root[0]);
+	MEM_writeLE64(d + 24, root[1]);
+
+	return MT_TREE_FRAMESIZE;
+}
+
+/**
+ * read the trailer frame, src has MT_TREE_SIZE bytes behind the magic
+ * and the size, returns nonzero when the frames do not fit into size_t
+ */
+MEM_STATIC int MT_tree_read(const void *src, U64 * frames, U64 root[2])
+{
+	const BYTE *s = (const BYTE *)src;
+
+	*frames = MEM_readLE64(s + 0);
+	root[0] = MEM_readLE64(s + 8);
+	root[1] = MEM_readLE64(s + 16);
+
+	return (U64) (size_t)*frames != *frames;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* TREEMT_H */
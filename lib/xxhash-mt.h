@@ -0,0 +1,184 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef XXHASHMT_H
+#define XXHASHMT_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "memmt.h"
+
+/**
+ * xxHash32 - the checksum of the lz4 frame format
+ * xxHash64 - the checksum of the zstd frame format
+ *
+ * - the codec libraries keep their copy of xxhash internal, so the
+ *   frames, which are written by us, need their own one
+ * - this is the plain scalar version of the reference implementation
+ */
+
+#define MT_PRIME32_1 2654435761U
+#define MT_PRIME32_2 2246822519U
+#define MT_PRIME32_3 3266489917U
+#define MT_PRIME32_4  668265263U
+#define MT_PRIME32_5  374761393U
+
+#define MT_rotl32(x, r) (((x) << (r)) | ((x) >> (32 - (r))))
+
+MEM_STATIC U32 MT_XXH32_round(U32 acc, U32 input)
+{
+	acc += input * MT_PRIME32_2;
+	acc = MT_rotl32(acc, 13);
+	acc *= MT_PRIME32_1;
+	return acc;
+}
+
+MEM_STATIC U32 MT_XXH32(const void *input, size_t len, U32 seed)
+{
+	const BYTE *p = (const BYTE *)input;
+	const BYTE *end = p + len;
+	U32 h32;
+
+	if (len >= 16) {
+		const BYTE *limit = end - 16;
+		U32 v1 = seed + MT_PRIME32_1 + MT_PRIME32_2;
+		U32 v2 = seed + MT_PRIME32_2;
+		U32 v3 = seed + 0;
+		U32 v4 = seed - MT_PRIME32_1;
+
+		do {
+			v1 = MT_XXH32_round(v1, MEM_readLE32(p));
+			v2 = MT_XXH32_round(v2, MEM_readLE32(p + 4));
+			v3 = MT_XXH32_round(v3, MEM_readLE32(p + 8));
+			v4 = MT_XXH32_round(v4, MEM_readLE32(p + 12));
+			p += 16;
+		} while (p <= limit);
+
+		h32 = MT_rotl32(v1, 1) + MT_rotl32(v2, 7) +
+		    MT_rotl32(v3, 12) + MT_rotl32(v4, 18);
+	} else {
+		h32 = seed + MT_PRIME32_5;
+	}
+
+	h32 += (U32)len;
+
+	while (p + 4 <= end) {
+		h32 += MEM_readLE32(p) * MT_PRIME32_3;
+		h32 = MT_rotl32(h32, 17) * MT_PRIME32_4;
+		p += 4;
+	}
+
+	while (p < end) {
+		h32 += (*p) * MT_PRIME32_5;
+		h32 = MT_rotl32(h32, 11) * MT_PRIME32_1;
+		p++;
+	}
+
+	h32 ^= h32 >> 15;
+	h32 *= MT_PRIME32_2;
+	h32 ^= h32 >> 13;
+	h32 *= MT_PRIME32_3;
+	h32 ^= h32 >> 16;
+
+	return h32;
+}
+
+#define MT_PRIME64_1 11400714785074694791ULL
+#define MT_PRIME64_2 14029467366897019727ULL
+#define MT_PRIME64_3  1609587929392839161ULL
+#define MT_PRIME64_4  9650029242287828579ULL
+#define MT_PRIME64_5  2870177450012600261ULL
+
+#define MT_rotl64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+MEM_STATIC U64 MT_XXH64_round(U64 acc, U64 input)
+{
+	acc += input * MT_PRIME64_2;
+	acc = MT_rotl64(acc, 31);
+	acc *= MT_PRIME64_1;
+	return acc;
+}
+
+MEM_STATIC U64 MT_XXH64_merge(U64 acc, U64 val)
+{
+	acc ^= MT_XXH64_round(0, val);
+	acc = acc * MT_PRIME64_1 + MT_PRIME64_4;
+	return acc;
+}
+
+MEM_STATIC U64 MT_XXH64(const void *input, size_t len, U64 seed)
+{
+	const BYTE *p = (const BYTE *)input;
+	const BYTE *end = p + len;
+	U64 h64;
+
+	if (len >= 32) {
+		const BYTE *limit = end - 32;
+		U64 v1 = seed + MT_PRIME64_1 + MT_PRIME64_2;
+		U64 v2 = seed + MT_PRIME64_2;
+		U64 v3 = seed + 0;
+		U64 v4 = seed - MT_PRIME64_1;
+
+		do {
+			v1 = MT_XXH64_round(v1, MEM_readLE64(p));
+			v2 = MT_XXH64_round(v2, MEM_readLE64(p + 8));
+			v3 = MT_XXH64_round(v3, MEM_readLE64(p + 16));
+			v4 = MT_XXH64_round(v4, MEM_readLE64(p + 24));
+			p += 32;
+		} while (p <= limit);
+
+		h64 = MT_rotl64(v1, 1) + MT_rotl64(v2, 7) +
+		    MT_rotl64(v3, 12) + MT_rotl64(v4, 18);
+		h64 = MT_XXH64_merge(h64, v1);
+		h64 = MT_XXH64_merge(h64, v2);
+		h64 = MT_XXH64_merge(h64, v3);
+		h64 = MT_XXH64_merge(h64, v4);
+	} else {
+		h64 = seed + MT_PRIME64_5;
+	}
+
+	h64 += (U64)len;
+
+	while (p + 8 <= end) {
+		h64 ^= MT_XXH64_round(0, MEM_readLE64(p));
+		h64 = MT_rotl64(h64, 27) * MT_PRIME64_1 + MT_PRIME64_4;
+		p += 8;
+	}
+
+	if (p + 4 <= end) {
+		h64 ^= (U64)MEM_readLE32(p) * MT_PRIME64_1;
+		h64 = MT_rotl64(h64, 23) * MT_PRIME64_2 + MT_PRIME64_3;
+		p += 4;
+	}
+
+	while (p < end) {
+		h64 ^= (*p) * MT_PRIME64_5;
+		h64 = MT_rotl64(h64, 11) * MT_PRIME64_1;
+		p++;
+	}
+
+	h64 ^= h64 >> 33;
+	h64 *= MT_PRIME64_2;
+	h64 ^= h64 >> 29;
+	h64 *= MT_PRIME64_3;
+	h64 ^= h64 >> 32;
+
+	return h64;
+}
+
+#if defined (__cplusplus)
+}
+#endif
+#endif				/* XXHASHMT_H */
@@ -24,6 +24,8 @@ extern "C" {
 
 #include <stddef.h>   /* size_t */
 
+#include "pool-mt.h"
+
 #define ZSTDCB_THREAD_MAX 128
 #define ZSTDCB_LEVEL_MIN    1
 #define ZSTDCB_LEVEL_MAX   22
@@ -50,6 +52,9 @@ typedef enum {
   ZSTDCB_error_compressionParameter_unsupported,
   ZSTDCB_error_compression_library,
   ZSTDCB_error_canceled,
+  ZSTDCB_error_checksum_wrong,
+  ZSTDCB_error_verify_failed,
+  ZSTDCB_error_tree_wrong,
   ZSTDCB_error_maxCode
 } ZSTDCB_ErrorCode;
 
@@ -81,9 +86,15 @@ typedef struct {
  * -1 = generic read/write error
  * -2 = user abort
  * -3 = memory
+ *  1 = no input available yet, only used by fn_read in combination
+ *      with ZSTDCB_SetMaxLatencyCCtx(), where fn_read may also return
+ *      less bytes than requested (zero bytes are still eof)
  */
 typedef int (fn_read) (void *args, ZSTDCB_Buffer * in);
 typedef int (fn_write) (void *args, ZSTDCB_Buffer * out);
+typedef int (fn_filter) (void *args, ZSTDCB_Buffer * out);
+typedef int (fn_write_frame) (void *args, ZSTDCB_Buffer * out, size_t frame,
+			   unsigned long long offset);
 
 typedef struct {
 	fn_read *fn_read;
@@ -114,6 +125,253 @@ typedef struct ZSTDCB_CCtx_s ZSTDCB_CCtx;
  */
 ZSTDCB_CCtx *ZSTDCB_createCCtx(int threads, int level, int inputsize);
 
+/**
+ * ZSTDCB_SetMaxLatencyCCtx() - max latency for streaming input
+ *
+ * When set, a partially filled input chunk is compressed and written
+ * as a short frame, when its first byte waits longer than msec. This is
+ * useful for log streams, where the input comes in slowly.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @msec: max latency in milliseconds, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetMaxLatencyCCtx(ZSTDCB_CCtx * ctx, int msec);
+
+/**
+ * ZSTDCB_SetPoolCCtx() - run the workers within a shared pool
+ *
+ * The threads of the context are not started anymore, each of its
+ * workers runs as a job of the pool instead (see pool-mt.h). So the
+ * threads value of the context is the max number of frames, which are
+ * compressed in parallel.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @pool: the pool, or zero for using own threads again
+ * @weight: share within the pool (1..POOLMT_WEIGHT_MAX)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetPoolCCtx(ZSTDCB_CCtx * ctx, POOLMT_Pool * pool, int weight);
+
+/**
+ * ZSTDCB_SetAffinityCCtx() - placement of the worker threads
+ *
+ * With MT_AFFINITY_SPREAD, the workers are pinned round-robin over the
+ * physical cores of all numa nodes, before SMT siblings are used (see
+ * pool-mt.h). The output buffers are then reused per node and the
+ * input buffers are touched first by their worker. This has no effect,
+ * when the context runs within a shared pool.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @policy: MT_AFFINITY_NONE (default) or MT_AFFINITY_SPREAD
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetAffinityCCtx(ZSTDCB_CCtx * ctx, int policy);
+
+/**
+ * ZSTDCB_SetAdaptiveCCtx() - park and unpark workers, as needed
+ *
+ * The workers measure the time for compressing and for waiting on the
+ * input and output. Every 100ms one worker is parked, when they wait
+ * most of the time, or unparked, when they compress most of the time.
+ * So between minthreads and the threads of the context are active. The
+ * decisions can be read via ZSTDCB_GetStatsCCtx(). This has no effect,
+ * when the context runs within a shared pool.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @minthreads: min active workers, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetAdaptiveCCtx(ZSTDCB_CCtx * ctx, int minthreads);
+
+/**
+ * ZSTDCB_SetLevelRangeCCtx() - adapt the level to the output
+ *
+ * Each frame is independent, so its level can be chosen, when it is
+ * started. When the workers wait more than 1/4 of the time for writing,
+ * or frames pile up in the reorder queue, the output is too slow and
+ * the level goes up. When they mostly compress and the writer is idle,
+ * the level goes down. One step is done every 100ms, starting with the
+ * level of the context. The written frames per level can be read via
+ * ZSTDCB_GetStatsCCtx().
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @minlevel: lowest level (ZSTDCB_LEVEL_MIN..maxlevel)
+ * @maxlevel: highest level (minlevel..ZSTDCB_LEVEL_MAX)
+ * @return: zero on success, or error code
+ *
+ * Both values zero disables it (default).
+ */
+size_t ZSTDCB_SetLevelRangeCCtx(ZSTDCB_CCtx * ctx, int minlevel,
+				 int maxlevel);
+
+/**
+ * ZSTDCB_SetChunkingCCtx() - content defined chunking (FastCDC)
+ *
+ * The frame boundaries are found by a rolling hash over the input, not
+ * by a fixed input size. So unchanged regions of a file give the same
+ * frames again, also when some bytes were inserted or removed before
+ * them. This helps deduplication and rsync on the compressed files.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @minsize: min frame size, zero for avgsize / 4
+ * @avgsize: wanted frame size, rounded down to a power of two, zero
+ *           disables the chunking (default)
+ * @maxsize: max frame size, zero for avgsize * 4, the input size of the
+ *           context becomes this value
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetChunkingCCtx(ZSTDCB_CCtx * ctx, int minsize, int avgsize,
+			      int maxsize);
+
+/**
+ * ZSTDCB_SetDelimiterCCtx() - record aware chunking
+ *
+ * The frames are cut only behind a delimiter, like a newline. So each
+ * frame gives whole records, and consumers like a parallel grep can
+ * process the frames on their own. The cut is the first delimiter
+ * behind the input size, or the last one before it. A record, which is
+ * longer than the tolerance, is cut anyway. This replaces the content
+ * defined chunking.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @delim: the delimiter, 1 .. 16 bytes
+ * @dlen: length of delim, zero disables it (default)
+ * @tolerance: 1 .. 99 percent of the input size, the max frame size is
+ *             the input size plus this, it becomes the input size of the
+ *             context then
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetDelimiterCCtx(ZSTDCB_CCtx * ctx, const void *delim,
+			       int dlen, int tolerance);
+
+/**
+ * ZSTDCB_SetBloomCCtx() - bloom filter of each frame
+ *
+ * A skippable frame with a bloom filter of all trigrams of the chunk is
+ * written in front of each data frame, see bloom-mt.h. Standard zstd
+ * just skips it. A search for some pattern can skip all frames, which
+ * can not contain it (ZSTDCB_SetBloomDCtx). This works best together
+ * with the record aware chunking.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @size: bytes of each filter, rounded down to a power of two, 64 up to
+ *        1 MiB, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetBloomCCtx(ZSTDCB_CCtx * ctx, int size);
+
+/**
+ * ZSTDCB_SetUnorderedCCtx() - write the frames as they are done
+ *
+ * Consumers like hashing or indexing do not need the frames in order.
+ * With this, each worker calls fn for its frame, as soon as it is
+ * compressed, with the frame number and the offset of its input. So a
+ * slow frame does not stall the output of the others. The calls are
+ * done without a lock, fn must be thread safe. The fn_write of the
+ * context gets only the window frame of a deduplicated stream, bloom
+ * frames are not written in this mode.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @fn: the writer, or zero for ordered writing by fn_write (default)
+ * @arg: first argument of fn
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetUnorderedCCtx(ZSTDCB_CCtx * ctx, fn_write_frame * fn,
+			       void *arg);
+
+/**
+ * ZSTDCB_SetHeaderCCtx() - select the version of the frame headers
+ *
+ * Version 1 is the 12 byte skippable frame with the 32 bit compressed
+ * size. Version 2 has 32 bytes with the 64 bit compressed and
+ * uncompressed size and a checksum of the header, see frame-mt.h. With
+ * it, the decompressors allocate the exact output, and the offsets and
+ * sizes of all frames can be read without decoding. Standard zstd
+ * skips both versions, the decompressors read both.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @version: 1 (default) or 2
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetHeaderCCtx(ZSTDCB_CCtx * ctx, int version);
+
+/**
+ * ZSTDCB_SetChecksumCCtx() - store a checksum of each frame
+ *
+ * The zstd frames are written without their own checksum. With this,
+ * each worker stores the xxHash64 of the uncompressed data of its frame
+ * in the version 2 header, which is selected by it (version 1 has no
+ * field for it). The decompression workers check it in parallel, before
+ * the frame is written, a wrong one gives ZSTDCB_error_checksum_wrong.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @enable: nonzero for the checksum, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetChecksumCCtx(ZSTDCB_CCtx * ctx, int enable);
+
+/**
+ * ZSTDCB_SetTreeHashCCtx() - tree hash of the input (see tree-mt.h)
+ *
+ * Each worker hashes its chunk with 128 bit, while the chunk is still in
+ * the cache. The hashes are combined in the order of the frames to a
+ * root, so the input has a digest without a second pass over it.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @mode: 1 computes the root, 2 also writes it as trailer frame behind
+ *        the last frame, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetTreeHashCCtx(ZSTDCB_CCtx * ctx, int mode);
+
+/**
+ * ZSTDCB_SetVerifyCCtx() - round trip of each frame
+ *
+ * Each worker decodes its frame again and compares it with the chunk,
+ * before the frame goes to the writer. So the source can be removed
+ * afterwards without a test run over the output. A mismatch stops the
+ * other workers and gives ZSTDCB_error_verify_failed, the frame is told
+ * by ZSTDCB_GetErrorFrameCCtx().
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @enable: nonzero enables it, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetVerifyCCtx(ZSTDCB_CCtx * ctx, int enable);
+
+/**
+ * ZSTDCB_SetSourceCCtx() - read the input from memory
+ *
+ * The workers take their chunks straight from @src, like a mapped file,
+ * without copying them and without calling fn_read, which may be zero
+ * then. The memory must stay valid and unchanged until
+ * ZSTDCB_compressCCtx() returns, the max latency does not apply.
+ *
+ * @ctx: compression context, the setting is kept for later calls, each
+ *       one reads @src from the start
+ * @src: the whole input, zero goes back to fn_read (default)
+ * @size: bytes of @src
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetSourceCCtx(ZSTDCB_CCtx * ctx, const void *src, size_t size);
+
+/**
+ * ZSTDCB_SetDedupCCtx() - frame level deduplication
+ *
+ * Chunks, which were seen within the last window MiB of input, are not
+ * compressed again. A small skippable frame with a reference to the
+ * earlier data is written instead. This works best together with the
+ * content defined chunking. The stream can only be decompressed by the
+ * ZSTDCB_decompressDCtx() function, which needs window MiB of memory
+ * for it.
+ *
+ * @ctx: compression context, the setting is kept for later calls
+ * @window: window size in MiB, max is 4096, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetDedupCCtx(ZSTDCB_CCtx * ctx, int window);
+
 /**
  * ZSTDCB_compressDCtx() - threaded compression for zstd
  *
@@ -141,6 +399,89 @@ size_t ZSTDCB_GetFramesCCtx(ZSTDCB_CCtx * ctx);
 size_t ZSTDCB_GetInsizeCCtx(ZSTDCB_CCtx * ctx);
 size_t ZSTDCB_GetOutsizeCCtx(ZSTDCB_CCtx * ctx);
 
+/**
+ * ZSTDCB_GetTreeHashCCtx() - root of the tree hash
+ *
+ * @ctx: context, which should be examined
+ * @root: gets the two halves of the root of the last compression
+ * @return: number of frames, zero when it is not used, or error code
+ */
+size_t ZSTDCB_GetTreeHashCCtx(ZSTDCB_CCtx * ctx, unsigned long long *root);
+
+/**
+ * ZSTDCB_GetErrorFrameCCtx() - the first frame, which failed its round trip
+ *
+ * @ctx: context, which should be examined
+ * @offset: gets the offset of the chunk in the input, or zero
+ * @return: number of the frame, counted from one, or zero when all
+ *          frames were right
+ */
+size_t ZSTDCB_GetErrorFrameCCtx(ZSTDCB_CCtx * ctx, unsigned long long *offset);
+
+/**
+ * ZSTDCB_GetMemoryCCtx() - estimated memory usage of the workers
+ *
+ * The value is the sum of the input and output buffers and the zstd
+ * compression contexts of all threads and the table of the deduplication,
+ * in bytes. It can be used before compressing, for checking some memory
+ * limit. It depends on the other settings, so call it after all setters.
+ *
+ * @ctx: context, which should be examined
+ * @return: the estimated bytes, or error code
+ */
+size_t ZSTDCB_GetMemoryCCtx(ZSTDCB_CCtx * ctx);
+
+/**
+ * struct ZSTDCB_Stats - thread statistic of the last compression
+ *
+ * @threads: max workers of the context
+ * @active: currently active workers, the others are parked
+ * @parked: number of decisions for parking a worker
+ * @unparked: number of decisions for unparking a worker
+ * @busy_us: time of all workers, spent in compression
+ * @read_us: time of all workers, spent in waiting for and reading input
+ * @write_us: time of all workers, spent in waiting for and writing output
+ * @stored: number of frames, which are stored as raw blocks
+ * @dedup: number of frames, which are references to earlier chunks
+ * @level: level for the next frame
+ * @levels: number of written frames per level
+ */
+typedef struct {
+	int threads;
+	int active;
+	size_t parked;
+	size_t unparked;
+	unsigned long long busy_us;
+	unsigned long long read_us;
+	unsigned long long write_us;
+	size_t stored;
+	size_t dedup;
+	int level;
+	size_t levels[ZSTDCB_LEVEL_MAX + 1];
+} ZSTDCB_Stats;
+
+/**
+ * ZSTDCB_GetStatsCCtx() - get the thread statistic
+ *
+ * @ctx: context, which should be examined
+ * @stats: gets the statistic, see struct ZSTDCB_Stats
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_GetStatsCCtx(ZSTDCB_CCtx * ctx, ZSTDCB_Stats * stats);
+
+/**
+ * ZSTDCB_GetLatencyMaxCCtx() - max latency of the written frames
+ * ZSTDCB_GetLatencyAvgCCtx() - average latency of the written frames
+ *
+ * The latency is the time in microseconds from the arrival of the
+ * first input byte of a frame, until the frame was given to fn_write.
+ *
+ * @ctx: context, which should be examined
+ * @return: the request value, or zero on error
+ */
+size_t ZSTDCB_GetLatencyMaxCCtx(ZSTDCB_CCtx * ctx);
+size_t ZSTDCB_GetLatencyAvgCCtx(ZSTDCB_CCtx * ctx);
+
 /**
  * ZSTDCB_freeCCtx() - free compression context
  *
@@ -168,6 +509,125 @@ typedef struct ZSTDCB_DCtx_s ZSTDCB_DCtx;
  */
 ZSTDCB_DCtx *ZSTDCB_createDCtx(int threads, int inputsize);
 
+/**
+ * ZSTDCB_SetPoolDCtx() - run the workers within a shared pool
+ *
+ * Same as ZSTDCB_SetPoolCCtx(), but for decompression. Single threaded
+ * streams are still decompressed by the calling thread.
+ *
+ * @ctx: decompression context, the setting is kept for later calls
+ * @pool: the pool, or zero for using own threads again
+ * @weight: share within the pool (1..POOLMT_WEIGHT_MAX)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetPoolDCtx(ZSTDCB_DCtx * ctx, POOLMT_Pool * pool, int weight);
+
+/**
+ * ZSTDCB_SetFilterDCtx() - filter the decoded frames
+ *
+ * The filter is called for each decoded output buffer, before it goes
+ * to fn_write. It runs within the workers, so the frames are filtered
+ * in parallel, but in any order. It may change the buffer in place and
+ * shrink out->size, like for writing only the lines, which match some
+ * pattern (see the --grep option of the programs). It should return
+ * zero on success, or a negative value like fn_write on error. With a
+ * deduplicated stream, it runs while writing, since the references
+ * need the decoded data. Single threaded streams are also given in
+ * parts of unknown size. The output statistic counts the filtered data.
+ *
+ * @ctx: decompression context, the setting is kept for later calls
+ * @fn: the filter, or zero for disabling it (default)
+ * @arg: first argument of fn
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetFilterDCtx(ZSTDCB_DCtx * ctx, fn_filter * fn, void *arg);
+
+/**
+ * ZSTDCB_SetBloomDCtx() - skip the frames without some pattern
+ *
+ * The bloom filters of the frames (ZSTDCB_SetBloomCCtx) are tested for
+ * all trigrams of the pattern. A frame, which can not contain it, is
+ * read but not decompressed. This is done only, when the frame and the
+ * one before it end with a newline, so the lines of the other frames
+ * stay complete. No frames are skipped in a deduplicated stream.
+ *
+ * @ctx: decompression context, the setting is kept for later calls
+ * @pattern: the pattern, it is kept by pointer
+ * @len: length of pattern, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetBloomDCtx(ZSTDCB_DCtx * ctx, const void *pattern, int len);
+
+/**
+ * ZSTDCB_SetUnorderedDCtx() - write the frames as they are done
+ *
+ * Each worker calls fn for its frame, as soon as it is decoded and
+ * filtered, with the frame number and its offset in the uncompressed
+ * output (before the filter). The offsets are taken from the frame
+ * sizes in the order of the input, so they are known before the earlier
+ * frames are done. From the first frame on, which does not tell its
+ * size (a zstd frame header without content size, all our frames have
+ * it), the offset is -1. With ZSTDCB_SetRangeDCtx() the offsets count
+ * from the start of the range. The calls are done without a lock, fn
+ * must be thread safe. A deduplicated stream is written in order, since
+ * the references need the earlier output, the offsets are always known
+ * then. Standard zstd streams without our frames go to fn_write.
+ *
+ * @ctx: decompression context, the setting is kept for later calls
+ * @fn: the writer, or zero for ordered writing by fn_write (default)
+ * @arg: first argument of fn
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetUnorderedDCtx(ZSTDCB_DCtx * ctx, fn_write_frame * fn,
+			       void *arg);
+
+/**
+ * ZSTDCB_SetRangeDCtx() - decompress a byte range of the input
+ *
+ * For splitting a file into parts, which are decompressed by different
+ * processes. Only the frames, whose headers begin within [start, end),
+ * are decompressed, the last one is read up to its end. The input of
+ * fn_read must begin at offset start, the first frame header in it is
+ * searched by the skippable magic and the zstd magic behind it. So the
+ * parts of one file get each frame exactly once. This does not work
+ * for deduplicated streams, since the references need earlier frames.
+ *
+ * @ctx: decompression context, the setting is kept for later calls
+ * @start: offset of the input, zero for the begin of the stream
+ * @end: end of the range, zero for the end of the input
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetRangeDCtx(ZSTDCB_DCtx * ctx, unsigned long long start,
+			   unsigned long long end);
+
+/**
+ * ZSTDCB_SetVerifyDCtx() - decode and check, but write nothing
+ *
+ * For testing the integrity of a stream (-t): the workers decode their
+ * frames, the zstd checksums and the checksums of the frame headers are
+ * checked, then the buffer is reused at once. fn_write is not called and
+ * the frames are not put in order. This replaces the unordered writing.
+ *
+ * @ctx: decompression context, the setting is kept for later calls
+ * @enable: nonzero for verification only, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetVerifyDCtx(ZSTDCB_DCtx * ctx, int enable);
+
+/**
+ * ZSTDCB_SetTreeHashDCtx() - tree hash of the output
+ *
+ * The workers hash the decoded frames like ZSTDCB_SetTreeHashCCtx(),
+ * when the stream has a trailer frame, its root is compared at the end
+ * and a wrong one gives ZSTDCB_error_tree_wrong. Byte ranges and
+ * skipped frames are not compared, they have only a part of the tree.
+ *
+ * @ctx: decompression context
+ * @enable: nonzero computes the root, zero disables it (default)
+ * @return: zero on success, or error code
+ */
+size_t ZSTDCB_SetTreeHashDCtx(ZSTDCB_DCtx * ctx, int enable);
+
 /**
  * ZSTDCB_decompressDCtx() - threaded decompression for zstd
  *
@@ -194,6 +654,29 @@ size_t ZSTDCB_GetFramesDCtx(ZSTDCB_DCtx * ctx);
 size_t ZSTDCB_GetInsizeDCtx(ZSTDCB_DCtx * ctx);
 size_t ZSTDCB_GetOutsizeDCtx(ZSTDCB_DCtx * ctx);
 
+/**
+ * ZSTDCB_GetErrorFrameDCtx() - the first corrupt frame
+ *
+ * After ZSTDCB_error_checksum_wrong or a frame, which could not be
+ * decoded (ZSTDCB_error_compression_library), this tells which frame
+ * it was.
+ *
+ * @ctx: context, which should be examined
+ * @offset: gets the offset of the frame in the compressed input, or zero
+ * @return: number of the frame, counted from one, or zero when all
+ *          frames were right
+ */
+size_t ZSTDCB_GetErrorFrameDCtx(ZSTDCB_DCtx * ctx, unsigned long long *offset);
+
+/**
+ * ZSTDCB_GetTreeHashDCtx() - root of the tree hash of the decoded frames
+ *
+ * @ctx: context, which should be examined
+ * @root: gets the two halves of the root
+ * @return: number of frames, zero when it is not used, or error code
+ */
+size_t ZSTDCB_GetTreeHashDCtx(ZSTDCB_DCtx * ctx, unsigned long long *root);
+
 /**
  * ZSTDCB_freeDCtx() - free decompression context
  *
@@ -204,6 +687,32 @@ size_t ZSTDCB_GetOutsizeDCtx(ZSTDCB_DCtx * ctx);
  */
 void ZSTDCB_freeDCtx(ZSTDCB_DCtx * ctx);
 
+#define ZSTDCB_INFO_PEEK    96
+#define ZSTDCB_INFO_DATA     0	/* compressed data */
+#define ZSTDCB_INFO_BLOOM    1	/* bloom filter */
+#define ZSTDCB_INFO_WINDOW   2	/* window of the deduplication */
+#define ZSTDCB_INFO_REF      3	/* reference of the deduplication */
+#define ZSTDCB_INFO_SKIP     4	/* other skippable frame */
+#define ZSTDCB_INFO_TREE     5	/* root of the tree hash */
+
+/**
+ * ZSTDCB_GetFrameInfo() - sizes of a frame, without decompressing it
+ *
+ * For listing a stream fast: the sizes are taken from the skippable
+ * header (version 2) or from the zstd frame header behind it, so the
+ * caller can seek over the data to the next frame. When the frame does
+ * not tell its uncompressed size, -1 is given and it must be decoded.
+ *
+ * @src: first bytes of a frame, ZSTDCB_INFO_PEEK or the rest of the input
+ * @size: bytes of src
+ * @csize: gets the bytes of the whole frame, with its headers
+ * @usize: gets the uncompressed size, or -1 when it is not known
+ * @return: kind of frame (ZSTDCB_INFO_xxx), or error code, when src is
+ *          no frame of the multi-threaded format
+ */
+size_t ZSTDCB_GetFrameInfo(const void *src, size_t size,
+			   unsigned long long *csize, unsigned long long *usize);
+
 #if defined (__cplusplus)
 }
 #endif
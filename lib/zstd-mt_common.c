@@ -55,6 +55,12 @@ const char *ZSTDCB_getErrorString(size_t code)
 		return "Compression parameter is out of bound";
 	case ZSTDCB_PREFIX(compression_library):
 		return "Compression library reports failure";
+	case ZSTDCB_PREFIX(checksum_wrong):
+		return "Checksum of a frame is wrong";
+	case ZSTDCB_PREFIX(verify_failed):
+		return "Round trip of a frame failed";
+	case ZSTDCB_PREFIX(tree_wrong):
+		return "Tree hash of the output is wrong";
 	case ZSTDCB_PREFIX(maxCode):
 	default:
 		return noErrorCode;
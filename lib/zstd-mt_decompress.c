@@ -18,8 +18,14 @@
 #include "zstd.h"
 
 #include "memmt.h"
+#include "dedup-mt.h"
+#include "bloom-mt.h"
+#include "frame-mt.h"
+#include "tree-mt.h"
+#include "range-mt.h"
 #include "threading.h"
 #include "list.h"
+#include "pool-mt.h"
 #include "zstd-mt.h"
 
 /**
@@ -32,6 +38,8 @@
  *   2) release read mutex and do decompression
  *   3) get write mutex and write result
  *   4) begin with step 1 again, until no input
+ * - one such round is done by pt_decompress_step(), so the workers can
+ *   also run as jobs of a shared pool (see pool-mt.h)
  */
 
 #if 0
@@ -49,11 +57,17 @@ typedef struct {
 	pthread_t pthread;
 	ZSTDCB_Buffer in;
 	ZSTD_DStream *dctx;
+	size_t result;
 } cwork_t;
 
 struct writelist;
 struct writelist {
 	size_t frame;
+	U64 ref[2];		/* distance and size of a reference frame */
+	U64 sum[2];		/* flag and value of the frame checksum */
+	U64 leaf[2];		/* hash of the output, see tree-mt.h */
+	U64 offset;		/* of the frame in the compressed input */
+	U64 outoffset;		/* of the frame in the uncompressed output */
 	ZSTDCB_Buffer out;
 	struct list_head node;
 };
@@ -70,12 +84,30 @@ struct ZSTDCB_DCtx_s {
 	/* buffersize used for output */
 	size_t outputsize;
 
+	/* shared pool, zero when not used */
+	POOLMT_Pool *pool;
+	int weight;
+
+	/* last output of a deduplicated stream, see dedup-mt.h */
+	MT_Ring ring;
+
 	/* statistic */
 	size_t insize;
 	size_t outsize;
 	size_t curframe;
 	size_t frames;
 
+	/* first frame with a wrong checksum, counted from one */
+	size_t errframe;
+	U64 erroffset;
+
+	/* tree hash of the output, see tree-mt.h */
+	int tree;
+	MT_Tree leaves;
+	U64 root[2];
+	size_t treeframes;
+	U64 trailer[3];		/* frames and root, zero without trailer */
+
 	/* threading */
 	cwork_t *cwork;
 
@@ -89,6 +121,32 @@ struct ZSTDCB_DCtx_s {
 	fn_write *fn_write;
 	void *arg_write;
 
+	/* unordered writing, zero when not used */
+	fn_write_frame *fn_write_frame;
+	void *arg_write_frame;
+	U64 outpos;		/* offset of the next frame, see pt_outpos() */
+
+	/* verification only, the output is dropped */
+	int verify;
+
+	/* filter of the decoded output, zero when not used */
+	fn_filter *fn_filter;
+	void *arg_filter;
+
+	/* range of the input, see range-mt.h */
+	MT_Range range;
+	fn_read *fn_readrange;
+	void *arg_readrange;
+
+	/* bloom filters of the frames, see bloom-mt.h */
+	ZSTDCB_Buffer bloom;
+	const void *pattern;
+	size_t patlen;
+	int bloom_line;
+	int bloom_seen;
+	int bloom_skip;
+	size_t skipped;
+
 	/* error handling */
 	pthread_mutex_t error_mutex;
 
@@ -121,6 +179,12 @@ ZSTDCB_DCtx *ZSTDCB_createDCtx(int threads, int inputsize)
 	ctx->insize = 0;
 	ctx->outsize = 0;
 	ctx->frames = 0;
+	ctx->errframe = 0;
+	ctx->erroffset = 0;
+	ctx->tree = 0;
+	MT_tree_init(&ctx->leaves);
+	ctx->treeframes = 0;
+	ctx->trailer[0] = 0;
 	ctx->curframe = 0;
 
 	/* will be used for single stream only */
@@ -134,10 +198,126 @@ ZSTDCB_DCtx *ZSTDCB_createDCtx(int threads, int inputsize)
 
 	/* later */
 	ctx->cwork = 0;
+	ctx->pool = 0;
+	ctx->weight = 1;
+	ctx->ring.buf = 0;
+	ctx->ring.size = 0;
+	ctx->fn_write_frame = 0;
+	ctx->verify = 0;
+	ctx->arg_write_frame = 0;
+	ctx->fn_filter = 0;
+	ctx->arg_filter = 0;
+	MT_range_init(&ctx->range);
+	ctx->bloom.buf = 0;
+	ctx->bloom.size = 0;
+	ctx->bloom.allocated = 0;
+	ctx->pattern = 0;
+	ctx->patlen = 0;
+	ctx->skipped = 0;
 
 	return ctx;
 }
 
+/* run the workers within a shared pool */
+size_t ZSTDCB_SetPoolDCtx(ZSTDCB_DCtx * ctx, POOLMT_Pool * pool, int weight)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(init_missing);
+
+	if (weight < 1 || weight > POOLMT_WEIGHT_MAX)
+		return ZSTDCB_ERROR(compressionParameter_unsupported);
+
+	ctx->pool = pool;
+	ctx->weight = weight;
+
+	return 0;
+}
+
+size_t ZSTDCB_SetUnorderedDCtx(ZSTDCB_DCtx * ctx, fn_write_frame * fn, void *arg)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(init_missing);
+
+	ctx->fn_write_frame = fn;
+	ctx->arg_write_frame = arg;
+
+	return 0;
+}
+
+/**
+ * pt_verify - sink of the verification, the buffer is reused at once
+ */
+static int pt_verify(void *arg, ZSTDCB_Buffer * out, size_t frame,
+		     unsigned long long offset)
+{
+	(void)arg;
+	(void)out;
+	(void)frame;
+	(void)offset;
+
+	return 0;
+}
+
+size_t ZSTDCB_SetVerifyDCtx(ZSTDCB_DCtx * ctx, int enable)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(init_missing);
+
+	ctx->verify = enable != 0;
+	ctx->fn_write_frame = enable ? pt_verify : 0;
+	ctx->arg_write_frame = 0;
+
+	return 0;
+}
+
+size_t ZSTDCB_SetTreeHashDCtx(ZSTDCB_DCtx * ctx, int enable)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(compressionParameter_unsupported);
+
+	ctx->tree = enable != 0;
+
+	return 0;
+}
+
+size_t ZSTDCB_SetRangeDCtx(ZSTDCB_DCtx * ctx, unsigned long long start,
+			   unsigned long long end)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(init_missing);
+	if (end && end <= start)
+		return ZSTDCB_ERROR(compressionParameter_unsupported);
+
+	ctx->range.start = start;
+	ctx->range.end = end;
+
+	return 0;
+}
+
+size_t ZSTDCB_SetFilterDCtx(ZSTDCB_DCtx * ctx, fn_filter * fn, void *arg)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(init_missing);
+
+	ctx->fn_filter = fn;
+	ctx->arg_filter = arg;
+
+	return 0;
+}
+
+size_t ZSTDCB_SetBloomDCtx(ZSTDCB_DCtx * ctx, const void *pattern, int len)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(init_missing);
+	if (len < 0)
+		return ZSTDCB_ERROR(compressionParameter_unsupported);
+
+	ctx->pattern = len ? pattern : 0;
+	ctx->patlen = (size_t)len;
+
+	return 0;
+}
+
 /**
  * IsZstd_Magic - check, if 4 bytes are valid ZSTD MAGIC
  */
@@ -176,6 +356,37 @@ static size_t mt_error(int rv)
 	return ZSTDCB_ERROR(read_fail);
 }
 
+/**
+ * pt_filter - run the filter on some decoded output
+ */
+static size_t pt_filter(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * out)
+{
+	int rv;
+
+	if (!ctx->fn_filter)
+		return 0;
+	rv = ctx->fn_filter(ctx->arg_filter, out);
+	if (rv != 0)
+		return mt_error(rv);
+
+	return 0;
+}
+
+/**
+ * pt_writeframe - write a decoded frame, without waiting for the others
+ */
+static size_t pt_writeframe(ZSTDCB_DCtx * ctx, struct writelist *wl)
+{
+	int rv;
+
+	rv = ctx->fn_write_frame(ctx->arg_write_frame, &wl->out, wl->frame,
+				 wl->outoffset);
+	if (rv != 0)
+		return mt_error(rv);
+
+	return 0;
+}
+
 /**
  * pt_write - queue for decompressed output
  */
@@ -185,14 +396,56 @@ static size_t pt_write(ZSTDCB_DCtx * ctx, struct writelist *wl)
 
 	/* move the entry to the done list */
 	list_move(&wl->node, &ctx->writelist_done);
+
+	/* the leaf of the frame, the frames may come in any order here */
+	if (ctx->tree && !wl->ref[0] &&
+	    MT_tree_set(&ctx->leaves, wl->frame, wl->leaf))
+		return ZSTDCB_ERROR(memory_allocation);
+
+	/* unordered, the worker has written it already */
+	if (ctx->fn_write_frame && !ctx->ring.buf)
+		wl->frame = ctx->curframe;
  again:
 	/* check, what can be written ... */
 	list_for_each(entry, &ctx->writelist_done) {
 		wl = list_entry(entry, struct writelist, node);
 		if (wl->frame == ctx->curframe) {
-			int rv = ctx->fn_write(ctx->arg_write, &wl->out);
-			if (rv != 0)
-				return mt_error(rv);
+			int rv;
+
+			/* copy the referenced output */
+			if (wl->ref[0] &&
+			    MT_ring_get(&ctx->ring, wl->out.buf, wl->ref[0],
+					wl->ref[1]))
+				return ZSTDCB_ERROR(data_error);
+			if (wl->ref[0] && ctx->tree) {
+				MT_tree_leaf(wl->out.buf, wl->out.size,
+					     wl->leaf);
+				if (MT_tree_set(&ctx->leaves, wl->frame,
+						wl->leaf))
+					return ZSTDCB_ERROR(memory_allocation);
+			}
+
+			/* the ring needs the output, before it's filtered */
+			if (ctx->ring.buf) {
+				size_t result;
+
+				wl->outoffset = ctx->ring.pos;
+				MT_ring_put(&ctx->ring, wl->out.buf,
+					    wl->out.size);
+				result = pt_filter(ctx, &wl->out);
+				if (ZSTDCB_isError(result))
+					return result;
+			}
+			if (!ctx->fn_write_frame) {
+				rv = ctx->fn_write(ctx->arg_write, &wl->out);
+				if (rv != 0)
+					return mt_error(rv);
+			} else if (ctx->ring.buf) {
+				size_t result = pt_writeframe(ctx, wl);
+
+				if (ZSTDCB_isError(result))
+					return result;
+			}
 			ctx->outsize += wl->out.size;
 			ctx->curframe++;
 			list_move(entry, &ctx->writelist_free);
@@ -203,23 +456,334 @@ static size_t pt_write(ZSTDCB_DCtx * ctx, struct writelist *wl)
 	return 0;
 }
 
+/**
+ * pt_window - parse the window frame of a deduplicated stream
+ *
+ * The magic check reads 16 bytes, which is just the size of the window
+ * frame. The ring buffer for the references gets allocated here.
+ */
+static size_t pt_window(ZSTDCB_DCtx * ctx, unsigned char *buf)
+{
+	U64 window;
+
+	if (MEM_readLE32(buf + 4) != MT_DEDUP_WINDOWSIZE)
+		return ZSTDCB_ERROR(data_error);
+
+	window = MEM_readLE64(buf + 8);
+	if (window == 0 || window > MT_DEDUP_WINDOW_MAX)
+		return ZSTDCB_ERROR(data_error);
+	if (MT_ring_init(&ctx->ring, window))
+		return ZSTDCB_ERROR(memory_allocation);
+	ctx->insize += 8 + MT_DEDUP_WINDOWSIZE;
+
+	return 0;
+}
+
+/**
+ * pt_readref - read the rest of a reference frame
+ * - done bytes of it are already in hdr, behind the magic
+ */
+static int pt_readref(ZSTDCB_DCtx * ctx, unsigned char *hdr, size_t done,
+		      U64 * ref)
+{
+	unsigned char buf[4 + MT_DEDUP_REFSIZE];
+	ZSTDCB_Buffer in;
+	int rv;
+
+	memcpy(buf, hdr + 4, done);
+	in.buf = buf + done;
+	in.size = sizeof(buf) - done;
+	rv = ctx->fn_read(ctx->arg_read, &in);
+	if (rv != 0)
+		return rv;
+	if (in.size != sizeof(buf) - done || !ctx->ring.buf ||
+	    MEM_readLE32(buf) != MT_DEDUP_REFSIZE)
+		return 1;
+
+	ref[0] = MEM_readLE64(buf + 4);
+	ref[1] = MEM_readLE64(buf + 12);
+	if (ref[0] == 0 || ref[0] > ctx->ring.size || ref[1] > ref[0])
+		return 1;
+	ctx->insize += 8 + MT_DEDUP_REFSIZE;
+
+	return 0;
+}
+
+/**
+ * pt_trailer - read the rest of the trailer frame of the tree hash
+ * - done bytes of it are already in hdr, behind the magic
+ */
+static int pt_trailer(ZSTDCB_DCtx * ctx, unsigned char *hdr, size_t done)
+{
+	unsigned char buf[4 + MT_TREE_SIZE];
+	ZSTDCB_Buffer in;
+	int rv;
+
+	memcpy(buf, hdr + 4, done);
+	in.buf = buf + done;
+	in.size = sizeof(buf) - done;
+	rv = ctx->fn_read(ctx->arg_read, &in);
+	if (rv != 0)
+		return rv;
+	if (in.size != sizeof(buf) - done ||
+	    MEM_readLE32(buf) != MT_TREE_SIZE ||
+	    MT_tree_read(buf + 4, &ctx->trailer[0], ctx->trailer + 1))
+		return 1;
+	ctx->insize += MT_TREE_FRAMESIZE;
+
+	return 0;
+}
+
+/**
+ * pt_bloom - read the rest of a bloom frame
+ * - done bytes of it are already in hdr, behind the magic
+ * - with a pattern, the next data frame is marked for skipping, when
+ *   the pattern is not in its filter and the frame has whole lines
+ */
+static int pt_bloom(ZSTDCB_DCtx * ctx, unsigned char *hdr, size_t done)
+{
+	unsigned char buf[8];
+	ZSTDCB_Buffer in;
+	size_t size, have = done < 8 ? done : 8;
+	U32 flags;
+	int rv;
+
+	memcpy(buf, hdr + 4, have);
+	in.buf = buf + have;
+	in.size = 8 - have;
+	if (in.size) {
+		rv = ctx->fn_read(ctx->arg_read, &in);
+		if (rv != 0)
+			return rv;
+		if (in.size != 8 - have)
+			return 1;
+	}
+
+	size = MEM_readLE32(buf);
+	flags = MEM_readLE32(buf + 4);
+	if (size < 4 + MT_BLOOM_MIN || size > 4 + MT_BLOOM_MAX)
+		return 1;
+	size -= 4;
+	if (size & (size - 1))
+		return 1;
+
+	if (ctx->bloom.allocated < size) {
+		void *b = realloc(ctx->bloom.buf, size);
+		if (!b)
+			return 1;
+		ctx->bloom.buf = b;
+		ctx->bloom.allocated = size;
+	}
+	memcpy(ctx->bloom.buf, hdr + 12, done - have);
+	in.buf = (unsigned char *)ctx->bloom.buf + (done - have);
+	in.size = size - (done - have);
+	rv = ctx->fn_read(ctx->arg_read, &in);
+	if (rv != 0)
+		return rv;
+	if (in.size != size - (done - have))
+		return 1;
+	ctx->insize += MT_BLOOM_HDRSIZE + size;
+
+	/* a deduplicated stream needs all frames for the ring buffer */
+	ctx->bloom_skip = ctx->pattern && !ctx->ring.buf && ctx->bloom_line &&
+	    (flags & MT_BLOOM_NEWLINE) &&
+	    !MT_bloom_test(ctx->bloom.buf, size, ctx->pattern, ctx->patlen);
+	ctx->bloom_line = flags & MT_BLOOM_NEWLINE;
+	ctx->bloom_seen = 1;
+
+	return 0;
+}
+
+/**
+ * pt_header - read the rest of a frame header and parse it
+ *
+ * The first done bytes of it are already in hdr, which has the space
+ * of MT_FRAME_MAXSIZE bytes. Returns zero, when the header is valid.
+ */
+static int pt_header(ZSTDCB_DCtx * ctx, unsigned char *hdr, size_t done,
+		     MT_Frame * f)
+{
+	ZSTDCB_Buffer in;
+	size_t hsize = MT_frame_hsize(hdr);
+	int rv;
+
+	if (hsize > done) {
+		in.buf = hdr + done;
+		in.size = hsize - done;
+		in.allocated = 0;
+		rv = ctx->fn_read(ctx->arg_read, &in);
+		if (rv != 0)
+			return rv;
+		if (in.size != hsize - done)
+			return 1;
+	}
+	if (MT_frame_read(f, hdr))
+		return 1;
+
+	/* version 1 has 4 bytes behind the magic */
+	return f->version == 1 && f->hsize != 12;
+}
+
+/**
+ * pt_valid - check a frame header, while searching the range start
+ */
+static int pt_valid(const BYTE * hdr, size_t avail)
+{
+	if (MEM_readLE32(hdr + 4) != 4)
+		return MT_frame_valid(hdr, avail);
+	return MEM_readLE32(hdr + 8) != 0 &&
+	    IsZstd_Magic((unsigned char *)hdr + 12);
+}
+
+/**
+ * pt_readrange - the bytes of the range search come first
+ */
+static int pt_readrange(void *arg, ZSTDCB_Buffer * in)
+{
+	ZSTDCB_DCtx *ctx = (ZSTDCB_DCtx *) arg;
+	ZSTDCB_Buffer rest;
+	size_t done = MT_range_get(&ctx->range, in->buf, in->size);
+	int rv;
+
+	if (done == in->size)
+		return 0;
+	rest.buf = (unsigned char *)in->buf + done;
+	rest.size = in->size - done;
+	rest.allocated = 0;
+	rv = ctx->fn_readrange(ctx->arg_readrange, &rest);
+	in->size = done + rest.size;
+
+	return rv;
+}
+
+/**
+ * pt_resync - go to the first frame header of the range
+ * - the input begins at range.start, returns 1 when there is none
+ */
+static int pt_resync(ZSTDCB_DCtx * ctx)
+{
+	MT_Range *r = &ctx->range;
+	ZSTDCB_Buffer in;
+	U64 pos = r->start;
+	size_t keep = 0, found;
+	int rv;
+
+	MT_range_free(r);
+	r->insize = ctx->insize;
+	r->left = r->end ? r->end - r->start : 0;
+	if (!r->start)
+		return 0;
+
+	r->buf = (BYTE *) malloc(MT_RANGE_BUFSIZE);
+	if (!r->buf)
+		return -3;
+	for (;;) {
+		in.buf = r->buf + keep;
+		in.size = MT_RANGE_BUFSIZE - keep;
+		in.allocated = 0;
+		rv = ctx->fn_read(ctx->arg_read, &in);
+		if (rv != 0)
+			return rv;
+		r->size = keep + in.size;
+		found = MT_range_find(r->buf, r->size, MT_RANGE_HDRMIN,
+				      pt_valid);
+		if (found < r->size)
+			break;
+
+		/* a header may begin within the last bytes */
+		keep = r->size < MT_RANGE_HDRMAX - 1 ?
+		    r->size : MT_RANGE_HDRMAX - 1;
+		pos += r->size - keep;
+		if (in.size == 0 || (r->end && pos >= r->end))
+			return 1;
+		memmove(r->buf, r->buf + r->size - keep, keep);
+	}
+	if (r->end && pos + found >= r->end)
+		return 1;
+
+	/* the following reads begin with the frame header */
+	r->pos = found;
+	r->left = r->end ? r->end - (pos + found) : 0;
+	ctx->fn_readrange = ctx->fn_read;
+	ctx->arg_readrange = ctx->arg_read;
+	ctx->fn_read = pt_readrange;
+	ctx->arg_read = ctx;
+
+	return 0;
+}
+
+/**
+ * pt_usize - uncompressed size of a data frame
+ * - version 2 headers have it, otherwise the content size of the zstd
+ *   frame header is taken, MT_INFO_UNKNOWN when it is not there
+ */
+static U64 pt_usize(const MT_Frame * f, const void *data, size_t size)
+{
+	unsigned long long n;
+
+	if (f && f->version == 2)
+		return f->usize;
+
+	n = ZSTD_getFrameContentSize(data, size);
+	if (n == ZSTD_CONTENTSIZE_UNKNOWN || n == ZSTD_CONTENTSIZE_ERROR)
+		return MT_INFO_UNKNOWN;
+
+	return n;
+}
+
+/**
+ * pt_outpos - offset of the next frame in the uncompressed output
+ * - called under the read mutex in the order of the input, the offsets
+ *   of the frames are known before the earlier ones are decoded
+ * - after a frame of unknown size, all offsets are MT_INFO_UNKNOWN
+ */
+static U64 pt_outpos(ZSTDCB_DCtx * ctx, U64 usize)
+{
+	U64 pos = ctx->outpos;
+
+	if (pos != MT_INFO_UNKNOWN)
+		ctx->outpos = usize == MT_INFO_UNKNOWN ?
+		    MT_INFO_UNKNOWN : pos + usize;
+
+	return pos;
+}
+
 /**
  * pt_read - read compressed input
  */
-static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
+static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame,
+		      size_t * uncompressed, U64 * offset, U64 * outoffset,
+		      U64 * ref, U64 * sum)
 {
-	unsigned char hdrbuf[12];
+	unsigned char hdrbuf[MT_FRAME_MAXSIZE];
 	ZSTDCB_Buffer hdr;
+	MT_Frame f;
 	size_t toRead;
 	int rv;
 
 	pthread_mutex_lock(&ctx->read_mutex);
+	ref[0] = 0;
+	sum[0] = 0;
+	*uncompressed = 0;
+	*offset = ctx->insize;
 
 	/* special case, some bytes were read by magic check */
-	if (unlikely(ctx->frames == 0)) {
+	if (unlikely(ctx->frames == 0 && !ctx->skipped)) {
 		/* the magic check reads exactly 16 bytes! */
 		if (unlikely(in->size != 16))
 			goto error_data;
+
+		/**
+		 * version 2 header, the 16 bytes are a part of it
+		 * - the rest of the header and the data is read below
+		 */
+		if (IsZstd_Skippable(in->buf) &&
+		    MEM_readLE32((unsigned char *)in->buf + 4) != 4) {
+			memcpy(hdrbuf, in->buf, 16);
+			hdr.buf = hdrbuf;
+			hdr.size = 16;
+			goto header;
+		}
 		ctx->insize += 16;
 
 		/**
@@ -257,6 +821,8 @@ static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
 			if (in->size != toRead)
 				goto error_data;
 			ctx->insize += in->size;
+			ctx->bloom_line = 0;
+			*outoffset = pt_outpos(ctx, pt_usize(0, in->buf, in->size));
 			*frame = ctx->frames++;
 			pthread_mutex_unlock(&ctx->read_mutex);
 			return 0;	/* done! */
@@ -282,6 +848,7 @@ static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
 			in->buf = start + 4;
 			in->size = toRead - 4;
 			rv = ctx->fn_read(ctx->arg_read, in);
+			in->buf = start;	/* restore inbuf, it is freed */
 			if (rv != 0) {
 				pthread_mutex_unlock(&ctx->read_mutex);
 				return mt_error(rv);
@@ -289,8 +856,13 @@ static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
 			if (in->size != toRead - 4)
 				goto error_data;
 			ctx->insize += in->size;
-			in->buf = start;	/* restore inbuf */
 			in->size += 4;
+			*outoffset = pt_outpos(ctx, pt_usize(0, in->buf, in->size));
+			if (ctx->bloom_skip)
+				goto skip;
+			if (!ctx->bloom_seen)
+				ctx->bloom_line = 0;
+			ctx->bloom_seen = 0;
 			*frame = ctx->frames++;
 			pthread_mutex_unlock(&ctx->read_mutex);
 			return 0;	/* done! */
@@ -303,6 +875,13 @@ static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
 	 * 4 bytes little endian, must be: 4 (user data size)
 	 * 4 bytes little endian, size to read (user data)
 	 */
+ next:
+	*offset = ctx->insize;
+	if (MT_range_done(&ctx->range, ctx->insize)) {
+		pthread_mutex_unlock(&ctx->read_mutex);
+		in->size = 0;
+		return 0;
+	}
 	hdr.buf = hdrbuf;
 	hdr.size = 12;
 	rv = ctx->fn_read(ctx->arg_read, &hdr);
@@ -321,12 +900,32 @@ static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
 	/* check header data */
 	if (unlikely(hdr.size != 12))
 		goto error_read;
+	if (MEM_readLE32(hdr.buf) == MT_BLOOM_MAGIC) {
+		if (pt_bloom(ctx, hdr.buf, 8))
+			goto error_data;
+		goto next;
+	}
+	if (MEM_readLE32(hdr.buf) == MT_TREE_MAGIC) {
+		if (pt_trailer(ctx, hdr.buf, 8))
+			goto error_data;
+		goto next;
+	}
+	if (MEM_readLE32(hdr.buf) == MT_DEDUP_MAGIC)
+		goto dedup_ref;
 	if (unlikely(!IsZstd_Skippable(hdr.buf)))
 		goto error_data;
-	ctx->insize += 12;
+
+ header:
+	/* check header data, version 1 or 2 */
+	if (pt_header(ctx, hdr.buf, hdr.size, &f))
+		goto error_data;
+	sum[0] = f.flags & MT_FRAME_CHECKSUM;
+	sum[1] = f.checksum;
+	*uncompressed = (size_t)f.usize;
+	ctx->insize += f.hsize;
 
 	/* read new input (size should be _toRead_ bytes */
-	toRead = MEM_readLE32((unsigned char *)hdr.buf + 8);
+	toRead = (size_t)f.csize;
 	{
 		if (in->allocated < toRead) {
 			/* need bigger input buffer */
@@ -351,12 +950,35 @@ static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
 
 		ctx->insize += in->size;
 	}
+	*outoffset = pt_outpos(ctx, pt_usize(&f, in->buf, in->size));
+
+	/* the pattern is not in this frame, go on with the next one */
+	if (ctx->bloom_skip)
+		goto skip;
+	if (!ctx->bloom_seen)
+		ctx->bloom_line = 0;
+	ctx->bloom_seen = 0;
 	*frame = ctx->frames++;
 	pthread_mutex_unlock(&ctx->read_mutex);
 
 	/* done, no error */
 	return 0;
 
+ skip:
+	ctx->bloom_skip = 0;
+	ctx->bloom_seen = 0;
+	ctx->skipped++;
+	goto next;
+
+ dedup_ref:
+	/* the output is copied from the ring buffer by pt_write() */
+	if (pt_readref(ctx, hdr.buf, 8, ref))
+		goto error_data;
+	*outoffset = pt_outpos(ctx, ref[1]);
+	*frame = ctx->frames++;
+	pthread_mutex_unlock(&ctx->read_mutex);
+	return 0;
+
  error_data:
 	pthread_mutex_unlock(&ctx->read_mutex);
 	return ZSTDCB_ERROR(data_error);
@@ -368,7 +990,29 @@ static size_t pt_read(ZSTDCB_DCtx * ctx, ZSTDCB_Buffer * in, size_t * frame)
 	return ZSTDCB_ERROR(memory_allocation);
 }
 
-static void *pt_decompress(void *arg)
+/**
+ * pt_corrupt - a frame has a wrong checksum or can not be decoded,
+ * remember the first one, returns err
+ */
+static size_t pt_corrupt(ZSTDCB_DCtx * ctx, struct writelist *wl, size_t err)
+{
+	pthread_mutex_lock(&ctx->write_mutex);
+	if (!ctx->errframe || wl->frame < ctx->errframe - 1) {
+		ctx->errframe = wl->frame + 1;
+		ctx->erroffset = wl->offset;
+	}
+	pthread_mutex_unlock(&ctx->write_mutex);
+
+	return err;
+}
+
+/**
+ * pt_decompress_step - read, decompress and write one frame
+ *
+ * Returns zero, when there is more work to do. Otherwise the worker
+ * is done and w->result holds the error code.
+ */
+static int pt_decompress_step(void *arg)
 {
 	cwork_t *w = (cwork_t *) arg;
 	ZSTDCB_Buffer *in = &w->in;
@@ -376,176 +1020,228 @@ static void *pt_decompress(void *arg)
 	struct writelist *wl;
 	size_t result = 0;
 	ZSTDCB_Buffer collect;
-
-	/* init dstream stream */
-	result = ZSTD_initDStream(w->dctx);
-	if (ZSTD_isError(result)) {
-		zstdmt_errcode = result;
-		return (void *)ZSTDCB_ERROR(compression_library);
-	}
+	ZSTDCB_Buffer *out;
+	ZSTD_inBuffer zIn;
+	ZSTD_outBuffer zOut;
+	size_t usize;
 
 	collect.buf = 0;
 	collect.size = 0;
 	collect.allocated = 0;
-	for (;;) {
-		ZSTDCB_Buffer *out;
-		ZSTD_inBuffer zIn;
-		ZSTD_outBuffer zOut;
 
-		/* select or allocate space for new output */
-		pthread_mutex_lock(&ctx->write_mutex);
-		if (!list_empty(&ctx->writelist_free)) {
-			/* take unused entry */
-			struct list_head *entry;
-			entry = list_first(&ctx->writelist_free);
-			wl = list_entry(entry, struct writelist, node);
-			list_move(entry, &ctx->writelist_busy);
-		} else {
-			/* allocate new one */
-			wl = (struct writelist *)
-			    malloc(sizeof(struct writelist));
-			if (!wl) {
-				result = ZSTDCB_ERROR(memory_allocation);
-				goto error_unlock;
-			}
-			out = &wl->out;
-			out->size = ctx->outputsize;
+	/* select or allocate space for new output */
+	pthread_mutex_lock(&ctx->write_mutex);
+	if (!list_empty(&ctx->writelist_free)) {
+		/* take unused entry */
+		struct list_head *entry;
+		entry = list_first(&ctx->writelist_free);
+		wl = list_entry(entry, struct writelist, node);
+		list_move(entry, &ctx->writelist_busy);
+	} else {
+		/* allocate new one */
+		wl = (struct writelist *)
+		    malloc(sizeof(struct writelist));
+		if (!wl) {
+			pthread_mutex_unlock(&ctx->write_mutex);
+			w->result = ZSTDCB_ERROR(memory_allocation);
+			return 1;
+		}
+		out = &wl->out;
+		out->size = ctx->outputsize;
+		out->buf = malloc(out->size);
+		if (!out->buf) {
+			result = ZSTDCB_ERROR(memory_allocation);
+			list_add(&wl->node, &ctx->writelist_busy);
+			goto done_unlock;
+		}
+		out->allocated = out->size;
+		list_add(&wl->node, &ctx->writelist_busy);
+	}
+
+	/* start with 512KB */
+	/* the exact size is known with version 2 headers, see below */
+	out = &wl->out;
+	pthread_mutex_unlock(&ctx->write_mutex);
+
+	/* init dstream stream */
+	result = ZSTD_resetDStream(w->dctx);
+	if (ZSTD_isError(result))
+		goto error_clib;
+
+	/* zero should not happen here! */
+	result = pt_read(ctx, in, &wl->frame, &usize, &wl->offset,
+			 &wl->outoffset, wl->ref, wl->sum);
+	if (!ZSTDCB_isError(result) && wl->ref[0]) {
+		/* reference to earlier output */
+		out->size = (size_t)wl->ref[1];
+		if (out->allocated < out->size) {
+			free(out->buf);
 			out->buf = malloc(out->size);
 			if (!out->buf) {
+				out->allocated = 0;
 				result = ZSTDCB_ERROR(memory_allocation);
-				goto error_unlock;
+				goto done_lock;
 			}
 			out->allocated = out->size;
-			list_add(&wl->node, &ctx->writelist_busy);
 		}
-
-		/* start with 512KB */
-		/* XXX, add framesize detection... */
-		out = &wl->out;
+		pthread_mutex_lock(&ctx->write_mutex);
+		result = pt_write(ctx, wl);
+		if (ZSTDCB_isError(result))
+			goto done_unlock;
 		pthread_mutex_unlock(&ctx->write_mutex);
-
-		/* init dstream stream */
-		result = ZSTD_resetDStream(w->dctx);
-		if (ZSTD_isError(result)) {
-			zstdmt_errcode = result;
-			return (void *)ZSTDCB_ERROR(compression_library);
-		}
-
-		/* zero should not happen here! */
-		result = pt_read(ctx, in, &wl->frame);
-		if (in->size == 0)
-			break;
-		if (ZSTDCB_isError(result)) {
-			goto error_lock;
+		return 0;
+	}
+	if (in->size == 0) {
+		/* eof, everything is okay */
+		result = 0;
+		goto done_lock;
+	}
+	if (ZSTDCB_isError(result))
+		goto done_lock;
+
+	/* the exact size of the output is known with version 2 headers */
+	if (out->allocated < usize) {
+		free(out->buf);
+		out->buf = malloc(usize);
+		if (!out->buf) {
+			out->allocated = 0;
+			result = ZSTDCB_ERROR(memory_allocation);
+			goto done_lock;
 		}
+		out->allocated = usize;
+	}
 
-		zIn.size = in->allocated;
-		zIn.src = in->buf;
-		zIn.pos = 0;
+	zIn.size = in->allocated;
+	zIn.src = in->buf;
+	zIn.pos = 0;
 
-		for (;;) {
+	for (;;) {
  again:
-			/* decompress loop */
-			zOut.size = out->allocated;
-			zOut.dst = out->buf;
-			zOut.pos = 0;
-
-			dprintf
-			    ("ZSTD_decompressStream() zIn.size=%zu zIn.pos=%zu zOut.size=%zu zOut.pos=%zu\n",
-			     zIn.size, zIn.pos, zOut.size, zOut.pos);
-			result = ZSTD_decompressStream(w->dctx, &zOut, &zIn);
-			dprintf
-			    ("ZSTD_decompressStream(), ret=%zu zIn.size=%zu zIn.pos=%zu zOut.size=%zu zOut.pos=%zu\n",
-			     result, zIn.size, zIn.pos, zOut.size, zOut.pos);
-			if (ZSTD_isError(result))
-				goto error_clib;
-
-			/* end of frame */
-			if (result == 0) {
-				/* put collected stuff together */
-				if (collect.size) {
-					void *bnew;
-					bnew = malloc(collect.size + zOut.pos);
-					if (!bnew) {
-						result =
-						    ZSTDCB_ERROR
-						    (memory_allocation);
-						goto error_lock;
-					}
-					memcpy((char *)bnew, collect.buf,
-					       collect.size);
-					memcpy((char *)bnew + collect.size,
-					       out->buf, zOut.pos);
-					free(collect.buf);
-					free(out->buf);
-					out->buf = bnew;
-					out->size = collect.size + zOut.pos;
-					out->allocated = out->size;
-					collect.buf = 0;
-					collect.size = 0;
-				} else {
-					out->size = zOut.pos;
-				}
-				/* write result */
-				pthread_mutex_lock(&ctx->write_mutex);
-				result = pt_write(ctx, wl);
-				if (ZSTDCB_isError(result))
-					goto error_unlock;
-				pthread_mutex_unlock(&ctx->write_mutex);
-				/* will read next input */
-				break;
-			}
+		/* decompress loop */
+		zOut.size = out->allocated;
+		zOut.dst = out->buf;
+		zOut.pos = 0;
+
+		dprintf
+		    ("ZSTD_decompressStream() zIn.size=%zu zIn.pos=%zu zOut.size=%zu zOut.pos=%zu\n",
+		     zIn.size, zIn.pos, zOut.size, zOut.pos);
+		result = ZSTD_decompressStream(w->dctx, &zOut, &zIn);
+		dprintf
+		    ("ZSTD_decompressStream(), ret=%zu zIn.size=%zu zIn.pos=%zu zOut.size=%zu zOut.pos=%zu\n",
+		     result, zIn.size, zIn.pos, zOut.size, zOut.pos);
+		if (ZSTD_isError(result)) {
+			zstdmt_errcode = result;
+			result = pt_corrupt(ctx, wl,
+					    ZSTDCB_ERROR(compression_library));
+			goto done_lock;
+		}
 
-			/* out buffer to small for full frame */
-			if (result != 0) {
-				/* collect old content from out */
-				collect.buf =
-				    realloc(collect.buf,
-					    collect.size + out->size);
-				memcpy((char *)collect.buf + collect.size,
-				       out->buf, out->size);
-				collect.size = collect.size + out->size;
-
-				/* double the buffer, until it fits */
-				pthread_mutex_lock(&ctx->write_mutex);
-				out->size *= 2;
-				ctx->outputsize = out->size;
-				pthread_mutex_unlock(&ctx->write_mutex);
-				out->buf = realloc(out->buf, out->size);
-				if (!out->buf) {
+		/* end of frame */
+		if (result == 0) {
+			/* put collected stuff together */
+			if (collect.size) {
+				void *bnew;
+				bnew = malloc(collect.size + zOut.pos);
+				if (!bnew) {
 					result =
 					    ZSTDCB_ERROR(memory_allocation);
-					goto error_lock;
+					goto done_lock;
 				}
+				memcpy((char *)bnew, collect.buf,
+				       collect.size);
+				memcpy((char *)bnew + collect.size,
+				       out->buf, zOut.pos);
+				free(collect.buf);
+				free(out->buf);
+				out->buf = bnew;
+				out->size = collect.size + zOut.pos;
 				out->allocated = out->size;
-				goto again;
+				collect.buf = 0;
+				collect.size = 0;
+			} else {
+				out->size = zOut.pos;
+			}
+			/* the checksum of the frame header, checked in parallel */
+			if (wl->sum[0] &&
+			    MT_XXH64(out->buf, out->size, 0) != wl->sum[1]) {
+				result = pt_corrupt(ctx, wl, ZSTDCB_ERROR(checksum_wrong));
+				goto done_lock;
+			}
+			/* the leaf of the tree hash, while it is in the cache */
+			if (ctx->tree && !wl->ref[0])
+				MT_tree_leaf(out->buf, out->size, wl->leaf);
+			/* filter and write unordered, see pt_write() */
+			if (!ctx->ring.buf) {
+				result = pt_filter(ctx, out);
+				if (!ZSTDCB_isError(result) &&
+				    ctx->fn_write_frame)
+					result = pt_writeframe(ctx, wl);
+				if (ZSTDCB_isError(result))
+					goto done_lock;
 			}
 
-			if (zIn.pos == zIn.size)
-				break;	/* should fail... */
-		}		/* decompress loop */
-	}			/* read input loop */
+			/* write result */
+			pthread_mutex_lock(&ctx->write_mutex);
+			result = pt_write(ctx, wl);
+			if (ZSTDCB_isError(result))
+				goto done_unlock;
+			pthread_mutex_unlock(&ctx->write_mutex);
+			/* will read next input */
+			return 0;
+		}
 
-	/* everything is okay */
-	pthread_mutex_lock(&ctx->write_mutex);
-	list_move(&wl->node, &ctx->writelist_free);
-	pthread_mutex_unlock(&ctx->write_mutex);
-	if (in->allocated)
-		free(in->buf);
+		/* out buffer to small for full frame */
+		if (result != 0) {
+			/* collect old content from out */
+			collect.buf =
+			    realloc(collect.buf, collect.size + zOut.pos);
+			memcpy((char *)collect.buf + collect.size,
+			       out->buf, zOut.pos);
+			collect.size = collect.size + zOut.pos;
+
+			/* double the buffer, until it fits */
+			pthread_mutex_lock(&ctx->write_mutex);
+			out->size = out->allocated * 2;
+			ctx->outputsize = out->size;
+			pthread_mutex_unlock(&ctx->write_mutex);
+			out->buf = realloc(out->buf, out->size);
+			if (!out->buf) {
+				result = ZSTDCB_ERROR(memory_allocation);
+				goto done_lock;
+			}
+			out->allocated = out->size;
+			goto again;
+		}
+
+		if (zIn.pos == zIn.size)
+			break;	/* should fail... */
+	}			/* decompress loop */
+
+	/* next input */
 	return 0;
 
  error_clib:
 	zstdmt_errcode = result;
 	result = ZSTDCB_ERROR(compression_library);
 	/* fall through */
- error_lock:
+ done_lock:
 	pthread_mutex_lock(&ctx->write_mutex);
- error_unlock:
+ done_unlock:
 	list_move(&wl->node, &ctx->writelist_free);
 	pthread_mutex_unlock(&ctx->write_mutex);
-	if (in->allocated)
-		free(in->buf);
-	return (void *)result;
+	free(collect.buf);
+	w->result = result;
+	return 1;
+}
+
+static void *pt_decompress(void *arg)
+{
+	cwork_t *w = (cwork_t *) arg;
+
+	while (pt_decompress_step(w) == 0)
+		;
+
+	return (void *)w->result;
 }
 
 /* single threaded */
@@ -628,14 +1324,23 @@ static size_t st_decompress(void *arg)
 
 			if (zOut.pos) {
 				ZSTDCB_Buffer wb;
+				size_t err;
+
 				wb.size = zOut.pos;
 				wb.buf = zOut.dst;
-				rv = ctx->fn_write(ctx->arg_write, &wb);
+				wb.allocated = zOut.pos;
+				err = pt_filter(ctx, &wb);
+				if (ZSTDCB_isError(err)) {
+					result = err;
+					goto error;
+				}
+				rv = ctx->verify ? 0 :
+				    ctx->fn_write(ctx->arg_write, &wb);
 				if (rv != 0) {
 					result = mt_error(rv);
 					goto error;
 				}
-				ctx->outsize += zOut.pos;
+				ctx->outsize += wb.size;
 			}
 
 			/* one more round */
@@ -690,6 +1395,26 @@ static size_t st_decompress(void *arg)
 #define TYPE_SINGLE_THREAD 1
 #define TYPE_MULTI_THREAD  2
 
+/**
+ * pt_tree - hash the tree up to its root, compare it with the trailer
+ * - a range or skipped frames have only a part of the tree
+ */
+static size_t pt_tree(ZSTDCB_DCtx * ctx)
+{
+	MT_tree_root(&ctx->leaves, ctx->root);
+	ctx->treeframes = ctx->leaves.count;
+	MT_tree_free(&ctx->leaves);
+	if (!ctx->trailer[0] || ctx->range.start || ctx->range.end ||
+	    ctx->skipped)
+		return 0;
+
+	if (ctx->trailer[0] != ctx->treeframes ||
+	    ctx->trailer[1] != ctx->root[0] || ctx->trailer[2] != ctx->root[1])
+		return ZSTDCB_ERROR(tree_wrong);
+
+	return 0;
+}
+
 size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 {
 	unsigned char buf[16];
@@ -708,6 +1433,15 @@ size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 	ctx->arg_read = rdwr->arg_read;
 	ctx->arg_write = rdwr->arg_write;
 
+	/* a range of the input begins with the first frame header in it */
+	if (ctx->range.start || ctx->range.end) {
+		rv = pt_resync(ctx);
+		if (rv == 1)
+			return 0;
+		if (rv != 0)
+			return mt_error(rv);
+	}
+
 	/**
 	 * possible valid magic's for us, we need 16 bytes, for checking
 	 *
@@ -717,6 +1451,15 @@ size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 	 * 4) all other: not valid!
 	 */
 
+	ctx->bloom_line = 1;
+	ctx->bloom_seen = 0;
+	ctx->bloom_skip = 0;
+	ctx->skipped = 0;
+	ctx->outpos = 0;
+	ctx->trailer[0] = 0;
+	ctx->treeframes = 0;
+	MT_tree_free(&ctx->leaves);
+
 	/* check for ZSTDCB_MAGIC_SKIPPABLE */
 	in->buf = buf;
 	in->size = 16;
@@ -724,6 +1467,35 @@ size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 	if (rv != 0)
 		return mt_error(rv);
 
+	/* deduplicated stream, the window frame comes first */
+	if (in->size == 16 && MEM_readLE32(buf) == MT_DEDUP_MAGIC) {
+		size_t result = pt_window(ctx, buf);
+		if (ZSTDCB_isError(result))
+			return result;
+		in->size = 16;
+		rv = ctx->fn_read(ctx->arg_read, in);
+		if (rv != 0)
+			return mt_error(rv);
+		/* the references need the multi threaded decoder */
+		if (in->size != 16 || (!IsZstd_Skippable(buf) &&
+		    MEM_readLE32(buf) != MT_BLOOM_MAGIC))
+			return ZSTDCB_ERROR(data_error);
+	}
+
+	/* bloom filter of the first frame */
+	if (in->size == 16 && MEM_readLE32(buf) == MT_BLOOM_MAGIC) {
+		if (pt_bloom(ctx, buf, 12))
+			return ZSTDCB_ERROR(data_error);
+		if (MT_range_done(&ctx->range, ctx->insize))
+			return 0;
+		in->size = 16;
+		rv = ctx->fn_read(ctx->arg_read, in);
+		if (rv != 0)
+			return mt_error(rv);
+		if (in->size != 16 || !IsZstd_Skippable(buf))
+			return ZSTDCB_ERROR(data_error);
+	}
+
 	/* must be single threaded standard zstd, when smaller 16 bytes */
 	if (in->size < 16) {
 		if (!IsZstd_Magic(buf))
@@ -737,8 +1509,9 @@ size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 			return 0;
 		}
 	} else {
-		if (IsZstd_Skippable(buf) && IsZstd_Magic(buf + 12)) {
-			/* pzstd */
+		if (IsZstd_Skippable(buf) && (IsZstd_Magic(buf + 12) ||
+		    MT_frame_hsize(buf) >= MT_FRAME_V2SIZE)) {
+			/* pzstd, or with version 2 headers */
 			dprintf("pzstd style\n");
 			type = TYPE_MULTI_THREAD;
 		} else if (IsZstd_Magic(buf) && IsZstd_Skippable(buf + 9)) {
@@ -758,8 +1531,11 @@ size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 		}
 	}
 
-	/* use single thread extraction, when only one thread is there */
-	if (ctx->threadswanted == 1)
+	/* use single thread extraction, when only one thread is there,
+	 * the checksums of version 2 headers are checked by the workers */
+	if (ctx->threadswanted == 1 && !ctx->ring.buf && !ctx->pattern &&
+	    !ctx->fn_write_frame && !ctx->range.end && !ctx->tree &&
+	    (in->size < 16 || MT_frame_hsize(buf) < MT_FRAME_V2SIZE))
 		type = TYPE_SINGLE_THREAD;
 
 	/* single threaded, but with known sizes */
@@ -794,9 +1570,15 @@ size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 		w->in.size = in->size;
 		w->in.allocated = 0;
 		w->ctx = ctx;
+		w->result = 0;
 		w->dctx = ZSTD_createDStream();
 		if (!w->dctx)
 			return ZSTDCB_ERROR(memory_allocation);
+
+		/* init dstream stream */
+		rv = ZSTD_isError(ZSTD_initDStream(w->dctx));
+		if (rv)
+			return ZSTDCB_ERROR(compression_library);
 	}
 
 	/* real multi threaded, init pthread's */
@@ -808,25 +1590,46 @@ size_t ZSTDCB_decompressDCtx(ZSTDCB_DCtx * ctx, ZSTDCB_RdWr_t * rdwr)
 	INIT_LIST_HEAD(&ctx->writelist_busy);
 	INIT_LIST_HEAD(&ctx->writelist_done);
 
-	/* multi threaded */
-	for (t = 0; t < ctx->threads; t++) {
-		cwork_t *wt = &ctx->cwork[t];
-		pthread_create(&wt->pthread, NULL, pt_decompress, wt);
+	if (ctx->pool) {
+		/* run the workers as jobs of the shared pool */
+		if (POOLMT_run(ctx->pool, ctx->weight, pt_decompress_step,
+			       ctx->cwork, sizeof(cwork_t), ctx->threads))
+			retval_of_thread =
+			    (void *)ZSTDCB_ERROR(memory_allocation);
+	} else {
+		/* multi threaded */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *wt = &ctx->cwork[t];
+			pthread_create(&wt->pthread, NULL, pt_decompress, wt);
+		}
+
+		/* wait for all workers */
+		for (t = 0; t < ctx->threads; t++) {
+			cwork_t *wt = &ctx->cwork[t];
+			pthread_join(wt->pthread, 0);
+		}
 	}
 
-	/* wait for all workers */
+	/* collect the results */
 	for (t = 0; t < ctx->threads; t++) {
 		cwork_t *wt = &ctx->cwork[t];
-		void *p = 0;
-		pthread_join(wt->pthread, &p);
-		if (p)
-			retval_of_thread = p;
+		if (wt->result)
+			retval_of_thread = (void *)wt->result;
+		if (wt->in.allocated)
+			free(wt->in.buf);
 	}
 
+	/* the root of the tree hash, compared with the trailer frame */
+	if (ctx->tree && !retval_of_thread)
+		retval_of_thread = (void *)pt_tree(ctx);
+	MT_tree_free(&ctx->leaves);
+
 	/* clean up pthread stuff */
 	pthread_mutex_destroy(&ctx->read_mutex);
 	pthread_mutex_destroy(&ctx->write_mutex);
 	pthread_mutex_destroy(&ctx->error_mutex);
+	MT_range_free(&ctx->range);
+	MT_ring_free(&ctx->ring);
 
 	/* clean up the buffers */
 	while (!list_empty(&ctx->writelist_free)) {
@@ -869,6 +1672,30 @@ size_t ZSTDCB_GetFramesDCtx(ZSTDCB_DCtx * ctx)
 	return ctx->curframe;
 }
 
+size_t ZSTDCB_GetErrorFrameDCtx(ZSTDCB_DCtx * ctx, unsigned long long *offset)
+{
+	if (!ctx)
+		return 0;
+
+	if (offset)
+		*offset = ctx->erroffset;
+
+	return ctx->errframe;
+}
+
+size_t ZSTDCB_GetTreeHashDCtx(ZSTDCB_DCtx * ctx, unsigned long long *root)
+{
+	if (!ctx)
+		return ZSTDCB_ERROR(init_missing);
+	if (!ctx->tree)
+		return 0;
+
+	root[0] = ctx->root[0];
+	root[1] = ctx->root[1];
+
+	return ctx->treeframes;
+}
+
 void ZSTDCB_freeDCtx(ZSTDCB_DCtx * ctx)
 {
 	int t;
@@ -883,9 +1710,34 @@ void ZSTDCB_freeDCtx(ZSTDCB_DCtx * ctx)
 
 	if (ctx->cwork)
 		free(ctx->cwork);
+	free(ctx->bloom.buf);
+	MT_range_free(&ctx->range);
+	MT_tree_free(&ctx->leaves);
+	MT_ring_free(&ctx->ring);
 
 	free(ctx);
 	ctx = 0;
 
 	return;
 }
+
+size_t ZSTDCB_GetFrameInfo(const void *src, size_t size,
+			   unsigned long long *csize, unsigned long long *usize)
+{
+	const BYTE *p = (const BYTE *)src;
+	MT_Frame f;
+	U64 cs, us;
+	int kind = MT_frame_info(p, size, &f, &cs, &us);
+
+	if (kind < 0 || (kind == MT_INFO_DATA && f.version == 1 &&
+			 f.hsize != 12))
+		return ZSTDCB_ERROR(data_error);
+
+	/* version 1: the content size of the zstd frame header */
+	if (kind == MT_INFO_DATA)
+		us = pt_usize(&f, p + f.hsize, size - f.hsize);
+
+	*csize = cs;
+	*usize = us;
+	return (size_t)kind;
+}
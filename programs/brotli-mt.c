@@ -29,17 +29,48 @@
 #define MT_CCtx            BROTLIMT_CCtx
 #define MT_createCCtx      BROTLIMT_createCCtx
 #define MT_compressCCtx    BROTLIMT_compressCCtx
+#define MT_SetMaxLatencyCCtx BROTLIMT_SetMaxLatencyCCtx
+#define MT_SetAffinityCCtx BROTLIMT_SetAffinityCCtx
+#define MT_SetAdaptiveCCtx BROTLIMT_SetAdaptiveCCtx
+#define MT_SetChunkingCCtx BROTLIMT_SetChunkingCCtx
+#define MT_SetDelimiterCCtx BROTLIMT_SetDelimiterCCtx
+#define MT_SetBloomCCtx    BROTLIMT_SetBloomCCtx
+#define MT_SetHeaderCCtx   BROTLIMT_SetHeaderCCtx
+#define MT_SetChecksumCCtx BROTLIMT_SetChecksumCCtx
+#define MT_SetTreeHashCCtx BROTLIMT_SetTreeHashCCtx
+#define MT_GetTreeHashCCtx BROTLIMT_GetTreeHashCCtx
+#define MT_SetVerifyCCtx   BROTLIMT_SetVerifyCCtx
+#define MT_SetSourceCCtx   BROTLIMT_SetSourceCCtx
+#define MT_GetErrorFrameCCtx BROTLIMT_GetErrorFrameCCtx
+#define MT_SetDedupCCtx    BROTLIMT_SetDedupCCtx
 #define MT_GetFramesCCtx   BROTLIMT_GetFramesCCtx
 #define MT_GetInsizeCCtx   BROTLIMT_GetInsizeCCtx
 #define MT_GetOutsizeCCtx  BROTLIMT_GetOutsizeCCtx
+#define MT_GetLatencyAvgCCtx BROTLIMT_GetLatencyAvgCCtx
+#define MT_GetLatencyMaxCCtx BROTLIMT_GetLatencyMaxCCtx
+#define MT_GetMemoryCCtx   BROTLIMT_GetMemoryCCtx
+#define MT_GetStatsCCtx    BROTLIMT_GetStatsCCtx
+#define MT_Stats           BROTLIMT_Stats
 #define MT_freeCCtx        BROTLIMT_freeCCtx
 
 #define MT_DCtx            BROTLIMT_DCtx
 #define MT_createDCtx      BROTLIMT_createDCtx
 #define MT_decompressDCtx  BROTLIMT_decompressDCtx
+#define MT_SetFilterDCtx   BROTLIMT_SetFilterDCtx
+#define MT_SetBloomDCtx    BROTLIMT_SetBloomDCtx
+#define MT_SetRangeDCtx    BROTLIMT_SetRangeDCtx
+#define MT_SetVerifyDCtx   BROTLIMT_SetVerifyDCtx
+#define MT_SetTreeHashDCtx BROTLIMT_SetTreeHashDCtx
+#define MT_GetTreeHashDCtx BROTLIMT_GetTreeHashDCtx
+#define MT_SetPoolDCtx     BROTLIMT_SetPoolDCtx
 #define MT_GetFramesDCtx   BROTLIMT_GetFramesDCtx
 #define MT_GetInsizeDCtx   BROTLIMT_GetInsizeDCtx
 #define MT_GetOutsizeDCtx  BROTLIMT_GetOutsizeDCtx
+#define MT_GetErrorFrameDCtx BROTLIMT_GetErrorFrameDCtx
 #define MT_freeDCtx        BROTLIMT_freeDCtx
+#define MT_GetFrameInfo    BROTLIMT_GetFrameInfo
+#define MT_INFO_PEEK       BROTLIMT_INFO_PEEK
+#define MT_INFO_DATA       BROTLIMT_INFO_DATA
+#define MT_INFO_WINDOW     BROTLIMT_INFO_WINDOW
 
 #include "main.c"
@@ -0,0 +1,77 @@
+
+/**
+ * Copyright (c) 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ */
+
+#include "hybrid-mt.h"
+
+#define METHOD   "hybrid"
+#define PROGNAME "hybrid-mt"
+#define UNZIP    "unhybrid-mt"
+#define ZCAT     "hybridcat-mt"
+#define SUFFIX   ".hyb"
+
+#define LEVEL_DEF          3
+#define LEVEL_MIN          HYBRIDMT_LEVEL_MIN
+#define LEVEL_MAX          HYBRIDMT_LEVEL_MAX
+#define THREAD_MAX         HYBRIDMT_THREAD_MAX
+
+#define MT_isError         HYBRIDMT_isError
+#define MT_getErrorString  HYBRIDMT_getErrorString
+#define MT_Buffer          HYBRIDMT_Buffer
+#define MT_RdWr_t          HYBRIDMT_RdWr_t
+
+#define MT_CCtx            HYBRIDMT_CCtx
+#define MT_createCCtx      HYBRIDMT_createCCtx
+#define MT_compressCCtx    HYBRIDMT_compressCCtx
+#define MT_SetMaxLatencyCCtx HYBRIDMT_SetMaxLatencyCCtx
+#define MT_SetAffinityCCtx HYBRIDMT_SetAffinityCCtx
+#define MT_SetAdaptiveCCtx HYBRIDMT_SetAdaptiveCCtx
+#define MT_SetChunkingCCtx HYBRIDMT_SetChunkingCCtx
+#define MT_SetDelimiterCCtx HYBRIDMT_SetDelimiterCCtx
+#define MT_SetBloomCCtx    HYBRIDMT_SetBloomCCtx
+#define MT_SetHeaderCCtx   HYBRIDMT_SetHeaderCCtx
+#define MT_SetChecksumCCtx HYBRIDMT_SetChecksumCCtx
+#define MT_SetTreeHashCCtx HYBRIDMT_SetTreeHashCCtx
+#define MT_GetTreeHashCCtx HYBRIDMT_GetTreeHashCCtx
+#define MT_SetVerifyCCtx   HYBRIDMT_SetVerifyCCtx
+#define MT_SetSourceCCtx   HYBRIDMT_SetSourceCCtx
+#define MT_GetErrorFrameCCtx HYBRIDMT_GetErrorFrameCCtx
+#define MT_SetDedupCCtx    HYBRIDMT_SetDedupCCtx
+#define MT_SetPolicyCCtx   HYBRIDMT_SetPolicyCCtx
+#define MT_GetFramesCCtx   HYBRIDMT_GetFramesCCtx
+#define MT_GetInsizeCCtx   HYBRIDMT_GetInsizeCCtx
+#define MT_GetOutsizeCCtx  HYBRIDMT_GetOutsizeCCtx
+#define MT_GetLatencyAvgCCtx HYBRIDMT_GetLatencyAvgCCtx
+#define MT_GetLatencyMaxCCtx HYBRIDMT_GetLatencyMaxCCtx
+#define MT_GetMemoryCCtx   HYBRIDMT_GetMemoryCCtx
+#define MT_GetStatsCCtx    HYBRIDMT_GetStatsCCtx
+#define MT_Stats           HYBRIDMT_Stats
+#define MT_freeCCtx        HYBRIDMT_freeCCtx
+
+#define MT_DCtx            HYBRIDMT_DCtx
+#define MT_createDCtx      HYBRIDMT_createDCtx
+#define MT_decompressDCtx  HYBRIDMT_decompressDCtx
+#define MT_SetFilterDCtx   HYBRIDMT_SetFilterDCtx
+#define MT_SetBloomDCtx    HYBRIDMT_SetBloomDCtx
+#define MT_SetRangeDCtx    HYBRIDMT_SetRangeDCtx
+#define MT_SetVerifyDCtx   HYBRIDMT_SetVerifyDCtx
+#define MT_SetTreeHashDCtx HYBRIDMT_SetTreeHashDCtx
+#define MT_GetTreeHashDCtx HYBRIDMT_GetTreeHashDCtx
+#define MT_SetPoolDCtx     HYBRIDMT_SetPoolDCtx
+#define MT_GetFramesDCtx   HYBRIDMT_GetFramesDCtx
+#define MT_GetInsizeDCtx   HYBRIDMT_GetInsizeDCtx
+#define MT_GetOutsizeDCtx  HYBRIDMT_GetOutsizeDCtx
+#define MT_GetErrorFrameDCtx HYBRIDMT_GetErrorFrameDCtx
+#define MT_freeDCtx        HYBRIDMT_freeDCtx
+#define MT_GetFrameInfo    HYBRIDMT_GetFrameInfo
+#define MT_INFO_PEEK       HYBRIDMT_INFO_PEEK
+#define MT_INFO_DATA       HYBRIDMT_INFO_DATA
+#define MT_INFO_WINDOW     HYBRIDMT_INFO_WINDOW
+
+#include "main.c"
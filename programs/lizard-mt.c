@@ -29,17 +29,49 @@
 #define MT_CCtx            LIZARDMT_CCtx
 #define MT_createCCtx      LIZARDMT_createCCtx
 #define MT_compressCCtx    LIZARDMT_compressCCtx
+#define MT_SetMaxLatencyCCtx LIZARDMT_SetMaxLatencyCCtx
+#define MT_SetAffinityCCtx LIZARDMT_SetAffinityCCtx
+#define MT_SetAdaptiveCCtx LIZARDMT_SetAdaptiveCCtx
+#define MT_SetChunkingCCtx LIZARDMT_SetChunkingCCtx
+#define MT_SetDelimiterCCtx LIZARDMT_SetDelimiterCCtx
+#define MT_SetBloomCCtx    LIZARDMT_SetBloomCCtx
+#define MT_SetHeaderCCtx   LIZARDMT_SetHeaderCCtx
+#define MT_SetChecksumCCtx LIZARDMT_SetChecksumCCtx
+#define MT_SetTreeHashCCtx LIZARDMT_SetTreeHashCCtx
+#define MT_GetTreeHashCCtx LIZARDMT_GetTreeHashCCtx
+#define MT_SetVerifyCCtx   LIZARDMT_SetVerifyCCtx
+#define MT_SetSourceCCtx   LIZARDMT_SetSourceCCtx
+#define MT_GetErrorFrameCCtx LIZARDMT_GetErrorFrameCCtx
+#define MT_SetDedupCCtx    LIZARDMT_SetDedupCCtx
+#define MT_SetLevelRangeCCtx LIZARDMT_SetLevelRangeCCtx
 #define MT_GetFramesCCtx   LIZARDMT_GetFramesCCtx
 #define MT_GetInsizeCCtx   LIZARDMT_GetInsizeCCtx
 #define MT_GetOutsizeCCtx  LIZARDMT_GetOutsizeCCtx
+#define MT_GetLatencyAvgCCtx LIZARDMT_GetLatencyAvgCCtx
+#define MT_GetLatencyMaxCCtx LIZARDMT_GetLatencyMaxCCtx
+#define MT_GetMemoryCCtx   LIZARDMT_GetMemoryCCtx
+#define MT_GetStatsCCtx    LIZARDMT_GetStatsCCtx
+#define MT_Stats           LIZARDMT_Stats
 #define MT_freeCCtx        LIZARDMT_freeCCtx
 
 #define MT_DCtx            LIZARDMT_DCtx
 #define MT_createDCtx      LIZARDMT_createDCtx
 #define MT_decompressDCtx  LIZARDMT_decompressDCtx
+#define MT_SetFilterDCtx   LIZARDMT_SetFilterDCtx
+#define MT_SetBloomDCtx    LIZARDMT_SetBloomDCtx
+#define MT_SetRangeDCtx    LIZARDMT_SetRangeDCtx
+#define MT_SetVerifyDCtx   LIZARDMT_SetVerifyDCtx
+#define MT_SetTreeHashDCtx LIZARDMT_SetTreeHashDCtx
+#define MT_GetTreeHashDCtx LIZARDMT_GetTreeHashDCtx
+#define MT_SetPoolDCtx     LIZARDMT_SetPoolDCtx
 #define MT_GetFramesDCtx   LIZARDMT_GetFramesDCtx
 #define MT_GetInsizeDCtx   LIZARDMT_GetInsizeDCtx
 #define MT_GetOutsizeDCtx  LIZARDMT_GetOutsizeDCtx
+#define MT_GetErrorFrameDCtx LIZARDMT_GetErrorFrameDCtx
 #define MT_freeDCtx        LIZARDMT_freeDCtx
+#define MT_GetFrameInfo    LIZARDMT_GetFrameInfo
+#define MT_INFO_PEEK       LIZARDMT_INFO_PEEK
+#define MT_INFO_DATA       LIZARDMT_INFO_DATA
+#define MT_INFO_WINDOW     LIZARDMT_INFO_WINDOW
 
 #include "main.c"
@@ -29,17 +29,49 @@
 #define MT_CCtx            LZ4MT_CCtx
 #define MT_createCCtx      LZ4MT_createCCtx
 #define MT_compressCCtx    LZ4MT_compressCCtx
+#define MT_SetMaxLatencyCCtx LZ4MT_SetMaxLatencyCCtx
+#define MT_SetAffinityCCtx LZ4MT_SetAffinityCCtx
+#define MT_SetAdaptiveCCtx LZ4MT_SetAdaptiveCCtx
+#define MT_SetChunkingCCtx LZ4MT_SetChunkingCCtx
+#define MT_SetDelimiterCCtx LZ4MT_SetDelimiterCCtx
+#define MT_SetBloomCCtx    LZ4MT_SetBloomCCtx
+#define MT_SetHeaderCCtx   LZ4MT_SetHeaderCCtx
+#define MT_SetChecksumCCtx LZ4MT_SetChecksumCCtx
+#define MT_SetTreeHashCCtx LZ4MT_SetTreeHashCCtx
+#define MT_GetTreeHashCCtx LZ4MT_GetTreeHashCCtx
+#define MT_SetVerifyCCtx   LZ4MT_SetVerifyCCtx
+#define MT_SetSourceCCtx   LZ4MT_SetSourceCCtx
+#define MT_GetErrorFrameCCtx LZ4MT_GetErrorFrameCCtx
+#define MT_SetDedupCCtx    LZ4MT_SetDedupCCtx
+#define MT_SetLevelRangeCCtx LZ4MT_SetLevelRangeCCtx
 #define MT_GetFramesCCtx   LZ4MT_GetFramesCCtx
 #define MT_GetInsizeCCtx   LZ4MT_GetInsizeCCtx
 #define MT_GetOutsizeCCtx  LZ4MT_GetOutsizeCCtx
+#define MT_GetLatencyAvgCCtx LZ4MT_GetLatencyAvgCCtx
+#define MT_GetLatencyMaxCCtx LZ4MT_GetLatencyMaxCCtx
+#define MT_GetMemoryCCtx   LZ4MT_GetMemoryCCtx
+#define MT_GetStatsCCtx    LZ4MT_GetStatsCCtx
+#define MT_Stats           LZ4MT_Stats
 #define MT_freeCCtx        LZ4MT_freeCCtx
 
 #define MT_DCtx            LZ4MT_DCtx
 #define MT_createDCtx      LZ4MT_createDCtx
 #define MT_decompressDCtx  LZ4MT_decompressDCtx
+#define MT_SetFilterDCtx   LZ4MT_SetFilterDCtx
+#define MT_SetBloomDCtx    LZ4MT_SetBloomDCtx
+#define MT_SetRangeDCtx    LZ4MT_SetRangeDCtx
+#define MT_SetVerifyDCtx   LZ4MT_SetVerifyDCtx
+#define MT_SetTreeHashDCtx LZ4MT_SetTreeHashDCtx
+#define MT_GetTreeHashDCtx LZ4MT_GetTreeHashDCtx
+#define MT_SetPoolDCtx     LZ4MT_SetPoolDCtx
 #define MT_GetFramesDCtx   LZ4MT_GetFramesDCtx
 #define MT_GetInsizeDCtx   LZ4MT_GetInsizeDCtx
 #define MT_GetOutsizeDCtx  LZ4MT_GetOutsizeDCtx
+#define MT_GetErrorFrameDCtx LZ4MT_GetErrorFrameDCtx
 #define MT_freeDCtx        LZ4MT_freeDCtx
+#define MT_GetFrameInfo    LZ4MT_GetFrameInfo
+#define MT_INFO_PEEK       LZ4MT_INFO_PEEK
+#define MT_INFO_DATA       LZ4MT_INFO_DATA
+#define MT_INFO_WINDOW     LZ4MT_INFO_WINDOW
 
 #include "main.c"
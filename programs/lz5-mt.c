@@ -29,17 +29,49 @@
 #define MT_CCtx            LZ5MT_CCtx
 #define MT_createCCtx      LZ5MT_createCCtx
 #define MT_compressCCtx    LZ5MT_compressCCtx
+#define MT_SetMaxLatencyCCtx LZ5MT_SetMaxLatencyCCtx
+#define MT_SetAffinityCCtx LZ5MT_SetAffinityCCtx
+#define MT_SetAdaptiveCCtx LZ5MT_SetAdaptiveCCtx
+#define MT_SetChunkingCCtx LZ5MT_SetChunkingCCtx
+#define MT_SetDelimiterCCtx LZ5MT_SetDelimiterCCtx
+#define MT_SetBloomCCtx    LZ5MT_SetBloomCCtx
+#define MT_SetHeaderCCtx   LZ5MT_SetHeaderCCtx
+#define MT_SetChecksumCCtx LZ5MT_SetChecksumCCtx
+#define MT_SetTreeHashCCtx LZ5MT_SetTreeHashCCtx
+#define MT_GetTreeHashCCtx LZ5MT_GetTreeHashCCtx
+#define MT_SetVerifyCCtx   LZ5MT_SetVerifyCCtx
+#define MT_SetSourceCCtx   LZ5MT_SetSourceCCtx
+#define MT_GetErrorFrameCCtx LZ5MT_GetErrorFrameCCtx
+#define MT_SetDedupCCtx    LZ5MT_SetDedupCCtx
+#define MT_SetLevelRangeCCtx LZ5MT_SetLevelRangeCCtx
 #define MT_GetFramesCCtx   LZ5MT_GetFramesCCtx
 #define MT_GetInsizeCCtx   LZ5MT_GetInsizeCCtx
 #define MT_GetOutsizeCCtx  LZ5MT_GetOutsizeCCtx
+#define MT_GetLatencyAvgCCtx LZ5MT_GetLatencyAvgCCtx
+#define MT_GetLatencyMaxCCtx LZ5MT_GetLatencyMaxCCtx
+#define MT_GetMemoryCCtx   LZ5MT_GetMemoryCCtx
+#define MT_GetStatsCCtx    LZ5MT_GetStatsCCtx
+#define MT_Stats           LZ5MT_Stats
 #define MT_freeCCtx        LZ5MT_freeCCtx
 
 #define MT_DCtx            LZ5MT_DCtx
 #define MT_createDCtx      LZ5MT_createDCtx
 #define MT_decompressDCtx  LZ5MT_decompressDCtx
+#define MT_SetFilterDCtx   LZ5MT_SetFilterDCtx
+#define MT_SetBloomDCtx    LZ5MT_SetBloomDCtx
+#define MT_SetRangeDCtx    LZ5MT_SetRangeDCtx
+#define MT_SetVerifyDCtx   LZ5MT_SetVerifyDCtx
+#define MT_SetTreeHashDCtx LZ5MT_SetTreeHashDCtx
+#define MT_GetTreeHashDCtx LZ5MT_GetTreeHashDCtx
+#define MT_SetPoolDCtx     LZ5MT_SetPoolDCtx
 #define MT_GetFramesDCtx   LZ5MT_GetFramesDCtx
 #define MT_GetInsizeDCtx   LZ5MT_GetInsizeDCtx
 #define MT_GetOutsizeDCtx  LZ5MT_GetOutsizeDCtx
+#define MT_GetErrorFrameDCtx LZ5MT_GetErrorFrameDCtx
 #define MT_freeDCtx        LZ5MT_freeDCtx
+#define MT_GetFrameInfo    LZ5MT_GetFrameInfo
+#define MT_INFO_PEEK       LZ5MT_INFO_PEEK
+#define MT_INFO_DATA       LZ5MT_INFO_DATA
+#define MT_INFO_WINDOW     LZ5MT_INFO_WINDOW
 
 #include "main.c"
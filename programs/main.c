@@ -16,6 +16,9 @@
  */
 
 #include "platform.h"
+#include "uring.h"
+#include "threading.h"
+#include "crc32-mt.h"
 
 #define MODE_COMPRESS    1	/* -z (default) */
 #define MODE_DECOMPRESS  2	/* -d */
@@ -44,6 +47,109 @@ static int opt_verbose = 1;
 static int opt_bufsize = 0;
 static int opt_timings = 0;
 static int opt_nocrc = 0;
+static int opt_latency = 0;
+static int opt_affinity = MT_AFFINITY_NONE;
+static int opt_minthreads = 0;
+static int opt_adapt = 0;
+static int opt_minlevel = LEVEL_MIN;
+static int opt_maxlevel = LEVEL_MAX;
+static size_t opt_memlimit = 0;
+
+/* content defined chunking in KiB, avg 0 = disabled */
+static int opt_cdcmin = 0;
+static int opt_cdcavg = 0;
+static int opt_cdcmax = 0;
+
+/* record delimiter of the frames, 0 = disabled */
+static char opt_delim[16];
+static int opt_dlen = 0;
+
+/* search mode, only the matching lines are written, 0 = disabled */
+static const char *opt_grep = 0;
+static size_t opt_greplen = 0;
+
+/* byte range of the compressed input, end 0 = up to the end */
+static unsigned long long opt_rstart = 0;
+static unsigned long long opt_rend = 0;
+static int opt_range = 0;
+
+/* version of the frame headers */
+static int opt_header = 1;
+static int opt_checksum = 0;
+
+/* tree hash of the input, written as trailer and checked, 0 = disabled */
+static int opt_tree = 0;
+
+/* round trip of each frame while compressing, 0 = disabled */
+static int opt_verify = 0;
+
+/* read regular files from a mapping, 0 = disabled (pipes are read) */
+static int opt_mmap = 1;
+
+/* io_uring requests in flight per file, 0 = stdio */
+static int opt_uring = 0;
+
+/* O_DIRECT for regular files, past the page cache, 0 = disabled */
+static int opt_direct = 0;
+#define URING_BUFSIZE (1024 * 1024)
+
+/* bloom filter of each frame in KiB, 0 = disabled */
+static int opt_bloom = 0;
+
+/* deduplication window in MiB, 0 = disabled */
+static int opt_dedup = 0;
+
+#ifdef MT_SetPolicyCCtx
+/* codec choice of the hybrid compressor, throughput in MB/s */
+static int opt_policy = HYBRIDMT_POLICY_BALANCED;
+static int opt_mbps = 0;
+static const char *policies[] = { "speed", "balanced", "ratio" };
+#endif
+
+/* long options, which have no short equivalent */
+#define OPT_MAXLATENCY   256
+#define OPT_AFFINITY     257
+#define OPT_MINTHREADS   258
+#define OPT_ADAPT        259
+#define OPT_CDC          260
+#define OPT_DEDUP        261
+#define OPT_POLICY       262
+#define OPT_DELIMITER    263
+#define OPT_GREP         264
+#define OPT_BLOOM        265
+#define OPT_RANGE        266
+#define OPT_HEADER       267
+#define OPT_CHECKSUM     268
+#define OPT_TREE         269
+#define OPT_VERIFY       270
+#define OPT_NOMMAP       271
+#define OPT_URING        272
+#define OPT_DIRECT       273
+static const struct option long_options[] = {
+	{"max-latency", required_argument, 0, OPT_MAXLATENCY},
+	{"affinity", no_argument, 0, OPT_AFFINITY},
+	{"min-threads", required_argument, 0, OPT_MINTHREADS},
+	{"cdc", required_argument, 0, OPT_CDC},
+	{"dedup", optional_argument, 0, OPT_DEDUP},
+	{"delimiter", optional_argument, 0, OPT_DELIMITER},
+	{"grep", required_argument, 0, OPT_GREP},
+	{"bloom", optional_argument, 0, OPT_BLOOM},
+	{"range", required_argument, 0, OPT_RANGE},
+	{"header", required_argument, 0, OPT_HEADER},
+	{"checksum", no_argument, 0, OPT_CHECKSUM},
+	{"tree", no_argument, 0, OPT_TREE},
+	{"verify", no_argument, 0, OPT_VERIFY},
+	{"no-mmap", no_argument, 0, OPT_NOMMAP},
+	{"io-uring", optional_argument, 0, OPT_URING},
+	{"direct", no_argument, 0, OPT_DIRECT},
+#ifdef MT_SetPolicyCCtx
+	{"policy", required_argument, 0, OPT_POLICY},
+#endif
+#ifdef MT_SetLevelRangeCCtx
+	{"adapt", optional_argument, 0, OPT_ADAPT},
+#endif
+	{0, 0, 0, 0}
+};
 
 static char *progname;
 static char *opt_filename;
@@ -59,6 +165,10 @@ static size_t bytes_written = 0;
 /* when set, do not change fout */
 static int global_fout = 0;
 
+/* asynchronous reading and writing of fin and fout, see rings_start() */
+static struct uring *rring = 0;
+static struct uring *wring = 0;
+
 static MT_CCtx *cctx = 0;
 static MT_DCtx *dctx = 0;
 
@@ -68,9 +178,6 @@ static struct timeval tms, tme, tm;
 /* for -l with verbose > 1 */
 static time_t mtime;
 static unsigned int crc = 0;
-static unsigned int crc32_table[1][256];
-static unsigned int crc32(const unsigned char *buf, size_t size,
-			  unsigned int crc);
 
 static void panic(const char *msg)
 {
@@ -141,11 +248,70 @@ static void usage(void)
 	       "\n  -V    Show version information and quit."
 	       "\n"
 	       "\n Additional Options:"
-	       "\n  -T N  Set number of (de)compression threads (def: #cores)."
+	       "\n  -T N  Set number of (de)compression threads (def: auto)."
+	       "\n        `auto` or 0 uses the cores, which are usable for us."
 	       "\n  -b N  Set input chunksize to N MiB (default: auto)."
 	       "\n  -i N  Set number of iterations for testing (default: 1)."
 	       "\n  -B    Print timings and memory usage to stderr."
 	       "\n  -C    Disable crc32 calculation in verbose listing mode."
+	       "\n  --max-latency=MS"
+	       "\n        Write a frame, when its first input byte waits longer"
+	       "\n        than MS milliseconds (for log streaming, default: off)."
+	       "\n  --affinity"
+	       "\n        Pin the compression threads to the physical cores of"
+	       "\n        all numa nodes first, then to their SMT siblings."
+	       "\n  --min-threads=N"
+	       "\n        Park compression threads, while they mostly wait for"
+	       "\n        reading or writing, down to N active threads."
+	       "\n  --cdc=AVG[,MIN,MAX]"
+	       "\n        Cut the frames by content, AVG KiB on average, so that"
+	       "\n        unchanged regions give the same frames again."
+	       "\n  --delimiter[=STR]"
+	       "\n        Cut the frames only behind STR (default: \\n), so"
+	       "\n        each frame holds whole records, \\t \\0 \\xHH work."
+	       "\n  --grep=STRING"
+	       "\n        Decompress to stdout, but write only the lines, which"
+	       "\n        contain STRING, the search runs on all threads."
+	       "\n  --bloom[=KiB]"
+	       "\n        Write a bloom filter of KiB for each frame, so that"
+	       "\n        --grep can skip frames (default: 16, max: 1024)."
+	       "\n  --header=VERSION"
+	       "\n        Version of the frame headers, 2 has 64 bit sizes and"
+	       "\n        the uncompressed size of each frame (default: 1)."
+	       "\n  --checksum"
+	       "\n        Store a checksum of each frame in its header, which"
+	       "\n        is checked in parallel (selects --header=2)."
+	       "\n  --tree"
+	       "\n        Write the tree hash of the input as trailer, while"
+	       "\n        decompressing it is checked, -v prints the root."
+	       "\n  --verify"
+	       "\n        Decode each frame again while compressing, so the"
+	       "\n        source is only removed after a right round trip."
+	       "\n  --no-mmap"
+	       "\n        Read regular files into the buffers, instead of"
+	       "\n        compressing them straight from a memory mapping."
+	       "\n  --io-uring[=N]"
+	       "\n        Keep N reads of 1 MiB ahead and N writes behind in"
+	       "\n        flight, for regular files on linux (default: 4)."
+	       "\n  --direct"
+	       "\n        Read and write regular files with O_DIRECT, so they"
+	       "\n        do not push other data out of the page cache."
+	       "\n  --range=START[,END]"
+	       "\n        Decompress to stdout the frames, which start within"
+	       "\n        the bytes START to END-1 of the compressed file."
+	       "\n  --dedup[=MiB]"
+	       "\n        Write repeated chunks of the last MiB of input as"
+	       "\n        a reference to the earlier ones (default: 256)."
+#ifdef MT_SetPolicyCCtx
+	       "\n  --policy=NAME[,MBS]"
+	       "\n        Codec choice per chunk: speed, balanced or ratio."
+	       "\n        With MBS, faster codecs are used below MBS MB/s."
+#endif
+#ifdef MT_SetLevelRangeCCtx
+	       "\n  --adapt[=MIN,MAX]"
+	       "\n        Raise the level, while the output is too slow, and"
+	       "\n        lower it again, while the compression is too slow."
+#endif
 	       "\n"
 	       "\n If invoked as '%s', default action is to compress."
 	       "\n             as '%s',  default action is to decompress."
@@ -167,10 +333,57 @@ static void headline(void)
 		fprintf(stderr, "Level;Threads;InSize;OutSize;Frames\n");
 }
 
+/**
+ * ReadStream() - read, what is available
+ *
+ * Used for --max-latency, returns 1 when no input came in for some time,
+ * so the library can decide to flush the current frame.
+ */
+static int ReadStream(FILE * fd, MT_Buffer * in)
+{
+	int msec = opt_latency / 4 ? opt_latency / 4 : 1;
+	ssize_t done;
+	int rv;
+
+	rv = waitinput(fileno(fd), msec);
+	if (rv < 0)
+		return -1;
+
+	if (rv == 0) {
+		in->size = 0;
+		return 1;
+	}
+
+	do {
+		done = read(fileno(fd), in->buf, in->size);
+	} while (done == -1 && errno == EINTR);
+
+	if (done < 0)
+		return -1;
+
+	in->size = done;
+
+	return 0;
+}
+
 static int ReadData(void *arg, MT_Buffer * in)
 {
 	FILE *fd = (FILE *) arg;
-	size_t done = fread(in->buf, 1, in->size, fd);
+	size_t done;
+
+	if (opt_latency && opt_mode == MODE_COMPRESS)
+		return ReadStream(fd, in);
+
+	if (rring) {
+		ssize_t rv = uring_read(rring, in->buf, in->size);
+
+		if (rv < 0)
+			return -1;
+		in->size = (size_t)rv;
+		return 0;
+	}
+
+	done = fread(in->buf, 1, in->size, fd);
 	in->size = done;
 
 	if (opt_mode == MODE_LIST && opt_verbose)
@@ -179,24 +392,470 @@ static int ReadData(void *arg, MT_Buffer * in)
 	return 0;
 }
 
+/* crc32 of the decoded buffers, done by the workers in CrcFilter() */
+struct crc_part {
+	void *buf;
+	size_t size;
+	unsigned int crc;
+};
+
+static struct crc_part *crc_parts = 0;
+static size_t crc_count = 0;
+static size_t crc_allocated = 0;
+static pthread_mutex_t crc_mutex;
+
+/**
+ * CrcFilter() - crc32 of some decoded output
+ *
+ * Runs within the workers of the library, so the crc32 of the frames is
+ * done in parallel. The result is kept by the address of the buffer,
+ * until WriteData() gets it in the order of the frames.
+ */
+static int CrcFilter(void *arg, MT_Buffer * out)
+{
+	unsigned int c = MT_crc32(0, out->buf, out->size);
+	size_t i;
+
+	(void)arg;
+	pthread_mutex_lock(&crc_mutex);
+	for (i = 0; i < crc_count; i++)
+		if (crc_parts[i].buf == out->buf)
+			break;
+	if (i == crc_count && crc_count == crc_allocated) {
+		size_t n = crc_allocated ? crc_allocated * 2 : 64;
+		void *p = realloc(crc_parts, n * sizeof(*crc_parts));
+
+		/* WriteData() does it itself then */
+		if (!p) {
+			pthread_mutex_unlock(&crc_mutex);
+			return 0;
+		}
+		crc_parts = (struct crc_part *)p;
+		crc_allocated = n;
+	}
+	if (i == crc_count)
+		crc_count++;
+	crc_parts[i].buf = out->buf;
+	crc_parts[i].size = out->size;
+	crc_parts[i].crc = c;
+	pthread_mutex_unlock(&crc_mutex);
+
+	return 0;
+}
+
+/**
+ * crc_write() - append the crc32 of a written buffer to the one of the file
+ */
+static unsigned int crc_write(MT_Buffer * out)
+{
+	size_t i;
+
+	pthread_mutex_lock(&crc_mutex);
+	for (i = 0; i < crc_count; i++) {
+		if (crc_parts[i].buf == out->buf &&
+		    crc_parts[i].size == out->size) {
+			unsigned int c = crc_parts[i].crc;
+
+			crc_parts[i] = crc_parts[--crc_count];
+			pthread_mutex_unlock(&crc_mutex);
+			return MT_crc32_combine(crc, c, out->size);
+		}
+	}
+	pthread_mutex_unlock(&crc_mutex);
+
+	return MT_crc32(crc, out->buf, out->size);
+}
+
 static int WriteData(void *arg, MT_Buffer * out)
 {
 	FILE *fd = (FILE *) arg;
-	ssize_t done = fwrite(out->buf, 1, out->size, fd);
+	ssize_t done;
+
+	/* the ring writes behind, at the offsets of the calls */
+	if (wring)
+		return uring_write(wring, out->buf, out->size) ? -1 : 0;
+
+	done = fwrite(out->buf, 1, out->size, fd);
 
 	/* generate crc32 of uncompressed file */
-	if (opt_mode == MODE_LIST && opt_verbose > 1)
-		crc = crc32(out->buf, out->size, crc);
-	/* printf("crc for %zu bytes, %8x\n", out->size, crc); */
+	if (opt_mode == MODE_LIST && opt_verbose > 1 && !opt_nocrc)
+		crc = crc_write(out);
 
 	out->size = done;
 
+	/* the frame should reach the reader now */
+	if (opt_latency && opt_mode == MODE_COMPRESS)
+		fflush(fd);
+
 	if (opt_mode == MODE_LIST && opt_verbose)
 		bytes_written += done;
 
 	return 0;
 }
 
+/* line of the search mode, which spans the output buffers */
+static char *grep_line = 0;
+static size_t grep_size = 0;
+static size_t grep_allocated = 0;
+
+/**
+ * grep_find() - first match of the search string in buf, or zero
+ *
+ * memchr() is vectorized by the C library, so it looks for the first
+ * byte of the string, the rest is compared then.
+ */
+static const char *grep_find(const char *buf, size_t size)
+{
+	const char *end = buf + size;
+
+	while ((size_t)(end - buf) >= opt_greplen) {
+		const char *p = memchr(buf, opt_grep[0],
+				       (size_t)(end - buf) - opt_greplen + 1);
+		if (!p)
+			return 0;
+		if (!memcmp(p + 1, opt_grep + 1, opt_greplen - 1))
+			return p;
+		buf = p + 1;
+	}
+
+	return 0;
+}
+
+/**
+ * GrepFilter() - keep only the matching lines of some decoded output
+ *
+ * Runs within the workers of the library. The partial lines at the
+ * begin and the end of the buffer are kept, WriteGrep() joins them
+ * with the ones of the neighbouring buffers.
+ */
+static int GrepFilter(void *arg, MT_Buffer * out)
+{
+	char *buf = (char *)out->buf;
+	char *end = buf + out->size;
+	char *first, *last, *dst, *p;
+
+	(void)arg;
+	first = memchr(buf, '\n', out->size);
+	if (!first)
+		return 0;
+	for (last = end - 1; *last != '\n'; last--) ;
+
+	/* the complete lines are between first and last */
+	dst = p = first + 1;
+	while (p <= last) {
+		char *m = (char *)grep_find(p, (size_t)(last + 1 - p));
+		char *s, *e;
+
+		if (!m)
+			break;
+		for (s = m; s > p && s[-1] != '\n'; s--) ;
+		e = memchr(m, '\n', (size_t)(last + 1 - m));
+		memmove(dst, s, (size_t)(e + 1 - s));
+		dst += e + 1 - s;
+		p = e + 1;
+	}
+
+	memmove(dst, last + 1, (size_t)(end - last - 1));
+	dst += end - last - 1;
+	out->size = (size_t)(dst - buf);
+
+	return 0;
+}
+
+/* append to the line, which spans the output buffers */
+static int grep_append(const char *buf, size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	if (grep_size + size > grep_allocated) {
+		size_t n = (grep_size + size) * 2;
+		char *line = realloc(grep_line, n);
+
+		if (!line)
+			return -3;
+		grep_line = line;
+		grep_allocated = n;
+	}
+	memcpy(grep_line + grep_size, buf, size);
+	grep_size += size;
+
+	return 0;
+}
+
+/* write the spanning line, if it matches */
+static int grep_flush(FILE * fd)
+{
+	if (grep_size && grep_find(grep_line, grep_size) &&
+	    fwrite(grep_line, 1, grep_size, fd) != grep_size)
+		return -1;
+	grep_size = 0;
+
+	return 0;
+}
+
+/**
+ * WriteGrep() - write the filtered output in the search mode
+ *
+ * The buffers come in order here, only the line at the border of two
+ * buffers needs to be searched again.
+ */
+static int WriteGrep(void *arg, MT_Buffer * out)
+{
+	FILE *fd = (FILE *) arg;
+	char *buf = (char *)out->buf;
+	char *end = buf + out->size;
+	char *first, *last;
+
+	first = memchr(buf, '\n', out->size);
+	if (!first)
+		return grep_append(buf, out->size);
+	if (grep_append(buf, (size_t)(first + 1 - buf)) || grep_flush(fd))
+		return -1;
+
+	for (last = end - 1; *last != '\n'; last--) ;
+	if (fwrite(first + 1, 1, (size_t)(last - first), fd) !=
+	    (size_t)(last - first))
+		return -1;
+
+	return grep_append(last + 1, (size_t)(end - last - 1));
+}
+
+/**
+ * set_chunking() - frame boundaries by content or by records
+ *
+ * return: 0 for ok, or error code
+ */
+static size_t set_chunking(MT_CCtx * cctx)
+{
+	/* the input size is the max chunk size then */
+	if (opt_dlen)
+		return MT_SetDelimiterCCtx(cctx, opt_delim, opt_dlen, 25);
+	if (opt_cdcavg)
+		return MT_SetChunkingCCtx(cctx, opt_cdcmin << 10,
+					  opt_cdcavg << 10, opt_cdcmax << 10);
+
+	return 0;
+}
+
+/**
+ * set_options() - apply all settings of the command line to cctx
+ * - threads is the count of cctx, src is the mapping of the input or zero
+ *
+ * return: 0 for ok, or error code
+ */
+static size_t set_options(MT_CCtx * cctx, int threads, const void *src,
+			  size_t srcsize)
+{
+	size_t ret;
+
+	ret = set_chunking(cctx);
+	if (MT_isError(ret))
+		return ret;
+
+	if (opt_latency) {
+		ret = MT_SetMaxLatencyCCtx(cctx, opt_latency);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_affinity) {
+		ret = MT_SetAffinityCCtx(cctx, opt_affinity);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_dedup) {
+		ret = MT_SetDedupCCtx(cctx, opt_dedup);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_bloom) {
+		ret = MT_SetBloomCCtx(cctx, opt_bloom << 10);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_header != 1) {
+		ret = MT_SetHeaderCCtx(cctx, opt_header);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_checksum) {
+		ret = MT_SetChecksumCCtx(cctx, 1);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_tree) {
+		ret = MT_SetTreeHashCCtx(cctx, 2);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_verify) {
+		ret = MT_SetVerifyCCtx(cctx, 1);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	if (opt_minthreads) {
+		ret = MT_SetAdaptiveCCtx(cctx, opt_minthreads < threads ?
+					 opt_minthreads : threads);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+#ifdef MT_SetPolicyCCtx
+	ret = MT_SetPolicyCCtx(cctx, opt_policy, opt_mbps);
+	if (MT_isError(ret))
+		return ret;
+#endif
+
+#ifdef MT_SetLevelRangeCCtx
+	if (opt_adapt) {
+		ret = MT_SetLevelRangeCCtx(cctx, opt_minlevel, opt_maxlevel);
+		if (MT_isError(ret))
+			return ret;
+	}
+#endif
+
+	if (src) {
+		ret = MT_SetSourceCCtx(cctx, src, srcsize);
+		if (MT_isError(ret))
+			return ret;
+	}
+
+	return 0;
+}
+
+/**
+ * create_cctx() - the compression context with all settings
+ * - it stays below 3/4 of the memory limit, by using less threads, the
+ *   estimate is taken after all settings, they are applied again to the
+ *   smaller context
+ * - opt_threads is kept for the next file, *threads gets the count used
+ *
+ * return: 0 for ok, or errmsg on error
+ */
+static const char *create_cctx(const void *src, size_t srcsize, int *threads)
+{
+	size_t ret, mem, limit = opt_memlimit / 4 * 3;
+
+	*threads = opt_threads;
+	for (;;) {
+		cctx = MT_createCCtx(*threads, opt_level, opt_bufsize);
+		if (!cctx)
+			return "Allocating compression context failed!";
+
+		ret = set_options(cctx, *threads, src, srcsize);
+		if (MT_isError(ret)) {
+			MT_freeCCtx(cctx);
+			cctx = 0;
+			return MT_getErrorString(ret);
+		}
+
+		if (!opt_memlimit || *threads == 1)
+			break;
+		mem = MT_GetMemoryCCtx(cctx);
+		if (MT_isError(mem) || mem <= limit)
+			break;
+
+		/* the shared part does not shrink, so it is checked again */
+		MT_freeCCtx(cctx);
+		cctx = 0;
+		*threads = (int)((unsigned long long)*threads * limit / mem);
+		if (*threads < 1)
+			*threads = 1;
+	}
+
+	if (*threads != opt_threads && opt_verbose > 1)
+		fprintf(stderr, "Memory limit of %lu MiB, using %d"
+			" threads instead of %d\n",
+			(unsigned long)(opt_memlimit >> 20), *threads,
+			opt_threads);
+
+	return 0;
+}
+
+/**
+ * frame_error() - error message, with the frame of a wrong checksum
+ * or a failed round trip
+ */
+static const char *frame_error(size_t ret, size_t frame,
+			       unsigned long long offset, char *buf,
+			       size_t size)
+{
+	if (!frame)
+		return MT_getErrorString(ret);
+
+	snprintf(buf, size, "%s (frame %lu at offset %llu)",
+		 MT_getErrorString(ret), (unsigned long)frame, offset);
+	return buf;
+}
+
+/**
+ * print_tree() - the root of the tree hash, for -v
+ */
+static void print_tree(size_t frames, const unsigned long long *root)
+{
+	fprintf(stderr, "Tree hash: %016llx%016llx (%lu frames)\n",
+		root[0], root[1], (unsigned long)frames);
+}
+
+/**
+ * rings_start() - asynchronous reading of in and writing of out
+ * - only for --io-uring or --direct and regular files, the others use
+ *   stdio, the listing counts its bytes in ReadData() and WriteData()
+ * - --direct has 4 requests in flight by default
+ * - in or out may be zero
+ */
+static void rings_start(FILE * in, FILE * out)
+{
+	int depth = opt_uring ? opt_uring : 4;
+	off_t pos;
+
+	if ((!opt_uring && !opt_direct) || opt_latency ||
+	    opt_mode == MODE_LIST)
+		return;
+
+	if (in && (pos = ftello(in)) >= 0)
+		rring = uring_open(fileno(in), pos, 0, depth, URING_BUFSIZE,
+				   opt_direct);
+
+	if (out && fflush(out) == 0 && (pos = ftello(out)) >= 0)
+		wring = uring_open(fileno(out), pos, 1, depth, URING_BUFSIZE,
+				   opt_direct);
+}
+
+/**
+ * rings_stop() - wait for the writes, the files go on behind the data
+ *
+ * return: 0 for ok, or -1 when a write failed
+ */
+static int rings_stop(FILE * in, FILE * out)
+{
+	off_t pos;
+	int rv = 0;
+
+	if (rring) {
+		uring_close(rring, &pos);
+		fseeko(in, pos, SEEK_SET);
+		rring = 0;
+	}
+
+	if (wring) {
+		rv = uring_close(wring, &pos);
+		if (fseeko(out, pos, SEEK_SET))
+			rv = -1;
+		wring = 0;
+	}
+
+	return rv;
+}
+
 /**
  * compress() - compress data from fin to fout
  *
@@ -204,9 +863,15 @@ static int WriteData(void *arg, MT_Buffer * out)
  */
 static const char *do_compress(FILE * in, FILE * out)
 {
+	static char errbuf[128];
 	static int first = 1;
+	unsigned long long root[2], offset;
+	size_t frame, mapsize = 0, srcsize = 0;
+	void *map = 0, *src = 0;
+	const char *errmsg;
 	MT_RdWr_t rdwr;
 	size_t ret;
+	int threads;
 
 	if (first) {
 		headline();
@@ -222,24 +887,129 @@ static const char *do_compress(FILE * in, FILE * out)
 	rdwr.arg_read = (void *)in;
 	rdwr.arg_write = (void *)out;
 
+	/* the workers take their chunks from the mapping of regular files */
+	if (opt_mmap && !opt_latency && !opt_direct)
+		map = mapinput(fileno(in), &mapsize);
+	if (map) {
+		off_t pos = ftello(in);
+
+		if (pos < 0 || (unsigned long long)pos > mapsize) {
+			unmapinput(map, mapsize);
+			map = 0;
+		} else {
+			src = (char *)map + pos;
+			srcsize = mapsize - (size_t)pos;
+		}
+	}
+
 	/* 2) create compression context */
-	cctx = MT_createCCtx(opt_threads, opt_level, opt_bufsize);
-	if (!cctx)
-		return "Allocating compression context failed!";
+	errmsg = create_cctx(src, srcsize, &threads);
+	if (errmsg) {
+		if (map)
+			unmapinput(map, mapsize);
+		return errmsg;
+	}
 
 	/* 3) compress */
+	rings_start(map ? 0 : in, out);
 	ret = MT_compressCCtx(cctx, &rdwr);
-	if (MT_isError(ret))
-		return MT_getErrorString(ret);
+	if (map)
+		unmapinput(map, mapsize);
+	if (rings_stop(in, out) && !MT_isError(ret))
+		return "Writing the output file failed!";
+	if (MT_isError(ret)) {
+		frame = MT_GetErrorFrameCCtx(cctx, &offset);
+		return frame_error(ret, frame, offset, errbuf, sizeof(errbuf));
+	}
 
 	/* 4) get compression statistic */
 	if (opt_timings && opt_verbose && opt_mode == MODE_COMPRESS)
 		fprintf(stderr, "%d;%d;%lu;%lu;%lu\n",
-			opt_level, opt_threads,
+			opt_level, threads,
 			(unsigned long)MT_GetInsizeCCtx(cctx),
 			(unsigned long)MT_GetOutsizeCCtx(cctx),
 			(unsigned long)MT_GetFramesCCtx(cctx));
 
+	if (opt_tree && opt_verbose > 1)
+		print_tree(MT_GetTreeHashCCtx(cctx, root), root);
+
+	if (opt_latency && opt_verbose > 1)
+		fprintf(stderr, "Latency: avg %lu us, max %lu us\n",
+			(unsigned long)MT_GetLatencyAvgCCtx(cctx),
+			(unsigned long)MT_GetLatencyMaxCCtx(cctx));
+
+	if (opt_minthreads && opt_verbose > 1) {
+		MT_Stats st;
+		unsigned long long all;
+
+		MT_GetStatsCCtx(cctx, &st);
+		all = st.busy_us + st.read_us + st.write_us;
+		if (!all)
+			all = 1;
+		fprintf(stderr, "Threads: %d of %d active, parked %lu,"
+			" unparked %lu, busy %d%%, read %d%%, write %d%%\n",
+			st.active, st.threads, (unsigned long)st.parked,
+			(unsigned long)st.unparked,
+			(int)(st.busy_us * 100 / all),
+			(int)(st.read_us * 100 / all),
+			(int)(st.write_us * 100 / all));
+	}
+
+	if (opt_verbose > 1) {
+		MT_Stats st;
+
+		/* incompressible and repeated frames */
+		MT_GetStatsCCtx(cctx, &st);
+		if (st.stored)
+			fprintf(stderr, "Stored: %lu of %lu frames\n",
+				(unsigned long)st.stored,
+				(unsigned long)MT_GetFramesCCtx(cctx));
+		if (st.dedup)
+			fprintf(stderr, "Dedup: %lu of %lu frames\n",
+				(unsigned long)st.dedup,
+				(unsigned long)MT_GetFramesCCtx(cctx));
+	}
+
+#ifdef MT_SetPolicyCCtx
+	if (opt_verbose > 1) {
+		MT_Stats st;
+		static const char *codecs[] = { "stored", "snappy", "lz4",
+			"zstd"
+		};
+		int c;
+
+		/* written frames and speed per codec */
+		MT_GetStatsCCtx(cctx, &st);
+		fprintf(stderr, "Codecs:");
+		for (c = 0; c < HYBRIDMT_CODEC_MAX; c++)
+			if (st.codecs[c])
+				fprintf(stderr, " %s:%lu", codecs[c],
+					(unsigned long)st.codecs[c]);
+		fprintf(stderr, "\n");
+		for (c = HYBRIDMT_CODEC_SNAPPY; c < HYBRIDMT_CODEC_MAX; c++)
+			if (st.speed[c])
+				fprintf(stderr, "Speed of %s: %lu MB/s per"
+					" thread\n", codecs[c],
+					(unsigned long)st.speed[c]);
+	}
+#endif
+
+#ifdef MT_SetLevelRangeCCtx
+	if (opt_adapt && opt_verbose > 1) {
+		MT_Stats st;
+		int l;
+
+		/* written frames per level */
+		MT_GetStatsCCtx(cctx, &st);
+		fprintf(stderr, "Levels:");
+		for (l = LEVEL_MIN; l <= LEVEL_MAX; l++)
+			if (st.levels[l])
+				fprintf(stderr, " %d:%lu", l,
+					(unsigned long)st.levels[l]);
+		fprintf(stderr, "\n");
+	}
+#endif
+
 	MT_freeCCtx(cctx);
 
 	return 0;
@@ -252,7 +1022,10 @@ static const char *do_compress(FILE * in, FILE * out)
  */
 static const char *do_decompress(FILE * in, FILE * out)
 {
+	static char errbuf[128];
 	static int first = 1;
+	unsigned long long root[2], offset;
+	size_t frame;
 	MT_RdWr_t rdwr;
 	size_t ret;
 
@@ -275,10 +1048,80 @@ static const char *do_decompress(FILE * in, FILE * out)
 	if (!dctx)
 		return "Allocating decompression context failed!";
 
-	/* 3) compress */
+	/* search mode, the workers do the filtering */
+	if (opt_grep) {
+		rdwr.fn_write = WriteGrep;
+		ret = MT_SetFilterDCtx(dctx, GrepFilter, 0);
+		if (MT_isError(ret))
+			return MT_getErrorString(ret);
+		ret = MT_SetBloomDCtx(dctx, opt_grep, (int)opt_greplen);
+		if (MT_isError(ret))
+			return MT_getErrorString(ret);
+		grep_size = 0;
+	}
+
+	/* verbose listing, the workers do the crc32 */
+	if (opt_mode == MODE_LIST && opt_verbose > 1 && !opt_nocrc) {
+		static int crc_init = 0;
+
+		if (!crc_init) {
+			MT_crc32_init();
+			pthread_mutex_init(&crc_mutex, NULL);
+			crc_init = 1;
+		}
+		crc_count = 0;
+		ret = MT_SetFilterDCtx(dctx, CrcFilter, 0);
+		if (MT_isError(ret))
+			return MT_getErrorString(ret);
+	}
+
+	/* testing mode, the output is only checked */
+	if (opt_mode == MODE_TEST) {
+		ret = MT_SetVerifyDCtx(dctx, 1);
+		if (MT_isError(ret))
+			return MT_getErrorString(ret);
+	}
+
+	/* the tree hash is checked against the trailer */
+	if (opt_tree) {
+		ret = MT_SetTreeHashDCtx(dctx, 1);
+		if (MT_isError(ret))
+			return MT_getErrorString(ret);
+	}
+
+	/* split mode, the input begins at the range */
+	if (opt_range) {
+		if (opt_rstart && fseeko(in, (off_t)opt_rstart, SEEK_SET)) {
+			unsigned long long skip = opt_rstart;
+			char buf[4096];
+
+			while (skip) {
+				size_t n = skip < sizeof(buf) ? skip : sizeof(buf);
+				if (fread(buf, 1, n, in) != n)
+					break;
+				skip -= n;
+			}
+		}
+		ret = MT_SetRangeDCtx(dctx, opt_rstart, opt_rend);
+		if (MT_isError(ret))
+			return MT_getErrorString(ret);
+	}
+
+	/* 3) decompress, only the plain output is written by the ring */
+	rings_start(in, opt_mode == MODE_DECOMPRESS && !opt_grep ? out : 0);
 	ret = MT_decompressDCtx(dctx, &rdwr);
-	if (MT_isError(ret))
-		return MT_getErrorString(ret);
+	if (rings_stop(in, out) && !MT_isError(ret))
+		return "Writing the output file failed!";
+	if (MT_isError(ret)) {
+		frame = MT_GetErrorFrameDCtx(dctx, &offset);
+		return frame_error(ret, frame, offset, errbuf, sizeof(errbuf));
+	}
+
+	/* the last line may have no newline */
+	if (opt_grep && grep_size && grep_find(grep_line, grep_size)) {
+		if (grep_flush(out) || fputc('\n', out) == EOF)
+			return "Writing the search result failed!";
+	}
 
 	/* 4) get decompression statistic */
 	if (opt_timings && opt_verbose && opt_mode == MODE_DECOMPRESS)
@@ -288,11 +1131,105 @@ static const char *do_decompress(FILE * in, FILE * out)
 			(unsigned long)MT_GetOutsizeDCtx(dctx),
 			(unsigned long)MT_GetFramesDCtx(dctx));
 
+	if (opt_tree && opt_verbose > 1)
+		print_tree(MT_GetTreeHashDCtx(dctx, root), root);
+
 	MT_freeDCtx(dctx);
 
 	return 0;
 }
 
+/**
+ * decode_rest() - decompress the input from offset pos on for listing
+ *
+ * return: 0 for ok, or errmsg on error
+ */
+static const char *decode_rest(FILE * in, FILE * out, off_t pos)
+{
+	const char *msg;
+
+	opt_range = 1;
+	opt_rstart = (unsigned long long)pos;
+	opt_rend = 0;
+	msg = do_decompress(in, out);
+	opt_range = 0;
+	opt_rstart = 0;
+
+	return msg;
+}
+
+/**
+ * do_list() - list a file by the headers of its frames
+ *
+ * Only the headers are read, the data of the frames is skipped with
+ * fseeko(), so the sizes are known in a few milliseconds. At the first
+ * frame, which does not tell its uncompressed size, the rest is decoded
+ * as before. So does a stream without our frames, a pipe and -lv, which
+ * needs the crc32 of the data. With -lvv each frame is printed.
+ *
+ * return: 0 for ok, or errmsg on error
+ */
+static const char *do_list(FILE * in, FILE * out)
+{
+	static const char *kinds[] = {
+		"data", "bloom", "window", "reference", "skippable", "tree"
+	};
+	unsigned char buf[MT_INFO_PEEK];
+	unsigned long long csize, usize;
+	size_t n, kind, frames = 0;
+	off_t base, end, pos = 0;
+	int dedup = 0;
+
+	/* pipes are decoded */
+	base = ftello(in);
+	if (base < 0 || fseeko(in, 0, SEEK_END) || (end = ftello(in)) < 0)
+		return do_decompress(in, out);
+	end -= base;
+
+	if (opt_verbose > 2)
+		printf("%8s %20s %20s %20s %s\n", "frame", "offset",
+		       "compressed", "uncompressed", "type");
+
+	while (pos < end) {
+		if (fseeko(in, base + pos, SEEK_SET))
+			return "Seeking within the input failed!";
+		n = fread(buf, 1, sizeof(buf), in);
+		kind = MT_GetFrameInfo(buf, n, &csize, &usize);
+		if (MT_isError(kind) || usize == (unsigned long long)-1)
+			break;
+		if (csize > (unsigned long long)(end - pos))
+			return "Unexpected end of input!";
+		if (opt_verbose > 2)
+			printf("%8lu %20llu %20llu %20llu %s\n",
+			       (unsigned long)frames, (unsigned long long)pos,
+			       csize, usize, kinds[kind]);
+		if (kind == MT_INFO_WINDOW)
+			dedup = 1;
+		bytes_written += (size_t)usize;
+		pos += (off_t)csize;
+		frames++;
+	}
+	bytes_read = (size_t)pos;
+	if (pos == end && (opt_verbose < 2 || opt_nocrc))
+		return 0;
+
+	/* decode the rest, or all of it for the crc32 */
+	if (dedup || pos == 0 || (opt_verbose > 1 && !opt_nocrc)) {
+		bytes_written = bytes_read = 0;
+		pos = 0;
+	}
+	if (opt_verbose > 2 && pos < end)
+		printf("%8s %20llu %20llu %20s %s\n", "-",
+		       (unsigned long long)pos,
+		       (unsigned long long)(end - pos), "-", "decoded");
+	if (fseeko(in, base, SEEK_SET))
+		return "Seeking within the input failed!";
+	if (pos == 0)
+		return do_decompress(in, out);
+
+	return decode_rest(in, out, base + pos);
+}
+
 static int has_suffix(const char *filename, const char *suffix)
 {
 	int flen = strlen(filename);
@@ -344,40 +1281,6 @@ static char *remove_suffix(const char *filename)
 	return newname;
 }
 
-static unsigned int crc32(const unsigned char *buf, size_t size,
-			  unsigned int crc)
-{
-	static int initdone = 0;
-
-	if (opt_nocrc)
-		return 0;
-
-	if (!initdone) {
-		unsigned int b, i, r, poly32 = 0xEDB88320U;
-
-		for (b = 0; b < 256; ++b) {
-			r = b;
-			for (i = 0; i < 8; ++i) {
-				if (r & 1)
-					r = (r >> 1) ^ poly32;
-				else
-					r >>= 1;
-			}
-
-			crc32_table[0][b] = r;
-		}
-		initdone++;
-	}
-	crc = ~crc;
-
-	while (size != 0) {
-		crc = crc32_table[0][*buf++ ^ (crc & 0xFF)] ^ (crc >> 8);
-		--size;
-	}
-
-	return ~crc;
-}
-
 static void print_listmode(int headline, const char *filename)
 {
 	if (headline && opt_verbose > 1)
@@ -549,6 +1452,8 @@ static void treat_stdin()
 	/* do some work */
 	if (opt_mode == MODE_COMPRESS)
 		errmsg = do_compress(fin, fout);
+	else if (opt_mode == MODE_LIST)
+		errmsg = do_list(fin, fout);
 	else
 		errmsg = do_decompress(fin, fout);
 
@@ -640,6 +1545,8 @@ static void treat_file(char *filename)
 	/* do some work */
 	if (!errmsg && opt_mode == MODE_COMPRESS)
 		errmsg = do_compress(fin, local_fout);
+	else if (opt_mode == MODE_LIST)
+		errmsg = do_list(fin, local_fout);
 	else
 		errmsg = do_decompress(fin, local_fout);
 
@@ -684,6 +1591,157 @@ static void treat_file(char *filename)
 	return;
 }
 
+/* files of test_files(), each one gets a result */
+struct test_job {
+	char *filename;
+	const char *errmsg;
+	char errbuf[128];
+	int skip;
+};
+
+static struct test_job *test_jobs;
+static int test_count;
+static int test_next;
+static pthread_mutex_t test_mutex;
+static POOLMT_Pool *test_pool;
+
+/**
+ * test_one() - verify one file within the shared pool
+ *
+ * return: 0 for ok, or errmsg on error
+ */
+static const char *test_one(struct test_job *job)
+{
+	const char *filename = job->filename;
+	const char *msg = 0;
+	unsigned long long offset;
+	MT_RdWr_t rdwr;
+	MT_DCtx *ctx;
+	FILE *in;
+	size_t ret, frame;
+
+	in = fopen(filename, "rb");
+	if (!in)
+		return "Opening source file failed.";
+
+	ctx = MT_createDCtx(opt_threads, opt_bufsize);
+	if (!ctx) {
+		fclose(in);
+		return "Allocating decompression context failed!";
+	}
+
+	rdwr.fn_read = ReadData;
+	rdwr.fn_write = WriteData;
+	rdwr.arg_read = (void *)in;
+	rdwr.arg_write = (void *)fout;
+
+	ret = MT_SetPoolDCtx(ctx, test_pool, 1);
+	if (!MT_isError(ret))
+		ret = MT_SetVerifyDCtx(ctx, 1);
+	if (!MT_isError(ret) && opt_tree)
+		ret = MT_SetTreeHashDCtx(ctx, 1);
+	if (!MT_isError(ret))
+		ret = MT_decompressDCtx(ctx, &rdwr);
+	if (MT_isError(ret)) {
+		frame = MT_GetErrorFrameDCtx(ctx, &offset);
+		msg = frame_error(ret, frame, offset, job->errbuf,
+				  sizeof(job->errbuf));
+	}
+
+	MT_freeDCtx(ctx);
+	fclose(in);
+
+	return msg;
+}
+
+static void *test_worker(void *arg)
+{
+	int i;
+
+	(void)arg;
+	for (;;) {
+		pthread_mutex_lock(&test_mutex);
+		i = test_next++;
+		pthread_mutex_unlock(&test_mutex);
+		if (i >= test_count)
+			break;
+		if (!test_jobs[i].skip)
+			test_jobs[i].errmsg = test_one(&test_jobs[i]);
+	}
+
+	return 0;
+}
+
+/**
+ * test_files() - test many files at the same time
+ *
+ * Each thread takes the next file and verifies it with its own context,
+ * the frames of all files are decoded by one pool of opt_threads, so a
+ * directory of small files keeps all cores busy. The results are printed
+ * in the order of the files. Returns nonzero, when it can not be used.
+ */
+static int test_files(char **files, int count)
+{
+	pthread_t *th;
+	int i, threads = count < opt_threads ? count : opt_threads;
+
+	for (i = 0; i < count; i++)
+		if (strcmp(files[i], "-") == 0)
+			return 1;
+
+	test_jobs = (struct test_job *)calloc(count, sizeof(*test_jobs));
+	th = (pthread_t *) malloc(threads * sizeof(pthread_t));
+	test_pool = POOLMT_create(opt_threads);
+	if (!test_jobs || !th || !test_pool) {
+		free(test_jobs);
+		free(th);
+		if (test_pool)
+			POOLMT_free(test_pool);
+		return 1;
+	}
+
+	for (i = 0; i < count; i++) {
+		test_jobs[i].filename = files[i];
+		errmsg = check_infile(files[i]);
+		if (errmsg && opt_verbose)
+			fprintf(stderr, "%s: %s: %s\n",
+				progname, files[i], errmsg);
+		test_jobs[i].skip = errmsg != 0;
+	}
+
+	test_count = count;
+	test_next = 0;
+	pthread_mutex_init(&test_mutex, NULL);
+	for (i = 0; i < threads; i++)
+		if (pthread_create(&th[i], NULL, test_worker, NULL))
+			break;
+	threads = i;
+	/* the caller helps, also when no thread could be started */
+	test_worker(NULL);
+	for (i = 0; i < threads; i++)
+		pthread_join(th[i], NULL);
+	pthread_mutex_destroy(&test_mutex);
+
+	for (i = 0; i < count; i++) {
+		if (test_jobs[i].skip)
+			continue;
+		errmsg = test_jobs[i].errmsg;
+		if (errmsg) {
+			fprintf(stderr, "%s: %s: %s\n",
+				progname, files[i], errmsg);
+			exit_code = E_ERROR;
+		}
+		if (opt_verbose > 1)
+			print_testmode(files[i]);
+	}
+
+	POOLMT_free(test_pool);
+	free(test_jobs);
+	free(th);
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
 	if (argc < 2){
@@ -695,6 +1753,9 @@ int main(int argc, char **argv)
 	int opt;		/* for getopt */
 	int files;		/* number of files in cmdline */
 	int levelnumbers = 0;
+	const char *p;		/* for parsing the delimiter */
+	unsigned hex;
+	int n;
 
 	/* get programm name */
 	progname = strrchr(argv[0], PATH_SEPERATOR);
@@ -712,13 +1773,15 @@ int main(int argc, char **argv)
 		opt_force = 1;
 	}
 
-	/* default: thread count = # cpu's */
+	/* default: thread count = # usable cpu's, see cgroups and affinity */
 	opt_threads = getcpucount();
+	opt_memlimit = getmemlimit();
 
 	/* same order as in help option -h */
 	while ((opt =
-		getopt(argc, argv,
-		       "1234567890cdzfo:hklLqrS:tvVT:b:i:BC")) != -1) {
+		getopt_long(argc, argv,
+			    "1234567890cdzfo:hklLqrS:tvVT:b:i:BC",
+			    long_options, NULL)) != -1) {
 		switch (opt) {
 
 			/* 1) Gzip Like Options: */
@@ -800,7 +1863,12 @@ int main(int argc, char **argv)
 
 			/* 2) additional options */
 		case 'T':	/* threads */
-			opt_threads = atoi(optarg);
+			if (strcmp(optarg, "auto") == 0)
+				opt_threads = 0;
+			else
+				opt_threads = atoi(optarg);
+			if (opt_threads == 0)
+				opt_threads = getcpucount();
 			break;
 
 		case 'b':	/* input buffer in MB */
@@ -819,6 +1887,151 @@ int main(int argc, char **argv)
 			opt_nocrc = 1;
 			break;
 
+			/* 3) long options */
+		case OPT_MAXLATENCY:	/* flush frames after MS */
+			opt_latency = atoi(optarg);
+			if (opt_latency < 0)
+				usage();
+			break;
+
+		case OPT_AFFINITY:	/* pin the compression threads */
+			opt_affinity = MT_AFFINITY_SPREAD;
+			break;
+
+		case OPT_MINTHREADS:	/* park threads, when waiting for io */
+			opt_minthreads = atoi(optarg);
+			if (opt_minthreads < 1)
+				usage();
+			break;
+
+		case OPT_CDC:	/* content defined chunking, AVG[,MIN,MAX] */
+			opt_cdcmin = opt_cdcmax = 0;
+			if (sscanf(optarg, "%d,%d,%d", &opt_cdcavg, &opt_cdcmin,
+				   &opt_cdcmax) < 1 || opt_cdcavg < 1 ||
+			    opt_cdcmin < 0 || opt_cdcmax < 0 ||
+			    opt_cdcavg > (1 << 20) || opt_cdcmax > (1 << 20))
+				usage();
+			break;
+
+		case OPT_DELIMITER:	/* record delimiter, with C escapes */
+			opt_dlen = 0;
+			for (p = optarg ? optarg : "\\n"; *p; p++) {
+				int c = *p;
+
+				if (opt_dlen == (int)sizeof(opt_delim))
+					usage();
+				if (c == '\\' && p[1]) {
+					switch (*++p) {
+					case 'n': c = '\n'; break;
+					case 'r': c = '\r'; break;
+					case 't': c = '\t'; break;
+					case '0': c = 0; break;
+					case 'x':
+						if (sscanf(p + 1, "%2x%n", &hex, &n) != 1)
+							usage();
+						c = (int)hex;
+						p += n;
+						break;
+					default: c = *p;
+					}
+				}
+				opt_delim[opt_dlen++] = (char)c;
+			}
+			if (!opt_dlen)
+				usage();
+			break;
+
+		case OPT_GREP:	/* search mode, decompress to stdout */
+			opt_grep = optarg;
+			opt_greplen = strlen(optarg);
+			if (!opt_greplen || strchr(optarg, '\n'))
+				usage();
+			opt_mode = MODE_DECOMPRESS;
+			opt_stdout = 1;
+			opt_force = 1;
+			opt_keep = 1;
+			break;
+
+		case OPT_RANGE:	/* split mode, START[,END] to stdout */
+			n = sscanf(optarg, "%llu,%llu", &opt_rstart, &opt_rend);
+			if (n < 1 || (opt_rend && opt_rend <= opt_rstart))
+				usage();
+			opt_range = 1;
+			opt_mode = MODE_DECOMPRESS;
+			opt_stdout = 1;
+			opt_force = 1;
+			opt_keep = 1;
+			break;
+
+		case OPT_HEADER:	/* version of the frame headers */
+			opt_header = atoi(optarg);
+			if (opt_header < 1 || opt_header > 2)
+				usage();
+			break;
+
+		case OPT_CHECKSUM:	/* checksum of each frame */
+			opt_checksum = 1;
+			break;
+
+		case OPT_TREE:	/* tree hash of the input */
+			opt_tree = 1;
+			break;
+
+		case OPT_VERIFY:	/* round trip of each frame */
+			opt_verify = 1;
+			break;
+
+		case OPT_NOMMAP:	/* read regular files with fread() */
+			opt_mmap = 0;
+			break;
+
+		case OPT_URING:	/* asynchronous i/o, optional depth */
+			opt_uring = optarg ? atoi(optarg) : 4;
+			if (opt_uring < 1 || opt_uring > 64)
+				usage();
+			break;
+
+		case OPT_DIRECT:	/* past the page cache */
+			opt_direct = 1;
+			break;
+
+		case OPT_BLOOM:	/* bloom filter per frame, optional KiB */
+			opt_bloom = optarg ? atoi(optarg) : 16;
+			if (opt_bloom < 1 || opt_bloom > 1024)
+				usage();
+			break;
+
+		case OPT_DEDUP:	/* frame level deduplication, optional MiB */
+			opt_dedup = optarg ? atoi(optarg) : 256;
+			if (opt_dedup < 1 || opt_dedup > 4096)
+				usage();
+			break;
+
+#ifdef MT_SetPolicyCCtx
+		case OPT_POLICY:	/* codec choice, NAME[,MBS] */
+			for (opt_policy = 0; opt_policy < 3; opt_policy++) {
+				size_t len = strlen(policies[opt_policy]);
+				if (!strncmp(optarg, policies[opt_policy], len) &&
+				    (!optarg[len] || optarg[len] == ','))
+					break;
+			}
+			opt_mbps = strchr(optarg, ',') ?
+			    atoi(strchr(optarg, ',') + 1) : 0;
+			if (opt_policy == 3 || opt_mbps < 0)
+				usage();
+			break;
+#endif
+
+		case OPT_ADAPT:	/* level by output speed, optional MIN,MAX */
+			opt_adapt = 1;
+			if (optarg && (sscanf(optarg, "%d,%d", &opt_minlevel,
+					      &opt_maxlevel) != 2 ||
+				       opt_minlevel < LEVEL_MIN ||
+				       opt_maxlevel > LEVEL_MAX ||
+				       opt_minlevel > opt_maxlevel))
+				usage();
+			break;
+
 		default:
 			usage();
 			/* not reached */
@@ -909,6 +2122,10 @@ int main(int argc, char **argv)
 		/* use input files */
 		for (;;) {
 			files = optind;
+			/* testing mode, all files at once */
+			if (opt_mode == MODE_TEST && argc - optind > 1 &&
+			    test_files(argv + optind, argc - optind) == 0)
+				files = argc;
 			while (files < argc) {
 				treat_file(argv[files++]);
 			}
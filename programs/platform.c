@@ -11,6 +11,10 @@
  * - zstdmt source repository: https://github.com/mcmilk/zstdmt
  */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE		/* sched_getaffinity() */
+#endif
+
 #include "platform.h"
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -34,6 +38,36 @@ int getcpucount(void)
 	return si.dwNumberOfProcessors;
 }
 
+size_t getmemlimit(void)
+{
+	/* job objects are not checked */
+	return 0;
+}
+
+int waitinput(int fd, int msec)
+{
+	/* no poll() for pipes, the following read will just block */
+	(void)fd;
+	(void)msec;
+
+	return 1;
+}
+
+void *mapinput(int fd, size_t *size)
+{
+	/* not done yet, the file is read */
+	(void)fd;
+	*size = 0;
+
+	return 0;
+}
+
+void unmapinput(void *map, size_t size)
+{
+	(void)map;
+	(void)size;
+}
+
 int getrusage(int who, struct rusage *uv_rusage)
 {
 	FILETIME createTime, exitTime, kernelTime, userTime;
@@ -90,8 +124,214 @@ int getrusage(int who, struct rusage *uv_rusage)
 }
 #else
 /* POSIX */
+#include <poll.h>
+#include <sys/mman.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <string.h>
+
+#ifndef CGROUP_ROOT
+#define CGROUP_ROOT "/sys/fs/cgroup"
+#endif
+
+/**
+ * cg_read() - read the first line of some cgroup file
+ *
+ * ctrl is the v1 controller (like "cpu" or "memory") or zero for v2,
+ * the own group of the process is tried first, then the root of the
+ * mount point, which is what containers see normally
+ */
+static int cg_read(const char *ctrl, const char *file, char *buf, int len)
+{
+	char line[1024], group[1024], path[2048];
+	size_t clen = ctrl ? strlen(ctrl) : 0;
+	FILE *f;
+
+	/* find own group: "0::/path" for v2 and "4:cpu,cpuacct:/path" for v1 */
+	group[0] = 0;
+	f = fopen("/proc/self/cgroup", "r");
+	while (f && fgets(line, sizeof(line), f)) {
+		char *list = strchr(line, ':');
+		char *grp = list ? strchr(list + 1, ':') : 0;
+		char *p;
+		int found = 0;
+
+		if (!grp)
+			continue;
+		*grp++ = 0;
+		list++;
+		grp[strcspn(grp, "\n")] = 0;
+
+		if (!ctrl) {
+			found = (*list == 0);
+		} else {
+			for (p = list; *p; p += strcspn(p, ",")) {
+				if (*p == ',')
+					p++;
+				if (strncmp(p, ctrl, clen) == 0 &&
+				    (p[clen] == ',' || p[clen] == 0))
+					found = 1;
+			}
+		}
+
+		if (found) {
+			snprintf(group, sizeof(group), "%s", grp);
+			break;
+		}
+	}
+	if (f)
+		fclose(f);
+
+	snprintf(path, sizeof(path), "%s%s%s%s/%s", CGROUP_ROOT,
+		 ctrl ? "/" : "", ctrl ? ctrl : "",
+		 strcmp(group, "/") ? group : "", file);
+	f = fopen(path, "r");
+	if (!f && group[0]) {
+		snprintf(path, sizeof(path), "%s%s%s/%s", CGROUP_ROOT,
+			 ctrl ? "/" : "", ctrl ? ctrl : "", file);
+		f = fopen(path, "r");
+	}
+	if (!f)
+		return -1;
+
+	if (!fgets(buf, len, f)) {
+		fclose(f);
+		return -1;
+	}
+	fclose(f);
+
+	return 0;
+}
+
+/* cpu quota of the cgroup, rounded up, zero means no quota */
+static int cg_cpus(void)
+{
+	char buf[128];
+	long long quota, period;
+
+	/* v2: "max 100000" or "400000 100000" */
+	if (cg_read(0, "cpu.max", buf, sizeof(buf)) == 0) {
+		if (sscanf(buf, "%lld %lld", &quota, &period) != 2)
+			return 0;
+	} else {
+		/* v1: quota is -1 for unlimited */
+		if (cg_read("cpu", "cpu.cfs_quota_us", buf, sizeof(buf)) ||
+		    sscanf(buf, "%lld", &quota) != 1)
+			return 0;
+		if (cg_read("cpu", "cpu.cfs_period_us", buf, sizeof(buf)) ||
+		    sscanf(buf, "%lld", &period) != 1)
+			return 0;
+	}
+
+	if (quota <= 0 || period <= 0)
+		return 0;
+
+	return (int)((quota + period - 1) / period);
+}
+#endif
+
 int getcpucount(void)
 {
-	return sysconf(_SC_NPROCESSORS_ONLN);
+	int cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+#ifdef __linux__
+	{
+		cpu_set_t set;
+		int n;
+
+		/* taskset or cpuset of the container */
+		if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+			n = CPU_COUNT(&set);
+			if (n > 0 && n < cpus)
+				cpus = n;
+		}
+
+		/* cfs quota, like "docker run --cpus=4" */
+		n = cg_cpus();
+		if (n > 0 && n < cpus)
+			cpus = n;
+	}
+#endif
+
+	if (cpus < 1)
+		cpus = 1;
+
+	return cpus;
+}
+
+size_t getmemlimit(void)
+{
+#ifdef __linux__
+	char buf[128];
+	unsigned long long limit;
+
+	/* v2: "max" or the bytes */
+	if (cg_read(0, "memory.max", buf, sizeof(buf)) == 0) {
+		if (sscanf(buf, "%llu", &limit) != 1)
+			return 0;
+	} else {
+		/* v1: some huge value, when unlimited */
+		if (cg_read("memory", "memory.limit_in_bytes", buf,
+			    sizeof(buf)) || sscanf(buf, "%llu", &limit) != 1)
+			return 0;
+	}
+
+	/* unlimited in real life */
+	if (limit >= (1ULL << 60) || limit > (size_t)-1)
+		return 0;
+
+	return (size_t)limit;
+#else
+	return 0;
+#endif
+}
+
+int waitinput(int fd, int msec)
+{
+	struct pollfd pfd;
+	int rv;
+
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	pfd.revents = 0;
+
+	do {
+		rv = poll(&pfd, 1, msec);
+	} while (rv == -1 && errno == EINTR);
+
+	if (rv < 0)
+		return -1;
+
+	return rv > 0 ? 1 : 0;
+}
+
+void *mapinput(int fd, size_t *size)
+{
+	struct stat st;
+	void *map;
+
+	*size = 0;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+	    (unsigned long long)st.st_size > (size_t)-1)
+		return 0;
+
+	map = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED)
+		return 0;
+
+	/* more read ahead, the workers take the chunks in order */
+	madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+	madvise(map, (size_t)st.st_size, MADV_HUGEPAGE);
+#endif
+	*size = (size_t)st.st_size;
+
+	return map;
+}
+
+void unmapinput(void *map, size_t size)
+{
+	munmap(map, size);
 }
 #endif
@@ -30,9 +30,40 @@ extern "C" {
 #include <stdio.h>
 #include <errno.h>
 #include <time.h>
+#include <getopt.h>
 
+/**
+ * getcpucount() - number of cpu's, which can be used
+ * - on linux, the affinity mask and the cpu quota of the cgroup are
+ *   also taken into account (containers)
+ */
 extern int getcpucount(void);
 
+/**
+ * getmemlimit() - memory limit of the process in bytes
+ * return: the limit of the cgroup (v1 or v2), or zero for unlimited
+ */
+extern size_t getmemlimit(void);
+
+/**
+ * waitinput() - wait for data on the file descriptor fd
+ * return: 1 when input (or eof) is there, 0 on timeout, -1 on error
+ */
+extern int waitinput(int fd, int msec);
+
+/**
+ * mapinput() - map a regular file read only, for reading it sequentially
+ * return: the mapping of the whole file and its size in *size, or zero
+ *         for pipes, terminals, empty files and when it fails, so that
+ *         the file is read as before
+ */
+extern void *mapinput(int fd, size_t *size);
+
+/**
+ * unmapinput() - release the mapping of mapinput()
+ */
+extern void unmapinput(void *map, size_t size);
+
 #define _FILE_OFFSET_BITS 64
 
 #if defined(_MSC_VER) || defined(__MINGW32__)
@@ -29,17 +29,48 @@
 #define MT_CCtx            SNAPPYMT_CCtx
 #define MT_createCCtx      SNAPPYMT_createCCtx
 #define MT_compressCCtx    SNAPPYMT_compressCCtx
+#define MT_SetMaxLatencyCCtx SNAPPYMT_SetMaxLatencyCCtx
+#define MT_SetAffinityCCtx SNAPPYMT_SetAffinityCCtx
+#define MT_SetAdaptiveCCtx SNAPPYMT_SetAdaptiveCCtx
+#define MT_SetChunkingCCtx SNAPPYMT_SetChunkingCCtx
+#define MT_SetDelimiterCCtx SNAPPYMT_SetDelimiterCCtx
+#define MT_SetBloomCCtx    SNAPPYMT_SetBloomCCtx
+#define MT_SetHeaderCCtx   SNAPPYMT_SetHeaderCCtx
+#define MT_SetChecksumCCtx SNAPPYMT_SetChecksumCCtx
+#define MT_SetTreeHashCCtx SNAPPYMT_SetTreeHashCCtx
+#define MT_GetTreeHashCCtx SNAPPYMT_GetTreeHashCCtx
+#define MT_SetVerifyCCtx   SNAPPYMT_SetVerifyCCtx
+#define MT_SetSourceCCtx   SNAPPYMT_SetSourceCCtx
+#define MT_GetErrorFrameCCtx SNAPPYMT_GetErrorFrameCCtx
+#define MT_SetDedupCCtx    SNAPPYMT_SetDedupCCtx
 #define MT_GetFramesCCtx   SNAPPYMT_GetFramesCCtx
 #define MT_GetInsizeCCtx   SNAPPYMT_GetInsizeCCtx
 #define MT_GetOutsizeCCtx  SNAPPYMT_GetOutsizeCCtx
+#define MT_GetLatencyAvgCCtx SNAPPYMT_GetLatencyAvgCCtx
+#define MT_GetLatencyMaxCCtx SNAPPYMT_GetLatencyMaxCCtx
+#define MT_GetMemoryCCtx   SNAPPYMT_GetMemoryCCtx
+#define MT_GetStatsCCtx    SNAPPYMT_GetStatsCCtx
+#define MT_Stats           SNAPPYMT_Stats
 #define MT_freeCCtx        SNAPPYMT_freeCCtx
 
 #define MT_DCtx            SNAPPYMT_DCtx
 #define MT_createDCtx      SNAPPYMT_createDCtx
 #define MT_decompressDCtx  SNAPPYMT_decompressDCtx
+#define MT_SetFilterDCtx   SNAPPYMT_SetFilterDCtx
+#define MT_SetBloomDCtx    SNAPPYMT_SetBloomDCtx
+#define MT_SetRangeDCtx    SNAPPYMT_SetRangeDCtx
+#define MT_SetVerifyDCtx   SNAPPYMT_SetVerifyDCtx
+#define MT_SetTreeHashDCtx SNAPPYMT_SetTreeHashDCtx
+#define MT_GetTreeHashDCtx SNAPPYMT_GetTreeHashDCtx
+#define MT_SetPoolDCtx     SNAPPYMT_SetPoolDCtx
 #define MT_GetFramesDCtx   SNAPPYMT_GetFramesDCtx
 #define MT_GetInsizeDCtx   SNAPPYMT_GetInsizeDCtx
 #define MT_GetOutsizeDCtx  SNAPPYMT_GetOutsizeDCtx
+#define MT_GetErrorFrameDCtx SNAPPYMT_GetErrorFrameDCtx
 #define MT_freeDCtx        SNAPPYMT_freeDCtx
+#define MT_GetFrameInfo    SNAPPYMT_GetFrameInfo
+#define MT_INFO_PEEK       SNAPPYMT_INFO_PEEK
+#define MT_INFO_DATA       SNAPPYMT_INFO_DATA
+#define MT_INFO_WINDOW     SNAPPYMT_INFO_WINDOW
 
 #include "main.c"
@@ -0,0 +1,152 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+/**
+ * treetest - the tree hash of ordered and unordered compression
+ *
+ * The root must not depend on the order, in which the workers finish
+ * their frames. It is built for one library by the tests target of the
+ * Makefile, for example:
+ *
+ * -DMT_HEADER='"zstd-mt.h"' -DMT_PREFIX=ZSTDCB_
+ *
+ * MT_LEVEL is the compression level, when 1 is no valid one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include MT_HEADER
+
+#define MT_PASTE(a, b) a##b
+#define MT_NAME(a, b)  MT_PASTE(a, b)
+#define MT(name)       MT_NAME(MT_PREFIX, name)
+
+#ifndef MT_LEVEL
+#define MT_LEVEL 1
+#endif
+
+#define INSIZE   (16 << 20)
+#define CHUNK    (64 << 10)
+#define THREADS  8
+#define RUNS     3
+
+struct source {
+	const unsigned char *buf;
+	size_t size, pos;
+};
+
+static int ReadData(void *arg, MT(Buffer) * in)
+{
+	struct source *s = (struct source *)arg;
+	size_t left = s->size - s->pos;
+
+	if (in->size > left)
+		in->size = left;
+	memcpy(in->buf, s->buf + s->pos, in->size);
+	s->pos += in->size;
+
+	return 0;
+}
+
+static int WriteData(void *arg, MT(Buffer) * out)
+{
+	(void)arg;
+	(void)out;
+
+	return 0;
+}
+
+static int WriteFrame(void *arg, MT(Buffer) * out, size_t frame,
+		      unsigned long long offset)
+{
+	(void)arg;
+	(void)out;
+	(void)frame;
+	(void)offset;
+
+	return 0;
+}
+
+/* root of one compression, unordered or in order of the frames */
+static int tree_root(struct source *s, int unordered,
+		     unsigned long long *root)
+{
+	MT(CCtx) * ctx;
+	MT(RdWr_t) rdwr;
+	size_t ret;
+
+	ctx = MT(createCCtx)(THREADS, MT_LEVEL, CHUNK);
+	if (!ctx)
+		return -1;
+
+	rdwr.fn_read = ReadData;
+	rdwr.fn_write = WriteData;
+	rdwr.arg_read = s;
+	rdwr.arg_write = 0;
+	s->pos = 0;
+
+	ret = MT(SetTreeHashCCtx)(ctx, 1);
+	if (!MT(isError)(ret) && unordered)
+		ret = MT(SetUnorderedCCtx)(ctx, WriteFrame, 0);
+	if (!MT(isError)(ret))
+		ret = MT(compressCCtx)(ctx, &rdwr);
+	if (!MT(isError)(ret))
+		ret = MT(GetTreeHashCCtx)(ctx, root);
+	MT(freeCCtx)(ctx);
+	if (MT(isError)(ret)) {
+		fprintf(stderr, "%s\n", MT(getErrorString)(ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	unsigned long long ordered[2], root[2];
+	unsigned char *buf;
+	struct source s;
+	unsigned int x = 1;
+	size_t i;
+	int run;
+
+	/* compressible input, so the workers need different times */
+	buf = malloc(INSIZE);
+	if (!buf)
+		return 1;
+	for (i = 0; i < INSIZE; i++) {
+		x = x * 1103515245 + 12345;
+		buf[i] = (x >> 16) & ((i >> 16) & 1 ? 0x0f : 0xff);
+	}
+	s.buf = buf;
+	s.size = INSIZE;
+
+	if (tree_root(&s, 0, ordered))
+		return 1;
+
+	for (run = 0; run < RUNS; run++) {
+		if (tree_root(&s, 1, root))
+			return 1;
+		if (root[0] != ordered[0] || root[1] != ordered[1]) {
+			fprintf(stderr, "unordered root %016llx%016llx,"
+				" ordered %016llx%016llx\n", root[0], root[1],
+				ordered[0], ordered[1]);
+			return 1;
+		}
+	}
+	free(buf);
+
+	return 0;
+}
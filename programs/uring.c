@@ -0,0 +1,543 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE		/* O_DIRECT */
+#endif
+
+#include "uring.h"
+
+#if defined(__linux__) && defined(__GNUC__)
+#include <sys/syscall.h>
+#endif
+
+#if defined(__linux__) && defined(__GNUC__) && defined(__NR_io_uring_setup)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <string.h>
+
+/* states of a slot */
+#define SLOT_IDLE  0
+#define SLOT_BUSY  1		/* submitted */
+#define SLOT_DONE  2		/* completed, the result is not checked */
+
+struct slot {
+	unsigned char *buf;
+	struct iovec iov;	/* request without fixed buffers */
+	off_t offset;		/* file offset of the request */
+	size_t size;		/* bytes of the request or the ones read */
+	size_t pos;		/* bytes taken by uring_read() */
+	int state;
+	int res;		/* result of the completion */
+};
+
+struct uring {
+	int ring;		/* fd of the io_uring instance, -1 synchronous */
+	int fd;
+	int write;
+	int direct;		/* O_DIRECT was set, the old flags are in fl */
+	int fl;
+	int fixed;		/* the buffers are registered */
+	int failed;
+	int eof;		/* the file ends in the current slot */
+	off_t start;		/* offset of uring_open() */
+	off_t offset;		/* offset of the next request */
+	U64 done;		/* bytes of uring_read() or uring_write() */
+	size_t bufsize;
+	int depth;
+	int cur;		/* slot of uring_read() or uring_write() */
+	struct slot *slot;
+	unsigned char *mem;	/* the buffers of all slots */
+
+	/* the rings, which are shared with the kernel */
+	void *sqmap, *cqmap;
+	size_t sqlen, cqlen;
+	struct io_uring_sqe *sqes;
+	size_t sqeslen;
+	unsigned *sqtail, *sqmask, *sqarray;
+	unsigned *cqhead, *cqtail, *cqmask;
+	struct io_uring_cqe *cqes;
+};
+
+static int ring_enter(struct uring *r, unsigned submit, unsigned wait)
+{
+	int rv;
+
+	do {
+		rv = (int)syscall(__NR_io_uring_enter, r->ring, submit, wait,
+				  wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	} while (rv < 0 && errno == EINTR && wait);
+
+	return rv;
+}
+
+static int ring_map(struct uring *r, struct io_uring_params *p)
+{
+	unsigned char *sq, *cq;
+
+	r->sqlen = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+	r->cqlen = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+#ifdef IORING_FEAT_SINGLE_MMAP
+	if (p->features & IORING_FEAT_SINGLE_MMAP) {
+		if (r->cqlen > r->sqlen)
+			r->sqlen = r->cqlen;
+		r->cqlen = 0;
+	}
+#endif
+
+	r->sqmap = mmap(0, r->sqlen, PROT_READ | PROT_WRITE,
+			MAP_SHARED | MAP_POPULATE, r->ring, IORING_OFF_SQ_RING);
+	if (r->sqmap == MAP_FAILED) {
+		r->sqmap = 0;
+		return -1;
+	}
+	r->cqmap = r->sqmap;
+	if (r->cqlen) {
+		r->cqmap = mmap(0, r->cqlen, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, r->ring,
+				IORING_OFF_CQ_RING);
+		if (r->cqmap == MAP_FAILED) {
+			r->cqmap = 0;
+			return -1;
+		}
+	}
+	r->sqeslen = p->sq_entries * sizeof(struct io_uring_sqe);
+	r->sqes = (struct io_uring_sqe *)mmap(0, r->sqeslen,
+					      PROT_READ | PROT_WRITE,
+					      MAP_SHARED | MAP_POPULATE,
+					      r->ring, IORING_OFF_SQES);
+	if (r->sqes == MAP_FAILED) {
+		r->sqes = 0;
+		return -1;
+	}
+
+	sq = (unsigned char *)r->sqmap;
+	r->sqtail = (unsigned *)(sq + p->sq_off.tail);
+	r->sqmask = (unsigned *)(sq + p->sq_off.ring_mask);
+	r->sqarray = (unsigned *)(sq + p->sq_off.array);
+	cq = (unsigned char *)r->cqmap;
+	r->cqhead = (unsigned *)(cq + p->cq_off.head);
+	r->cqtail = (unsigned *)(cq + p->cq_off.tail);
+	r->cqmask = (unsigned *)(cq + p->cq_off.ring_mask);
+	r->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+
+	return 0;
+}
+
+static void ring_free(struct uring *r)
+{
+#ifdef O_DIRECT
+	if (r->direct)
+		fcntl(r->fd, F_SETFL, r->fl);
+#endif
+	if (r->sqes)
+		munmap(r->sqes, r->sqeslen);
+	if (r->cqmap && r->cqmap != r->sqmap)
+		munmap(r->cqmap, r->cqlen);
+	if (r->sqmap)
+		munmap(r->sqmap, r->sqlen);
+	if (r->ring >= 0)
+		close(r->ring);
+	free(r->mem);
+	free(r->slot);
+	free(r);
+}
+
+/**
+ * ring_submit() - one read or write of the slot at its offset
+ * - at most depth requests are in flight, so the rings never overflow
+ * - without io_uring, it is done at once
+ */
+static int ring_submit(struct uring *r, struct slot *s)
+{
+	unsigned tail, idx;
+	struct io_uring_sqe *sqe;
+
+	if (r->ring < 0) {
+		ssize_t n;
+
+		do {
+			n = r->write ?
+			    pwrite(r->fd, s->buf, s->size, s->offset) :
+			    pread(r->fd, s->buf, s->size, s->offset);
+		} while (n < 0 && errno == EINTR);
+		s->res = n < 0 ? -errno : (int)n;
+		s->state = SLOT_DONE;
+		return 0;
+	}
+
+	tail = *r->sqtail;
+	idx = tail & *r->sqmask;
+	sqe = &r->sqes[idx];
+	memset(sqe, 0, sizeof(*sqe));
+	if (r->fixed) {
+		sqe->opcode = r->write ? IORING_OP_WRITE_FIXED :
+		    IORING_OP_READ_FIXED;
+		sqe->addr = (unsigned long)s->buf;
+		sqe->len = (unsigned)s->size;
+		sqe->buf_index = 0;
+	} else {
+		sqe->opcode = r->write ? IORING_OP_WRITEV : IORING_OP_READV;
+		s->iov.iov_base = s->buf;
+		s->iov.iov_len = s->size;
+		sqe->addr = (unsigned long)&s->iov;
+		sqe->len = 1;
+	}
+	sqe->fd = r->fd;
+	sqe->off = (U64)s->offset;
+	sqe->user_data = (U64)(s - r->slot);
+	r->sqarray[idx] = idx;
+	__atomic_store_n(r->sqtail, tail + 1, __ATOMIC_RELEASE);
+
+	if (ring_enter(r, 1, 0) != 1) {
+		r->failed = 1;
+		return -1;
+	}
+	s->state = SLOT_BUSY;
+
+	return 0;
+}
+
+/* wait for the next completion */
+static int ring_reap(struct uring *r)
+{
+	unsigned head = *r->cqhead;
+	struct io_uring_cqe *cqe;
+	struct slot *s;
+
+	while (head == __atomic_load_n(r->cqtail, __ATOMIC_ACQUIRE)) {
+		if (ring_enter(r, 0, 1) < 0) {
+			r->failed = 1;
+			return -1;
+		}
+	}
+
+	cqe = &r->cqes[head & *r->cqmask];
+	s = &r->slot[cqe->user_data];
+	s->res = cqe->res;
+	s->state = SLOT_DONE;
+	__atomic_store_n(r->cqhead, head + 1, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/**
+ * ring_wait() - wait for the request of the slot and check its result
+ * - short reads end at eof, short writes are unusual, the rest of both is
+ *   done synchronously
+ * - the kernel cancels the requests of a thread, which exits, so the
+ *   requests of the library's workers are done again synchronously then
+ * - the slot of a write is empty afterwards
+ */
+static int ring_wait(struct uring *r, struct slot *s)
+{
+	size_t done;
+
+	while (s->state == SLOT_BUSY)
+		if (ring_reap(r))
+			return -1;
+	if (s->state == SLOT_IDLE)
+		return 0;
+
+	s->state = SLOT_IDLE;
+	if (s->res == -ECANCELED || s->res == -EINTR || s->res == -EAGAIN)
+		s->res = 0;
+	if (s->res < 0) {
+		r->failed = 1;
+		return -1;
+	}
+
+	/* with O_DIRECT, only a read at the end of the file stops in a block */
+	done = (size_t)s->res;
+	while (done < s->size && !(r->direct && done % URING_ALIGN)) {
+		ssize_t n = r->write ?
+		    pwrite(r->fd, s->buf + done, s->size - done,
+			   s->offset + (off_t)done) :
+		    pread(r->fd, s->buf + done, s->size - done,
+			  s->offset + (off_t)done);
+
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 || (n == 0 && r->write)) {
+			r->failed = 1;
+			return -1;
+		}
+		if (n == 0)
+			break;
+		done += (size_t)n;
+	}
+	if (r->write && done < s->size) {
+		r->failed = 1;
+		return -1;
+	}
+	s->size = r->write ? 0 : done;
+
+	return 0;
+}
+
+/* read ahead into the slot */
+static int ring_read(struct uring *r, struct slot *s)
+{
+	s->offset = r->offset;
+	s->size = r->bufsize;
+	s->pos = 0;
+	r->offset += (off_t)r->bufsize;
+
+	return ring_submit(r, s);
+}
+
+/* write the current slot and go on with the next one */
+static int ring_flush(struct uring *r)
+{
+	struct slot *s = &r->slot[r->cur];
+
+	s->offset = r->offset;
+	r->offset += (off_t)s->size;
+	r->cur = (r->cur + 1) % r->depth;
+
+	return ring_submit(r, s);
+}
+
+struct uring *uring_open(int fd, off_t offset, int write, int depth,
+			 size_t bufsize, int direct)
+{
+	struct io_uring_params p;
+	struct iovec iov;
+	struct uring *r;
+	struct stat st;
+	int i, fl;
+
+	if (depth < 1 || !bufsize || bufsize % URING_ALIGN ||
+	    fstat(fd, &st) || !S_ISREG(st.st_mode))
+		return 0;
+
+	/* appended writes would land in the order of their completion */
+	fl = fcntl(fd, F_GETFL);
+	if (fl == -1 || (write && (fl & O_APPEND)))
+		return 0;
+
+	/* the writes of O_DIRECT begin at a block, reads are rounded down */
+#ifdef O_DIRECT
+	if (direct && write && offset % URING_ALIGN)
+		return 0;
+#else
+	if (direct)
+		return 0;
+#endif
+
+	r = (struct uring *)calloc(1, sizeof(struct uring));
+	if (!r)
+		return 0;
+	r->fd = fd;
+	r->write = write;
+	r->depth = depth;
+	r->bufsize = bufsize;
+	r->start = offset;
+	r->offset = direct ? offset - offset % URING_ALIGN : offset;
+	r->fl = fl;
+
+	/**
+	 * ENOSYS, or EPERM when it is disabled (kernel.io_uring_disabled),
+	 * O_DIRECT goes on synchronously then
+	 */
+	memset(&p, 0, sizeof(p));
+	r->ring = (int)syscall(__NR_io_uring_setup, (unsigned)depth, &p);
+	if (r->ring < 0 && !direct)
+		goto fail;
+	if (r->ring >= 0 && ring_map(r, &p))
+		goto fail;
+
+	/* some file systems (like tmpfs on older kernels) refuse it */
+#ifdef O_DIRECT
+	if (direct) {
+		if (fcntl(fd, F_SETFL, fl | O_DIRECT) == -1)
+			goto fail;
+		r->direct = 1;
+	}
+#endif
+
+	r->slot = (struct slot *)calloc((size_t)depth, sizeof(struct slot));
+	if (!r->slot ||
+	    posix_memalign((void **)&r->mem, 4096, (size_t)depth * bufsize)) {
+		r->mem = 0;
+		goto fail;
+	}
+	for (i = 0; i < depth; i++)
+		r->slot[i].buf = r->mem + (size_t)i * bufsize;
+
+	/* one fixed buffer for all slots, the memlock limit may deny it */
+	iov.iov_base = r->mem;
+	iov.iov_len = (size_t)depth * bufsize;
+	r->fixed = r->ring >= 0 && syscall(__NR_io_uring_register, r->ring,
+					   IORING_REGISTER_BUFFERS, &iov,
+					   1) == 0;
+
+	if (write)
+		return r;
+
+	for (i = 0; i < depth; i++) {
+		if (ring_read(r, &r->slot[i])) {
+			uring_close(r, &offset);
+			return 0;
+		}
+	}
+
+	/* the start within the first block */
+	r->slot[0].pos = (size_t)(r->start - r->slot[0].offset);
+
+	return r;
+
+ fail:
+	ring_free(r);
+	return 0;
+}
+
+ssize_t uring_read(struct uring *r, void *buf, size_t size)
+{
+	size_t done = 0;
+
+	while (done < size && !r->eof) {
+		struct slot *s = &r->slot[r->cur];
+		size_t n;
+
+		if (ring_wait(r, s))
+			return -1;
+		if (s->pos > s->size)
+			s->pos = s->size;
+
+		n = s->size - s->pos;
+		if (n > size - done)
+			n = size - done;
+		memcpy((unsigned char *)buf + done, s->buf + s->pos, n);
+		s->pos += n;
+		done += n;
+		if (s->pos < s->size)
+			break;
+
+		/* the slot is empty, it reads ahead again */
+		if (s->size < r->bufsize) {
+			r->eof = 1;
+			break;
+		}
+		if (ring_read(r, s))
+			return -1;
+		r->cur = (r->cur + 1) % r->depth;
+	}
+	r->done += done;
+
+	return (ssize_t)done;
+}
+
+int uring_write(struct uring *r, const void *buf, size_t size)
+{
+	const unsigned char *p = (const unsigned char *)buf;
+
+	while (size) {
+		struct slot *s = &r->slot[r->cur];
+		size_t n;
+
+		if (r->failed || ring_wait(r, s))
+			return -1;
+
+		n = r->bufsize - s->size;
+		if (n > size)
+			n = size;
+		memcpy(s->buf + s->size, p, n);
+		s->size += n;
+		p += n;
+		size -= n;
+		r->done += n;
+		if (s->size == r->bufsize && ring_flush(r))
+			return -1;
+	}
+
+	return 0;
+}
+
+int uring_close(struct uring *r, off_t *offset)
+{
+	struct slot *s = &r->slot[r->cur];
+	off_t end = r->offset;
+	int i, rv;
+
+	/* the last block of O_DIRECT is padded, then it is cut off again */
+	if (r->write && !r->failed && s->state == SLOT_IDLE && s->size) {
+		end += (off_t)s->size;
+		if (r->direct && s->size % URING_ALIGN) {
+			size_t pad = URING_ALIGN - s->size % URING_ALIGN;
+
+			memset(s->buf + s->size, 0, pad);
+			s->size += pad;
+		}
+		ring_flush(r);
+	}
+
+	/* the kernel must be done with the buffers */
+	for (i = 0; i < r->depth; i++) {
+		if (r->write)
+			ring_wait(r, &r->slot[i]);
+		else
+			while (r->slot[i].state == SLOT_BUSY && !ring_reap(r)) ;
+	}
+
+	if (r->write && !r->failed && r->direct && ftruncate(r->fd, end))
+		r->failed = 1;
+
+	*offset = r->write ? end : r->start + (off_t)r->done;
+	rv = r->failed ? -1 : 0;
+	ring_free(r);
+
+	return rv;
+}
+#else
+struct uring *uring_open(int fd, off_t offset, int write, int depth,
+			 size_t bufsize, int direct)
+{
+	/* no io_uring, stdio is used */
+	(void)fd;
+	(void)offset;
+	(void)write;
+	(void)depth;
+	(void)bufsize;
+	(void)direct;
+
+	return 0;
+}
+
+ssize_t uring_read(struct uring *r, void *buf, size_t size)
+{
+	(void)r;
+	(void)buf;
+	(void)size;
+
+	return -1;
+}
+
+int uring_write(struct uring *r, const void *buf, size_t size)
+{
+	(void)r;
+	(void)buf;
+	(void)size;
+
+	return -1;
+}
+
+int uring_close(struct uring *r, off_t *offset)
+{
+	(void)r;
+	(void)offset;
+
+	return -1;
+}
+#endif
@@ -0,0 +1,83 @@
+
+/**
+ * Copyright (c) 2016 - 2017 Tino Reichardt
+ * All rights reserved.
+ *
+ * This source code is licensed under the BSD-style license found in the
+ * LICENSE file in the root directory of this source tree. An additional grant
+ * of patent rights can be found in the PATENTS file in the same directory.
+ *
+ * You can contact the author at:
+ * - zstdmt source repository: https://github.com/mcmilk/zstdmt
+ */
+
+#ifndef URING_H
+#define URING_H
+
+#if defined (__cplusplus)
+extern "C" {
+#endif
+
+#include "platform.h"
+
+/**
+ * asynchronous reading and writing of regular files with io_uring
+ *
+ * - depth buffers of bufsize bytes each are in flight: reads ahead of
+ *   the position of uring_read(), writes behind the one of uring_write()
+ * - the calls are collected into the buffers, each buffer is one request
+ *   at its own file offset, so the order of the completions does not
+ *   matter
+ * - the buffers are registered with the kernel (fixed buffers), when the
+ *   memlock limit allows it
+ * - io_uring is called directly by its syscalls, without liburing, and
+ *   it is detected at runtime
+ * - with direct, the file is read and written with O_DIRECT, past the
+ *   page cache: the buffers, the offsets and the sizes of the requests
+ *   are aligned to URING_ALIGN, the last block of a write is padded and
+ *   cut off again by ftruncate(), without io_uring the requests are done
+ *   synchronously
+ * - the calls of one uring must not overlap, the library calls fn_read
+ *   and fn_write under its locks
+ */
+
+#define URING_ALIGN 4096
+
+struct uring;
+
+/**
+ * uring_open() - start reading or writing fd at offset
+ * - bufsize must be a multiple of URING_ALIGN
+ * return: zero, when the kernel has no io_uring (or it is disabled), fd
+ *         is no regular file or it is opened for appending, the caller
+ *         uses stdio then
+ * - with direct also, when the file system does not allow O_DIRECT or
+ *   a write does not begin at a block, but not without io_uring
+ */
+extern struct uring *uring_open(int fd, off_t offset, int write, int depth,
+				size_t bufsize, int direct);
+
+/**
+ * uring_read() - read up to size bytes
+ * return: the bytes, less than size only at the end of the file, or -1
+ */
+extern ssize_t uring_read(struct uring *r, void *buf, size_t size);
+
+/**
+ * uring_write() - write size bytes
+ * return: zero, or -1 when this or an earlier write failed
+ */
+extern int uring_write(struct uring *r, const void *buf, size_t size);
+
+/**
+ * uring_close() - wait for the requests in flight and free all
+ * - *offset gets the file offset behind the last byte read or written
+ * return: zero, or -1 when a write failed
+ */
+extern int uring_close(struct uring *r, off_t *offset);
+
+#if defined (__cplusplus)
+}
+#endif
+
+#endif /* URING_H */
@@ -29,17 +29,49 @@
 #define MT_CCtx            ZSTDCB_CCtx
 #define MT_createCCtx      ZSTDCB_createCCtx
 #define MT_compressCCtx    ZSTDCB_compressCCtx
+#define MT_SetMaxLatencyCCtx ZSTDCB_SetMaxLatencyCCtx
+#define MT_SetAffinityCCtx ZSTDCB_SetAffinityCCtx
+#define MT_SetAdaptiveCCtx ZSTDCB_SetAdaptiveCCtx
+#define MT_SetChunkingCCtx ZSTDCB_SetChunkingCCtx
+#define MT_SetDelimiterCCtx ZSTDCB_SetDelimiterCCtx
+#define MT_SetBloomCCtx    ZSTDCB_SetBloomCCtx
+#define MT_SetHeaderCCtx   ZSTDCB_SetHeaderCCtx
+#define MT_SetChecksumCCtx ZSTDCB_SetChecksumCCtx
+#define MT_SetTreeHashCCtx ZSTDCB_SetTreeHashCCtx
+#define MT_GetTreeHashCCtx ZSTDCB_GetTreeHashCCtx
+#define MT_SetVerifyCCtx   ZSTDCB_SetVerifyCCtx
+#define MT_SetSourceCCtx   ZSTDCB_SetSourceCCtx
+#define MT_GetErrorFrameCCtx ZSTDCB_GetErrorFrameCCtx
+#define MT_SetDedupCCtx    ZSTDCB_SetDedupCCtx
+#define MT_SetLevelRangeCCtx ZSTDCB_SetLevelRangeCCtx
 #define MT_GetFramesCCtx   ZSTDCB_GetFramesCCtx
 #define MT_GetInsizeCCtx   ZSTDCB_GetInsizeCCtx
 #define MT_GetOutsizeCCtx  ZSTDCB_GetOutsizeCCtx
+#define MT_GetLatencyAvgCCtx ZSTDCB_GetLatencyAvgCCtx
+#define MT_GetLatencyMaxCCtx ZSTDCB_GetLatencyMaxCCtx
+#define MT_GetMemoryCCtx   ZSTDCB_GetMemoryCCtx
+#define MT_GetStatsCCtx    ZSTDCB_GetStatsCCtx
+#define MT_Stats           ZSTDCB_Stats
 #define MT_freeCCtx        ZSTDCB_freeCCtx
 
 #define MT_DCtx            ZSTDCB_DCtx
 #define MT_createDCtx      ZSTDCB_createDCtx
 #define MT_decompressDCtx  ZSTDCB_decompressDCtx
+#define MT_SetFilterDCtx   ZSTDCB_SetFilterDCtx
+#define MT_SetBloomDCtx    ZSTDCB_SetBloomDCtx
+#define MT_SetRangeDCtx    ZSTDCB_SetRangeDCtx
+#define MT_SetVerifyDCtx   ZSTDCB_SetVerifyDCtx
+#define MT_SetTreeHashDCtx ZSTDCB_SetTreeHashDCtx
+#define MT_GetTreeHashDCtx ZSTDCB_GetTreeHashDCtx
+#define MT_SetPoolDCtx     ZSTDCB_SetPoolDCtx
 #define MT_GetFramesDCtx   ZSTDCB_GetFramesDCtx
 #define MT_GetInsizeDCtx   ZSTDCB_GetInsizeDCtx
 #define MT_GetOutsizeDCtx  ZSTDCB_GetOutsizeDCtx
+#define MT_GetErrorFrameDCtx ZSTDCB_GetErrorFrameDCtx
 #define MT_freeDCtx        ZSTDCB_freeDCtx
+#define MT_GetFrameInfo    ZSTDCB_GetFrameInfo
+#define MT_INFO_PEEK       ZSTDCB_INFO_PEEK
+#define MT_INFO_DATA       ZSTDCB_INFO_DATA
+#define MT_INFO_WINDOW     ZSTDCB_INFO_WINDOW
 
 #include "main.c"